@@ -0,0 +1,63 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#define CSL_STRING_INTERFACE
+#define CSL_AHOCORASICK_INTERFACE
+#include "../csl-ahocorasick.c"
+
+/* Build: gcc -std=gnu2x -O2 bench/ahocorasick.c csl-ahocorasick.c csl-string.c -o bin/bench-ahocorasick */
+
+#define NPATTERNS 500
+#define TEXT_SIZE (64 << 20)
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool count_match(void* ctx, size_t pattern, size_t start, size_t end) {
+    (void)pattern; (void)start; (void)end;
+    (*(size_t*)ctx)++;
+    return true;
+}
+
+/* Lower case words over 26 letters, with text that is mostly prose-like
+ * (spaces, punctuation and digits) so matches stay rare */
+int main() {
+    static char storage[NPATTERNS][16];
+    String patterns[NPATTERNS];
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for(size_t p = 0; p < NPATTERNS; p++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        size_t len = 6 + state % 8;
+        for(size_t i = 0; i < len; i++) storage[p][i] = 'a' + (state >> (i * 4)) % 26;
+        patterns[p] = (String){ .start = storage[p], .size = len };
+    }
+    char* text = malloc(TEXT_SIZE);
+    const char filler[] = "The 42 quick, brown (foxes) JUMP over 7 lazy DOGS; ";
+    for(size_t i = 0; i < TEXT_SIZE; i++) text[i] = filler[i % (sizeof(filler) - 1)];
+    for(size_t i = 0; i < TEXT_SIZE; i += 4096) memcpy(text + i, patterns[i % NPATTERNS].start, patterns[i % NPATTERNS].size);
+
+    AhoCorasick ac = UNWRAP(ahocorasick_new(patterns, NPATTERNS), return 1);
+    size_t found = 0;
+    double t0 = now();
+    ahocorasick_find(&ac, (String){ .start = text, .size = TEXT_SIZE }, count_match, &found);
+    double t1 = now();
+    size_t naive = 0;
+    for(size_t p = 0; p < NPATTERNS; p++) {
+        const char* at = text;
+        const char* end = text + TEXT_SIZE;
+        while((at = memmem(at, end - at, patterns[p].start, patterns[p].size)) != NULL) {
+            naive++;
+            at++;
+        }
+    }
+    double t2 = now();
+    printf("%d patterns, %d MiB | aho-corasick %.2f GB/s (%zu matches) | memmem per pattern %.3f GB/s (%zu matches)\n",
+        NPATTERNS, TEXT_SIZE >> 20, TEXT_SIZE / (t1 - t0) / 1e9, found, TEXT_SIZE / (t2 - t1) / 1e9, naive);
+    ahocorasick_delete(&ac);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#define CSL_STRING_INTERFACE
+#define CSL_CSV_INTERFACE
+#include "../csl-csv.c"
+
+/* Build: gcc -std=gnu2x -O2 bench/csv.c csl-csv.c csl-arenas.c csl-string.c -o bin/bench-csv */
+
+#define INPUT_SIZE (128 << 20)
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Compares against a byte at a time state machine that finds the same field
+ * boundaries (no unescaping) */
+static size_t scalar_fields(String input) {
+    size_t fields = 0;
+    bool quoted = false;
+    for(size_t i = 0; i < input.size; i++) {
+        char c = input.start[i];
+        if(c == '"') quoted = !quoted;
+        else if(!quoted && (c == ',' || c == '\n')) fields++;
+    }
+    return fields;
+}
+
+/* Rows of mixed numeric, short text and occasionally quoted fields */
+int main() {
+    char* text = malloc(INPUT_SIZE);
+    size_t size = 0;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for(size_t row = 0; size + 256 < INPUT_SIZE; row++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        size += sprintf(text + size, "%zu,%llu,%s,\"%s\",%.3f\n", row, (unsigned long long)(state % 100000),
+            state & 1 ? "widget" : "gadget", state & 2 ? "plain, with comma" : "has \"\"quotes\"\"", (state % 1000) / 7.0);
+    }
+    String input = { .start = text, .size = size };
+    Arena arena = {
+        .strategy = SCRATCH_ALLOC,
+        .scratch = { .data = malloc(1 << 16), .size = 1 << 16 }
+    };
+
+    CsvParser csv = csv_parser_new(input, ',', &arena);
+    size_t fields = 0;
+    double t0 = now();
+    for(WRESULT(CsvRecord) rec; !(rec = csv_next(&csv)).err;) {
+        fields += rec.value.nfields;
+        arena.scratch.offset = 0;
+    }
+    double t1 = now();
+    size_t naive = scalar_fields(input);
+    double t2 = now();
+    printf("%zu MiB | csv_next %.2f GB/s (%zu fields) | scalar scan %.2f GB/s (%zu fields)\n",
+        size >> 20, size / (t1 - t0) / 1e9, fields, size / (t2 - t1) / 1e9, naive);
+    csv_parser_delete(&csv);
+    arena_delete(&arena);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define EPOCH_IMPLEMENTATION
+#include "../csl-epoch.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+#include "../csl-smrtptrs.h"
+
+/* Build: gcc -std=gnu2x -O2 bench/epoch.c -o bin/bench-epoch -lpthread */
+
+#define READS 50000000
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+    int* value = malloc(sizeof(int));
+    *value = 1;
+    _Atomic(int*) shared = value;
+    smrtptr_atomic_slot slot = SMRTPTR_SLOT_INIT;
+    union smrtptr_strong_atomic_types ptr = _smrtptr_make_strong_atomic(malloc(sizeof(int)), free);
+    *(int*)ptr.generic.ptr = 1;
+    _smrtptr_slot_store(&slot, ptr.generic);
+    volatile int sink = 0;
+
+    /* Baseline: a plain acquire load, no protection at all */
+    double t0 = now();
+    for(size_t i = 0; i < READS; i++) sink += *atomic_load_explicit(&shared, memory_order_acquire);
+    double t1 = now();
+    for(size_t i = 0; i < READS; i++) {
+        epoch_enter();
+        sink += *atomic_load_explicit(&shared, memory_order_acquire);
+        epoch_leave();
+    }
+    double t2 = now();
+    for(size_t i = 0; i < READS; i++) {
+        _generic_atomic_shared_ptr loaded = _smrtptr_slot_load(&slot);
+        sink += *(int*)loaded.ptr;
+        smrtptr_free_strong_atomic(&loaded);
+    }
+    double t3 = now();
+    (void)sink;
+
+    printf("plain load %.2f ns/read | epoch enter/leave %.2f ns/read | atomic slot load+drop %.2f ns/read\n",
+        (t1 - t0) / READS * 1e9, (t2 - t1) / READS * 1e9, (t3 - t2) / READS * 1e9);
+    smrtptr_slot_reset(&slot);
+    smrtptr_free_strong_atomic(&ptr);
+    free(value);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SMRTPTR_IMPLEMENTATION
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+
+#include "../csl-smrtptrs.h"
+
+/* Build both and compare:
+ *  gcc -std=gnu2x -O2 bench/hazard.c -o bin/bench-hazard -lpthread
+ *  gcc -std=gnu2x -O2 -DSMRTPTR_HAZARD bench/hazard.c -o bin/bench-hazard-on -lpthread */
+
+#define LOCKS 50000000
+
+#ifdef SMRTPTR_HAZARD
+#define MODE "hazard"
+#else
+#define MODE "atomic"
+#endif
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+    _generic_atomic_shared_ptr strong = _smrtptr_make_strong_atomic(malloc(sizeof(int)), free).generic;
+    *(int*)strong.ptr = 1;
+    _generic_atomic_shared_ptr weak = _smrtptr_copy_strong_atomic(
+        (union smrtptr_strong_atomic_types)strong, SMRTPTR_WEAK_ATOMIC
+    ).SMRTPTR_WEAK_ATOMIC_FIELD.generic;
+    volatile int sink = 0;
+
+    double t0 = now();
+    for(size_t i = 0; i < LOCKS; i++) {
+        _generic_atomic_shared_ptr locked = {0};
+        if(smrtptr_lock_weak_atomic(&locked, &weak)) {
+            sink += *(int*)locked.ptr;
+            smrtptr_free_strong_atomic(&locked);
+        }
+    }
+    double t1 = now();
+    printf("%s: weak lock+drop %.2f ns", MODE, (t1 - t0) / LOCKS * 1e9);
+#ifdef SMRTPTR_HAZARD
+    for(size_t i = 0; i < LOCKS; i++) {
+        int* value = smrtptr_protect_weak_atomic(int, 0, &weak);
+        if(value != NULL) sink += *value;
+        hazard_clear(0);
+    }
+    double t2 = now();
+    printf(" | weak protect+clear %.2f ns", (t2 - t1) / LOCKS * 1e9);
+#endif
+    printf("\n");
+    (void)sink;
+
+    smrtptr_free_strong_atomic(&strong);
+#ifdef SMRTPTR_HAZARD
+    hazard_barrier();
+#endif
+    smrtptr_free_weak_atomic(&weak);
+    return 0;
+}
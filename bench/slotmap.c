@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../csl-slotmap.h"
+
+typedef struct {
+    float x, y, dx, dy;
+} Particle;
+
+#define SMRTPTR_IMPLEMENTATION
+#define SHARED_PTR_TYPE_LIST \
+    SHARED_PTR_DERIVE(Particle)
+#include "../csl-smrtptrs.h"
+
+#define TEMPLATE SLOTMAP_TEMPLATE
+GENERATE(Particle)
+#undef TEMPLATE
+
+/* Build: gcc -std=gnu2x -O2 bench/slotmap.c -o bin/bench-slotmap */
+
+#define PARTICLES 100000
+#define ROUNDS 100
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+    /* Objects held by strong pointers, looked up through weak pointers */
+    _generic_shared_ptr* strong = malloc(PARTICLES * sizeof(_generic_shared_ptr));
+    _generic_shared_ptr* weak = malloc(PARTICLES * sizeof(_generic_shared_ptr));
+    for(size_t i = 0; i < PARTICLES; i++) {
+        strong[i] = _smrtptr_new_strong(sizeof(Particle), NULL).generic;
+        *(Particle*)strong[i].ptr = (Particle){ .dx = 1, .dy = 1 };
+        weak[i] = _smrtptr_copy_strong((union smrtptr_strong_types)strong[i], SMRTPTR_WEAK).SMRTPTR_WEAK_FIELD.generic;
+    }
+    /* The same objects in a slot map, looked up through handles */
+    SLOTMAP(Particle) particles = {0};
+    SlotMapHandle* handles = malloc(PARTICLES * sizeof(SlotMapHandle));
+    for(size_t i = 0; i < PARTICLES; i++) {
+        handles[i] = UNWRAP(slotmap_insert(&particles, ((Particle){ .dx = 1, .dy = 1 })), return 1);
+    }
+    /* Lookups in a shuffled order, like handles stored around a program */
+    size_t* order = malloc(PARTICLES * sizeof(size_t));
+    for(size_t i = 0; i < PARTICLES; i++) order[i] = i;
+    srand(1);
+    for(size_t i = PARTICLES - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        size_t tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+    }
+
+    double t0 = now();
+    for(size_t r = 0; r < ROUNDS; r++) {
+        for(size_t i = 0; i < PARTICLES; i++) {
+            _generic_shared_ptr locked;
+            if(_smrtptr_lock_weak((union smrtptr_strong_types*)&locked, (union smrtptr_weak_types)weak[order[i]])) {
+                Particle* p = locked.ptr;
+                p->x += p->dx;
+                smrtptr_free_strong(&locked);
+            }
+        }
+    }
+    double t1 = now();
+    for(size_t r = 0; r < ROUNDS; r++) {
+        for(size_t i = 0; i < PARTICLES; i++) {
+            Particle* p = slotmap_get(&particles, handles[order[i]]);
+            if(p != NULL) p->x += p->dx;
+        }
+    }
+    double t2 = now();
+    for(size_t r = 0; r < ROUNDS; r++) {
+        for(size_t i = 0; i < PARTICLES; i++) {
+            Particle* p = strong[i].ptr;
+            p->y += p->dy;
+        }
+    }
+    double t3 = now();
+    for(size_t r = 0; r < ROUNDS; r++) {
+        slotmap_foreach(p, &particles) p->y += p->dy;
+    }
+    double t4 = now();
+
+    const double n = (double)ROUNDS * PARTICLES;
+    printf("lookup: weak lock %.2f ns | slot map handle %.2f ns\n", (t1 - t0) / n * 1e9, (t2 - t1) / n * 1e9);
+    printf("update all: strong pointers %.2f ns | slot map foreach %.2f ns\n", (t3 - t2) / n * 1e9, (t4 - t3) / n * 1e9);
+
+    for(size_t i = 0; i < PARTICLES; i++) {
+        smrtptr_free_strong(&strong[i]);
+        smrtptr_free_weak(&weak[i]);
+    }
+    slotmap_free(&particles);
+    free(strong);
+    free(weak);
+    free(handles);
+    free(order);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#define SMRTPTR_IMPLEMENTATION
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+
+#include "../csl-smrtptrs.h"
+
+/* Build both and compare (the difference only shows up with THREADS cores to run on):
+ *  gcc -std=gnu2x -O2 bench/smrtptrs-contention.c -o bin/bench-contention -lpthread
+ *  gcc -std=gnu2x -O2 -DSMRTPTR_PADDED_CTRLBLK bench/smrtptrs-contention.c -o bin/bench-contention-padded -lpthread */
+
+#define COPIES 20000000
+#define THREADS 4
+
+#ifdef SMRTPTR_PADDED_CTRLBLK
+#define MODE "padded"
+#else
+#define MODE "packed"
+#endif
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    _generic_atomic_shared_ptr ptr;
+    enum smrtptr_types type;
+} Job;
+
+static void* hammer(void* arg) {
+    Job* job = arg;
+    union smrtptr_strong_atomic_types ptr = (union smrtptr_strong_atomic_types)job->ptr;
+    for(size_t i = 0; i < COPIES / THREADS; i++) {
+        atomic_shared_ptr_option copy = _smrtptr_copy_strong_atomic(ptr, job->type);
+        __asm__ volatile("" : : "r"(&copy) : "memory");
+        if(job->type == SMRTPTR_STRONG_ATOMIC) smrtptr_free_strong_atomic(&copy);
+        else smrtptr_free_weak_atomic(&copy);
+    }
+    return NULL;
+}
+
+static double run(Job* jobs) {
+    pthread_t threads[THREADS];
+    double t0 = now();
+    for(size_t i = 0; i < THREADS; i++) pthread_create(&threads[i], NULL, hammer, &jobs[i]);
+    for(size_t i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+    return (now() - t0) / COPIES * 1e9;
+}
+
+int main() {
+    /* The ints are allocated first and the pointers made back to back, so the control blocks sit next to
+     * each other in memory. Each thread only touches its own object */
+    Job jobs[THREADS];
+    int* values[THREADS];
+    _generic_atomic_shared_ptr objects[THREADS];
+    for(size_t i = 0; i < THREADS; i++) values[i] = malloc(sizeof(int));
+    for(size_t i = 0; i < THREADS; i++) {
+        objects[i] = _smrtptr_make_strong_atomic(values[i], free).generic;
+        jobs[i] = (Job){ .ptr = objects[i], .type = SMRTPTR_STRONG_ATOMIC };
+    }
+    double distinct = run(jobs);
+
+    /* One object, half the threads copy strong pointers and half copy weak ones */
+    for(size_t i = 0; i < THREADS; i++) {
+        jobs[i] = (Job){
+            .ptr = objects[0],
+            .type = i % 2 ? SMRTPTR_WEAK_ATOMIC : SMRTPTR_STRONG_ATOMIC,
+        };
+    }
+    double strong_weak = run(jobs);
+
+    printf("%s | ctrlblk %zu bytes, neighbours %td bytes apart | distinct objects %.2f ns/op"
+        " | strong + weak on one object %.2f ns/op (%d threads)\n",
+        MODE, sizeof(atomic_shared_ptr_ctrlblk),
+        (char*)objects[1].ctrl - (char*)objects[0].ctrl,
+        distinct, strong_weak, THREADS);
+    for(size_t i = 0; i < THREADS; i++) smrtptr_free_strong_atomic(&objects[i]);
+    return 0;
+}
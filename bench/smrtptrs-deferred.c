@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SMRTPTR_IMPLEMENTATION
+
+typedef struct Node {
+    struct Node* next;
+    char payload[48];
+} Node;
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(Node)
+
+#include "../csl-smrtptrs.h"
+
+/* Build both and compare:
+ *  gcc -std=gnu2x -O2 bench/smrtptrs-deferred.c -o bin/bench-deferred -lpthread
+ *  gcc -std=gnu2x -O2 -DSMRTPTR_DEFERRED_DESTROY bench/smrtptrs-deferred.c -o bin/bench-deferred-on -lpthread */
+
+#define GRAPHS 200
+#define GRAPH_NODES 100000
+
+#ifdef SMRTPTR_DEFERRED_DESTROY
+#define MODE "deferred"
+#else
+#define MODE "inline"
+#endif
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Frees the list hanging off the head node */
+static void free_graph(void* ptr) {
+    Node* node = ptr;
+    while(node != NULL) {
+        Node* next = node->next;
+        free(node);
+        node = next;
+    }
+}
+
+int main() {
+#ifdef SMRTPTR_DEFERRED_DESTROY
+    smrtptr_start_reclaimer();
+#endif
+    double worst = 0;
+    double total = 0;
+    for(size_t i = 0; i < GRAPHS; i++) {
+        Node* head = NULL;
+        for(size_t n = 0; n < GRAPH_NODES; n++) {
+            Node* node = malloc(sizeof(Node));
+            node->next = head;
+            head = node;
+        }
+        _generic_atomic_shared_ptr graph = _smrtptr_make_strong_atomic(head, free_graph).generic;
+        /* The request thread's view: how long does dropping the last reference take */
+        double t0 = now();
+        smrtptr_free_strong_atomic(&graph);
+        double t1 = now();
+        total += t1 - t0;
+        if(t1 - t0 > worst) worst = t1 - t0;
+    }
+#ifdef SMRTPTR_DEFERRED_DESTROY
+    smrtptr_stop_reclaimer();
+#endif
+    printf("%s: drop of a %d node graph, mean %.2f us, worst %.2f us\n",
+        MODE, GRAPH_NODES, total / GRAPHS * 1e6, worst * 1e6);
+    return 0;
+}
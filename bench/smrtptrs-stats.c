@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SMRTPTR_IMPLEMENTATION
+
+typedef struct {
+    double x, y;
+} Point;
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(Point)
+
+#include "../csl-smrtptrs.h"
+
+/* Build each and compare:
+ *  gcc -std=gnu2x -O2 bench/smrtptrs-stats.c -o bin/bench-stats -lpthread
+ *  gcc -std=gnu2x -O2 -DSMRTPTR_STATS bench/smrtptrs-stats.c -o bin/bench-stats-on -lpthread
+ *  gcc -std=gnu2x -O2 -DSMRTPTR_STATS -DSMRTPTR_STATS_NO_TIMING bench/smrtptrs-stats.c -o bin/bench-stats-count -lpthread */
+
+#define COPIES 10000000
+#define MAKES 1000000
+
+#if defined(SMRTPTR_STATS) && defined(SMRTPTR_STATS_NO_TIMING)
+#define MODE "stats without timing"
+#elif defined(SMRTPTR_STATS)
+#define MODE "stats"
+#else
+#define MODE "no stats"
+#endif
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+    smrtptr_strong_atomic(Point) point = smrtptr_new_strong_atomic(Point, NULL);
+    double t0 = now();
+    for(size_t i = 0; i < COPIES; i++) {
+        _generic_atomic_shared_ptr copy = _smrtptr_copy_strong_atomic(
+            (union smrtptr_strong_atomic_types)point, SMRTPTR_STRONG_ATOMIC
+        ).SMRTPTR_STRONG_ATOMIC_FIELD.generic;
+        smrtptr_free_strong_atomic(&copy);
+    }
+    double t1 = now();
+    for(size_t i = 0; i < MAKES; i++) {
+        smrtptr_strong_atomic(Point) made = smrtptr_make_strong_atomic(Point, malloc(sizeof(Point)), free);
+    }
+    double t2 = now();
+    printf("%s: copy + drop %.2f ns | make + drop %.2f ns\n",
+        MODE, (t1 - t0) / COPIES * 1e9, (t2 - t1) / MAKES * 1e9);
+#ifdef SMRTPTR_STATS
+    smrtptr_print_stats(stdout);
+#endif
+    return 0;
+}
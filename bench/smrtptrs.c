@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#define SMRTPTR_IMPLEMENTATION
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+
+#include "../csl-smrtptrs.h"
+
+/* Build both and compare:
+ *  gcc -std=gnu2x -O2 bench/smrtptrs.c -o bin/bench-smrtptrs -lpthread
+ *  gcc -std=gnu2x -O2 -DSMRTPTR_BIASED_REFCOUNT bench/smrtptrs.c -o bin/bench-smrtptrs-biased -lpthread */
+
+#define COPIES 50000000
+#define THREADS 4
+
+#ifdef SMRTPTR_BIASED_REFCOUNT
+#define MODE "biased"
+#else
+#define MODE "atomic"
+#endif
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* One copy and drop, the way a function taking a pointer by copy would do it */
+static inline void copy_drop(union smrtptr_strong_atomic_types ptr) {
+    union smrtptr_strong_atomic_types copy =
+        _smrtptr_copy_strong_atomic(ptr, SMRTPTR_STRONG_ATOMIC).SMRTPTR_STRONG_ATOMIC_FIELD;
+    __asm__ volatile("" : : "r"(copy.generic.ctrl) : "memory");
+    smrtptr_free_strong_atomic(&copy);
+}
+
+static atomic_bool owner_done;
+
+static void* worker(void* arg) {
+    _generic_atomic_shared_ptr* mine = arg;
+    for(size_t i = 0; i < COPIES / 20; i++) copy_drop((union smrtptr_strong_atomic_types)*mine);
+    /* Dropping the copy the owner made would merge the object (biased counting ends there), so hold
+     * on to it until the owner is done */
+    while(!atomic_load(&owner_done)) sched_yield();
+    smrtptr_free_strong_atomic(mine);
+    return NULL;
+}
+
+int main() {
+    union smrtptr_strong_atomic_types ptr = _smrtptr_make_strong_atomic(malloc(sizeof(int)), free);
+
+    /* Only the thread that made the object */
+    double t0 = now();
+    for(size_t i = 0; i < COPIES; i++) copy_drop(ptr);
+    double t1 = now();
+
+    /* The owner does most of the copies, each of the THREADS other threads does 5% */
+    _generic_atomic_shared_ptr given[THREADS];
+    pthread_t threads[THREADS];
+    double t2 = now();
+    for(size_t i = 0; i < THREADS; i++) {
+        given[i] = _smrtptr_copy_strong_atomic(ptr, SMRTPTR_STRONG_ATOMIC).SMRTPTR_STRONG_ATOMIC_FIELD.generic;
+        pthread_create(&threads[i], NULL, worker, &given[i]);
+    }
+    for(size_t i = 0; i < COPIES - COPIES / 20 * THREADS; i++) copy_drop(ptr);
+    atomic_store(&owner_done, true);
+    for(size_t i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+    double t3 = now();
+
+    smrtptr_free_strong_atomic(&ptr);
+    printf("%s | owner only %.2f ns/copy+drop | mixed (%d threads) %.2f ns/copy+drop\n",
+        MODE, (t1 - t0) / COPIES * 1e9, THREADS + 1, (t3 - t2) / COPIES * 1e9);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <time.h>
+#define CSL_STRING_INTERFACE
+#define CSL_STRMAP_INTERFACE
+#include "../csl-strmap.c"
+
+/* Build: gcc -std=gnu2x -O2 bench/strhash.c csl-strmap.c csl-string.c -o bin/bench-strhash */
+
+#define NKEYS 100000
+#define ROUNDS 50
+
+static uint64_t fnv1a(String s) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < s.size; i++) {
+        hash ^= (uint8_t)s.start[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_hash(size_t len) {
+    char* data = malloc(NKEYS * len + 1);
+    for(size_t i = 0; i < NKEYS * len; i++) data[i] = 'a' + (i * 7919) % 26;
+    uint64_t sink = 0;
+    double t0 = now();
+    for(int r = 0; r < ROUNDS; r++)
+        for(size_t i = 0; i < NKEYS; i++) sink ^= fnv1a((String){ .start = data + i * len, .size = len });
+    double t1 = now();
+    for(int r = 0; r < ROUNDS; r++)
+        for(size_t i = 0; i < NKEYS; i++) sink ^= string_hash((String){ .start = data + i * len, .size = len });
+    double t2 = now();
+    double bytes = (double)NKEYS * ROUNDS * len;
+    printf("%5zu byte keys | fnv1a %8.2f GB/s | string_hash %8.2f GB/s | (%llx)\n",
+        len, bytes / (t1 - t0) / 1e9, bytes / (t2 - t1) / 1e9, (unsigned long long)(sink & 0xf));
+    free(data);
+}
+
+static void bench_map() {
+    StrMap map = UNWRAP(strmap_new(size_t, NKEYS), return);
+    char (*keys)[40] = malloc(NKEYS * sizeof(*keys));
+    size_t* lens = malloc(NKEYS * sizeof(size_t));
+    for(size_t i = 0; i < NKEYS; i++) {
+        lens[i] = snprintf(keys[i], sizeof(keys[i]), "user:%zu:name", i * 2654435761u);
+        strmap_insert(size_t, &map, ((String){ .start = keys[i], .size = lens[i] }), i);
+    }
+    size_t found = 0;
+    double t0 = now();
+    for(int r = 0; r < ROUNDS; r++)
+        for(size_t i = 0; i < NKEYS; i++)
+            found += strmap_get(size_t, &map, ((String){ .start = keys[i], .size = lens[i] })) != NULL;
+    double t1 = now();
+    printf("strmap_get: %.1f ns/lookup (%zu found)\n", (t1 - t0) * 1e9 / ((double)NKEYS * ROUNDS), found);
+    free(keys);
+    free(lens);
+    strmap_delete(&map);
+}
+
+int main() {
+    size_t lens[] = { 4, 8, 16, 32, 64, 256, 4096 };
+    for(size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) bench_hash(lens[i]);
+    bench_map();
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <time.h>
+#define CSL_STRING_INTERFACE
+#define CSL_STRSORT_INTERFACE
+#include "../csl-strsort.c"
+
+/* Build: gcc -std=gnu2x -O2 bench/strsort.c csl-strsort.c csl-string.c -o bin/bench-strsort -lpthread */
+
+#define NKEYS 4000000
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare(const void* a, const void* b) {
+    return string_compare(*(const String*)a, *(const String*)b);
+}
+
+/* URL-like keys: a handful of long shared prefixes and a random tail */
+int main() {
+    static const char* hosts[] = {
+        "https://cdn.example.com/assets/", "https://api.example.com/v2/users/",
+        "https://example.org/", "http://static.example.net/img/2024/"
+    };
+    char* storage = malloc((size_t)NKEYS * 64);
+    String* keys = malloc(NKEYS * sizeof(String));
+    String* work = malloc(NKEYS * sizeof(String));
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for(size_t i = 0; i < NKEYS; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        char* p = storage + i * 64;
+        int len = snprintf(p, 64, "%s%llu", hosts[state % 4], (unsigned long long)(state >> 20) % 100000000);
+        keys[i] = (String){ .start = p, .size = (size_t)len };
+    }
+
+    memcpy(work, keys, NKEYS * sizeof(String));
+    double t0 = now();
+    qsort(work, NKEYS, sizeof(String), compare);
+    double t1 = now();
+    memcpy(work, keys, NKEYS * sizeof(String));
+    string_sort(work, NKEYS);
+    double t2 = now();
+    memcpy(work, keys, NKEYS * sizeof(String));
+    string_sort_stable(work, NKEYS);
+    double t3 = now();
+    memcpy(work, keys, NKEYS * sizeof(String));
+    string_sort_parallel(work, NKEYS, 0);
+    double t4 = now();
+    printf("%d keys | qsort %.3fs | string_sort %.3fs | string_sort_stable %.3fs | string_sort_parallel %.3fs\n",
+        NKEYS, t1 - t0, t2 - t1, t3 - t2, t4 - t3);
+    free(storage);
+    free(keys);
+    free(work);
+    return 0;
+}
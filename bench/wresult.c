@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <time.h>
+#define CSL_STRING_INTERFACE
+#include "../csl-string.c"
+
+/* Build: gcc -std=gnu2x -O2 bench/wresult.c -o bin/bench-wresult */
+
+#define CALLS 200000000
+
+/* The same String result with the regular layout, to compare against the
+ * compact WRESULT(String) from csl-string.c */
+typedef String WideString;
+DERIVE_WRESULT(WideString);
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* A typical slicing function, kept out of line so the result has to cross
+ * a call boundary */
+__attribute__((noipa))
+static WRESULT(WideString) slice_wide(String self, size_t lower) {
+    WideString fail = {0};
+    if(lower > self.size) return WRESULT_ERR(WideString, fail);
+    WideString success = { .start = self.start + lower, .size = self.size - lower };
+    return WRESULT_OK(WideString, success);
+}
+
+__attribute__((noipa))
+static WRESULT(String) slice_compact(String self, size_t lower) {
+    String fail = {0};
+    if(lower > self.size) return WRESULT_ERR(String, fail);
+    String success = { .start = self.start + lower, .size = self.size - lower };
+    return WRESULT_OK(String, success);
+}
+
+int main() {
+    char text[64] = "the quick brown fox jumps over the lazy dog";
+    String s = { .start = text, .size = 43 };
+    volatile size_t sink = 0;
+    size_t total = 0;
+
+    double t0 = now();
+    for(size_t i = 0; i < CALLS; i++) {
+        total += UNWRAP(slice_wide(s, i & 31), continue).size;
+    }
+    double t1 = now();
+    sink = total;
+    total = 0;
+    for(size_t i = 0; i < CALLS; i++) {
+        total += UNWRAP(slice_compact(s, i & 31), continue).size;
+    }
+    double t2 = now();
+    sink = total;
+    (void)sink;
+    printf("sizeof: regular %zu, compact %zu | regular %.2f ns/call | compact %.2f ns/call\n",
+        sizeof(WRESULT(WideString)), sizeof(WRESULT(String)),
+        (t1 - t0) / CALLS * 1e9, (t2 - t1) / CALLS * 1e9);
+    return 0;
+}
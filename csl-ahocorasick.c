@@ -0,0 +1,340 @@
+/*******************************************************************************
+* Name:             csl-ahocorasick.c                                          *
+* Description:      Multi-pattern search (Aho-Corasick) over String            *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   The pattern trie is compiled into a full DFA, so scanning  *
+*                   is one table load per byte with no failure-link chasing.   *
+*                   Bytes are first mapped to equivalence classes (every byte  *
+*                   that appears in no pattern shares one class), which keeps  *
+*                   each state's row as short as the pattern alphabet. Table   *
+*                   entries hold the row offset of the next state (already    *
+*                   multiplied by the row length) with the top bit set when    *
+*                   that state ends at least one pattern, so the hot loop is   *
+*                   an add, a load and a test. While the automaton sits in the *
+*                   root state, input is skipped with a prefilter for bytes    *
+*                   that can start a pattern: memchr for a single start byte,  *
+*                   an SSSE3 nibble lookup (16 bytes per step) otherwise.      *
+* Usage:            AhoCorasick ac = UNWRAP(ahocorasick_new(patterns, n), ..); *
+*                   ahocorasick_find(&ac, text, on_match, &ctx);               *
+*                                                                              *
+*                   // or across chunks of a stream                            *
+*                   AhoCorasickState state = {0};                              *
+*                   while(...) ahocorasick_feed(&ac, &state, chunk, fn, ctx);  *
+*                   ahocorasick_delete(&ac);                                   *
+*                                                                              *
+*                   - Every match is reported, including overlapping ones and  *
+*                       matches that straddle two fed chunks. Offsets are from *
+*                       the start of the whole input.                          *
+*                   - The callback returns false to stop the scan early.       *
+*******************************************************************************/
+
+#ifndef __CSL_AHOCORASICK_C
+#define __CSL_AHOCORASICK_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+
+/* @brief:  Called once per match
+ * @param:  void* ctx - user pointer passed to the scan
+ * @param:  size_t pattern - index of the pattern in the list given to ahocorasick_new
+ * @param:  size_t start - offset of the first byte of the match
+ * @param:  size_t end - offset one past the last byte of the match
+ * @return: bool - false to stop scanning */
+typedef bool (*AhoCorasickMatchFn)(void* ctx, size_t pattern, size_t start, size_t end);
+
+typedef struct {
+    uint32_t* delta;            // nstates * nclasses row offsets, top bit = match state
+    uint32_t* out;              // per state: first pattern ending exactly here
+    uint32_t* dict;             // per state: closest proper suffix state with output
+    uint32_t* pattern_next;     // per pattern: next pattern with the same end state
+    size_t* pattern_size;
+    size_t npatterns;
+    size_t nstates;
+    size_t nclasses;
+    uint8_t classes[256];       // byte -> equivalence class
+    bool start[256];            // bytes that leave the root state
+    size_t nstart;
+    uint8_t start_bitmap[2][16];// prefilter: bit (hi & 7) of [hi >> 3][lo]
+    bool ssse3;
+} AhoCorasick;
+
+typedef struct {
+    uint32_t state;             // row offset of the current state
+    size_t offset;              // bytes fed so far
+} AhoCorasickState;
+
+DERIVE_WRESULT(AhoCorasick);
+
+WRESULT(AhoCorasick) ahocorasick_new(const String* patterns, size_t count);
+size_t ahocorasick_feed(
+    const AhoCorasick* self,
+    AhoCorasickState* state,
+    String text,
+    AhoCorasickMatchFn fn,
+    void* ctx
+);
+size_t ahocorasick_find(const AhoCorasick* self, String text, AhoCorasickMatchFn fn, void* ctx);
+void ahocorasick_delete(AhoCorasick* self);
+
+#if !defined(CSL_AHOCORASICK_INTERFACE)
+
+#define AC_NONE     UINT32_MAX
+#define AC_MATCH    (UINT32_C(1) << 31)
+
+/* @brief:  Compiles a list of patterns into a matcher
+ * @param:  const String* patterns - the patterns (copied, they need not outlive
+ *          the matcher). Empty patterns are rejected
+ * @param:  size_t count - number of patterns
+ * @return: WRESULT(AhoCorasick) - the compiled matcher */
+WRESULT(AhoCorasick) ahocorasick_new(const String* patterns, size_t count) {
+    AhoCorasick self = { .npatterns = count };
+    uint32_t* fail = NULL;
+    uint32_t* queue = NULL;
+
+    /* Byte classes: every byte used by a pattern gets its own class, the rest
+     * share class 0 (unless every byte is used) */
+    bool used[256] = {0};
+    size_t total = 0;
+    for(size_t p = 0; p < count; p++) {
+        if(patterns[p].size == 0) goto fail;
+        total += patterns[p].size;
+        for(size_t i = 0; i < patterns[p].size; i++) used[(uint8_t)patterns[p].start[i]] = true;
+    }
+    size_t nused = 0;
+    for(int b = 0; b < 256; b++) nused += used[b];
+    size_t next_class = nused < 256 ? 1 : 0;
+    for(int b = 0; b < 256; b++) self.classes[b] = used[b] ? (uint8_t)next_class++ : 0;
+    self.nclasses = next_class ? next_class : 1;
+
+    size_t max_states = total + 1;
+    if(max_states > (AC_MATCH - 1) / self.nclasses) goto fail;
+    self.delta = malloc(max_states * self.nclasses * sizeof(uint32_t));
+    self.out = malloc(max_states * sizeof(uint32_t));
+    self.dict = malloc(max_states * sizeof(uint32_t));
+    self.pattern_next = malloc((count ? count : 1) * sizeof(uint32_t));
+    self.pattern_size = malloc((count ? count : 1) * sizeof(size_t));
+    fail = malloc(max_states * sizeof(uint32_t));
+    queue = malloc(max_states * sizeof(uint32_t));
+    if(
+        self.delta == NULL          || self.out == NULL     ||
+        self.dict == NULL           || fail == NULL         ||
+        self.pattern_next == NULL   || queue == NULL        ||
+        self.pattern_size == NULL
+    ) goto fail;
+
+    /* Trie, with AC_NONE for missing children */
+    const size_t ncls = self.nclasses;
+    memset(self.delta, 0xFF, max_states * ncls * sizeof(uint32_t));
+    self.nstates = 1;
+    self.out[0] = AC_NONE;
+    for(size_t p = 0; p < count; p++) {
+        uint32_t s = 0;
+        for(size_t i = 0; i < patterns[p].size; i++) {
+            uint32_t* slot = &self.delta[s * ncls + self.classes[(uint8_t)patterns[p].start[i]]];
+            if(*slot == AC_NONE) {
+                self.out[self.nstates] = AC_NONE;
+                *slot = (uint32_t)self.nstates++;
+            }
+            s = *slot;
+        }
+        self.pattern_size[p] = patterns[p].size;
+        self.pattern_next[p] = self.out[s];
+        self.out[s] = (uint32_t)p;
+    }
+
+    /* Breadth first: failure links, dictionary links and the missing DFA
+     * transitions (a state's failure target is always shallower, so its row is
+     * already complete) */
+    size_t head = 0, tail = 0;
+    self.dict[0] = AC_NONE;
+    for(size_t c = 0; c < ncls; c++) {
+        uint32_t t = self.delta[c];
+        if(t == AC_NONE) {
+            self.delta[c] = 0;
+        } else {
+            fail[t] = 0;
+            self.dict[t] = AC_NONE;
+            queue[tail++] = t;
+        }
+    }
+    while(head < tail) {
+        uint32_t s = queue[head++];
+        for(size_t c = 0; c < ncls; c++) {
+            uint32_t t = self.delta[s * ncls + c];
+            uint32_t via_fail = self.delta[fail[s] * ncls + c];
+            if(t == AC_NONE) {
+                self.delta[s * ncls + c] = via_fail;
+            } else {
+                fail[t] = via_fail;
+                self.dict[t] = self.out[via_fail] != AC_NONE ? via_fail : self.dict[via_fail];
+                queue[tail++] = t;
+            }
+        }
+    }
+
+    /* Premultiply targets into row offsets and tag match states */
+    for(size_t i = 0; i < self.nstates * ncls; i++) {
+        uint32_t t = self.delta[i];
+        bool match = self.out[t] != AC_NONE || self.dict[t] != AC_NONE;
+        self.delta[i] = (uint32_t)(t * ncls) | (match ? AC_MATCH : 0);
+    }
+    uint32_t* shrunk = realloc(self.delta, self.nstates * ncls * sizeof(uint32_t));
+    if(shrunk != NULL) self.delta = shrunk;
+
+    /* Prefilter tables */
+    for(int b = 0; b < 256; b++) {
+        self.start[b] = (self.delta[self.classes[b]] & ~AC_MATCH) != 0;
+        if(!self.start[b]) continue;
+        self.nstart++;
+        self.start_bitmap[b >> 7][b & 0x0F] |= (uint8_t)(1 << ((b >> 4) & 7));
+    }
+#ifdef STRING_X86
+    self.ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+
+    free(fail);
+    free(queue);
+    return WRESULT_OK(AhoCorasick, self);
+
+fail:
+    free(fail);
+    free(queue);
+    ahocorasick_delete(&self);
+    return WRESULT_ERR(AhoCorasick, self);
+}
+
+#ifdef STRING_X86
+/* Index of the first byte in p[i..n) that can start a pattern, 16 at a time.
+ * Each byte is split into nibbles: the low nibble selects a row of the bitmap
+ * (one table for bytes < 0x80, one for the rest, pshufb zeroes lanes with the
+ * top bit set) and the high nibble selects the bit within it */
+__attribute__((target("ssse3")))
+static size_t ahocorasick_skip_ssse3(const AhoCorasick* self, const uint8_t* p, size_t i, size_t n) {
+    const __m128i low_table = _mm_loadu_si128((const __m128i*)self->start_bitmap[0]);
+    const __m128i high_table = _mm_loadu_si128((const __m128i*)self->start_bitmap[1]);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i top = _mm_set1_epi8((char)0x80);
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i row = _mm_or_si128(
+            _mm_shuffle_epi8(low_table, v),
+            _mm_shuffle_epi8(high_table, _mm_xor_si128(v, top))
+        );
+        __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i hit = _mm_cmpeq_epi8(_mm_and_si128(row, bit), bit);
+        int mask = _mm_movemask_epi8(hit);
+        if(mask != 0) return i + __builtin_ctz(mask);
+    }
+    while(i < n && !self->start[p[i]]) i++;
+    return i;
+}
+#endif
+
+/* Index of the first byte in p[i..n) that can start a pattern, or n */
+static inline size_t ahocorasick_skip(const AhoCorasick* self, const uint8_t* p, size_t i, size_t n) {
+    if(self->nstart == 0) return n;
+    if(self->nstart == 1) {
+        uint8_t b = 0;
+        while(!self->start[b]) b++;
+        const uint8_t* hit = memchr(p + i, b, n - i);
+        return hit == NULL ? n : (size_t)(hit - p);
+    }
+#ifdef STRING_X86
+    if(self->ssse3) return ahocorasick_skip_ssse3(self, p, i, n);
+#endif
+    while(i < n && !self->start[p[i]]) i++;
+    return i;
+}
+
+/* Reports every pattern ending in the state at row offset row */
+static bool ahocorasick_report(
+    const AhoCorasick* self,
+    uint32_t row,
+    size_t end,
+    AhoCorasickMatchFn fn,
+    void* ctx,
+    size_t* matches
+) {
+    uint32_t s = row / (uint32_t)self->nclasses;
+    if(self->out[s] == AC_NONE) s = self->dict[s];
+    for(; s != AC_NONE; s = self->dict[s]) {
+        for(uint32_t p = self->out[s]; p != AC_NONE; p = self->pattern_next[p]) {
+            (*matches)++;
+            if(!fn(ctx, p, end - self->pattern_size[p], end)) return false;
+        }
+    }
+    return true;
+}
+
+/* @brief:  Scans the next chunk of a stream, continuing from state. Matches
+ *          that began in earlier chunks are found as well
+ * @param:  const AhoCorasick* self - the compiled matcher
+ * @param:  AhoCorasickState* state - scan state, start from {0}
+ * @param:  String text - the next chunk of input
+ * @param:  AhoCorasickMatchFn fn - called for every match
+ * @param:  void* ctx - passed through to fn
+ * @return: size_t - number of matches reported */
+size_t ahocorasick_feed(
+    const AhoCorasick* self,
+    AhoCorasickState* state,
+    String text,
+    AhoCorasickMatchFn fn,
+    void* ctx
+) {
+    const uint8_t* p = (const uint8_t*)text.start;
+    const uint32_t* delta = self->delta;
+    const size_t n = text.size;
+    size_t matches = 0;
+    size_t i = 0;
+    uint32_t s = state->state;
+    while(i < n) {
+        if(s == 0) {
+            i = ahocorasick_skip(self, p, i, n);
+            if(i == n) break;
+        }
+        s = delta[s + self->classes[p[i++]]];
+        if(__builtin_expect(s & AC_MATCH, 0)) {
+            s &= ~AC_MATCH;
+            if(!ahocorasick_report(self, s, state->offset + i, fn, ctx, &matches)) break;
+        }
+    }
+    state->state = s;
+    state->offset += i;
+    return matches;
+}
+
+/* @brief:  Scans a whole string
+ * @param:  const AhoCorasick* self - the compiled matcher
+ * @param:  String text - input to search
+ * @param:  AhoCorasickMatchFn fn - called for every match
+ * @param:  void* ctx - passed through to fn
+ * @return: size_t - number of matches reported */
+size_t ahocorasick_find(const AhoCorasick* self, String text, AhoCorasickMatchFn fn, void* ctx) {
+    AhoCorasickState state = {0};
+    return ahocorasick_feed(self, &state, text, fn, ctx);
+}
+
+/* @brief:  Frees the tables of the matcher
+ * @param:  AhoCorasick* self - matcher to delete */
+void ahocorasick_delete(AhoCorasick* self) {
+    free(self->delta);
+    free(self->out);
+    free(self->dict);
+    free(self->pattern_next);
+    free(self->pattern_size);
+    *self = (AhoCorasick){0};
+}
+
+#undef AC_NONE
+#undef AC_MATCH
+
+#endif
+#endif
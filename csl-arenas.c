@@ -1,3 +1,6 @@
+#ifndef __CSL_ARENAS_C
+#define __CSL_ARENAS_C
+
 /*** INTERFACE ***/
 #include <stdbool.h>
 #include <stdint.h>
@@ -53,8 +56,10 @@ static void* ScratchArena_alloc(ScratchArena* arena, size_t size) {
         arena->size == 0    ||
         size == 0
     ) return NULL;
+    if(size > arena->size - arena->offset) return NULL;
+    void* ptr = arena->data + arena->offset;
     arena->offset += size;
-    return (void*)(arena->data + arena->offset);
+    return ptr;
 }
 
 static void ScratchArena_delete(ScratchArena* arena) {
@@ -176,3 +181,4 @@ bool  arena_release_ptr(Arena* arena, void* ptr);
 void  arena_delete(Arena* arena);
 
 #endif
+#endif
@@ -0,0 +1,219 @@
+/*******************************************************************************
+* Name:             csl-cowstring.c                                            *
+* Description:      Copy-on-write shared string                                *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   The bytes live in one refcounted block (the count sits in  *
+*                   front of the data, so there is a single allocation). The   *
+*                   count uses the same scheme as the atomic strong pointers   *
+*                   in csl-smrtptrs.h: relaxed increments, release decrements  *
+*                   and an acquire fence before the free. Each CowString is a  *
+*                   String view into the block plus the block pointer, so a    *
+*                   copy is one atomic increment. A mutation first checks      *
+*                   whether this handle is the only owner: if it is, the block *
+*                   is edited (or grown) in place, otherwise the view is       *
+*                   copied into a fresh block and the old one is released.     *
+* Usage:            CowString a = UNWRAP(cowstring_new(payload), return 1);    *
+*                   CowString b = cowstring_copy(&a);   // O(1), shares bytes  *
+*                   cowstring_append(&b, suffix);       // b gets its own copy *
+*                   cowstring_delete(&a);                                      *
+*                   cowstring_delete(&b);                                      *
+*                                                                              *
+*                   - Copies may be handed to other threads. A single          *
+*                       CowString handle must not be used by two threads at    *
+*                       once (the same rule as DString).                       *
+*                   - Stripping only narrows the view of the handle, so it     *
+*                       never copies, even when the block is shared.           *
+*                   - Treat s as read only unless cowstring_is_shared is false.*
+*                   - cowstring_delete takes a void* so it can be used with    *
+*                       __attribute__((cleanup)).                              *
+*******************************************************************************/
+
+#ifndef __CSL_COWSTRING_C
+#define __CSL_COWSTRING_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+
+typedef struct {
+    atomic_size_t nstrong;
+    size_t capacity;
+    char data[];
+} CowBlock;
+
+typedef struct {
+    String s;           // view into block->data
+    CowBlock* block;    // NULL for an empty string that was never allocated
+} CowString;
+
+DERIVE_WRESULT(CowString);
+
+WRESULT(CowString) cowstring_new(String str);
+CowString cowstring_copy(const CowString* self);
+bool cowstring_is_shared(const CowString* self);
+WRESULT(size_t) cowstring_append(CowString* self, String str);
+WRESULT(size_t) cowstring_prepend(CowString* self, String str);
+WRESULT(size_t) cowstring_strippref(CowString* self, size_t n);
+WRESULT(size_t) cowstring_stripsuff(CowString* self, size_t n);
+void cowstring_delete(void* self);
+
+#if !defined(CSL_COWSTRING_INTERFACE)
+
+static inline void cowstring_release(CowBlock* block) {
+    /* atomic_fetch_sub_explicit returns the old value. If it was 1 we held the
+     * last reference */
+    if(block != NULL && atomic_fetch_sub_explicit(&block->nstrong, 1, memory_order_release) == 1) {
+        atomic_thread_fence(memory_order_acquire);
+        free(block);
+    }
+}
+
+static inline size_t cowstring_grow(size_t capacity, size_t needed) {
+    size_t new_capacity = capacity < 16 ? 16 : capacity;
+    while(new_capacity < needed) {
+        new_capacity = new_capacity > SIZE_MAX / 2 ? needed : new_capacity * 2;
+    }
+    return new_capacity;
+}
+
+/* Makes self the only owner of its block, with at least front free bytes
+ * before the view and back free bytes after it */
+static bool cowstring_make_room(CowString* self, size_t front, size_t back) {
+    CowBlock* block = self->block;
+    size_t size = self->s.size;
+    if(size > SIZE_MAX - front - back - sizeof(CowBlock)) return false;
+    size_t needed = front + size + back;
+    bool unique = block != NULL && atomic_load_explicit(&block->nstrong, memory_order_acquire) == 1;
+    if(unique) {
+        size_t offset = self->s.start - block->data;
+        if(offset >= front && block->capacity - offset - size >= back) return true;
+        if(block->capacity < needed) {
+            size_t capacity = cowstring_grow(block->capacity, needed);
+            CowBlock* grown = realloc(block, sizeof(CowBlock) + capacity);
+            if(grown == NULL) return false;
+            grown->capacity = capacity;
+            block = grown;
+        }
+        memmove(block->data + front, block->data + offset, size);
+        self->block = block;
+        self->s.start = block->data + front;
+        return true;
+    }
+    /* Shared (or never allocated): this handle gets its own copy */
+    size_t capacity = cowstring_grow(0, needed + needed / 2);
+    CowBlock* copy = malloc(sizeof(CowBlock) + capacity);
+    if(copy == NULL) return false;
+    atomic_init(&copy->nstrong, 1);
+    copy->capacity = capacity;
+    if(size != 0) memcpy(copy->data + front, self->s.start, size);
+    cowstring_release(block);
+    self->block = copy;
+    self->s.start = copy->data + front;
+    return true;
+}
+
+/* @brief:  Creates a copy-on-write string holding a copy of str
+ * @param:  String str - initial contents (does not need to be null terminated)
+ * @return: WRESULT(CowString) - the new string, the only owner of its block */
+WRESULT(CowString) cowstring_new(String str) {
+    CowString self = {0};
+#ifdef DSTRING_VALIDATE_UTF8
+    if(!string_utf8_validate(str)) return WRESULT_ERR(CowString, self);
+#endif
+    if(!cowstring_make_room(&self, 0, str.size)) return WRESULT_ERR(CowString, self);
+    if(str.size != 0) memcpy(self.s.start, str.start, str.size);
+    self.s.size = str.size;
+    return WRESULT_OK(CowString, self);
+}
+
+/* @brief:  Makes another handle to the same bytes. O(1), nothing is copied
+ *          until one of the handles is modified
+ * @param:  const CowString* self - string to share
+ * @return: CowString - the new handle, release it with cowstring_delete */
+CowString cowstring_copy(const CowString* self) {
+    if(self->block != NULL) atomic_fetch_add_explicit(&self->block->nstrong, 1, memory_order_relaxed);
+    return *self;
+}
+
+/* @brief:  Checks whether other handles share the bytes of this string
+ * @param:  const CowString* self - string to check
+ * @return: bool - true if a mutation would have to copy the bytes first */
+bool cowstring_is_shared(const CowString* self) {
+    return self->block != NULL && atomic_load_explicit(&self->block->nstrong, memory_order_acquire) != 1;
+}
+
+/* @brief:  Appends a string slice, copying the bytes first if they are shared
+ * @param:  CowString* self - reference to the string
+ * @param:  String str - slice to append (must not point into self)
+ * @return: WRESULT(size_t) - new size of string */
+WRESULT(size_t) cowstring_append(CowString* self, String str) {
+    if(self == NULL) return WRESULT_ERR(size_t, 0);
+#ifdef DSTRING_VALIDATE_UTF8
+    if(!string_utf8_validate(str)) return WRESULT_ERR(size_t, self->s.size);
+#endif
+    if(str.size == 0) return WRESULT_OK(size_t, self->s.size);
+    if(!cowstring_make_room(self, 0, str.size)) return WRESULT_ERR(size_t, self->s.size);
+    memcpy(self->s.start + self->s.size, str.start, str.size);
+    self->s.size += str.size;
+    return WRESULT_OK(size_t, self->s.size);
+}
+
+/* @brief:  Prepends a string slice, copying the bytes first if they are
+ *          shared. Space freed by an earlier strippref is reused
+ * @param:  CowString* self - reference to the string
+ * @param:  String str - slice to prepend (must not point into self)
+ * @return: WRESULT(size_t) - new size of string */
+WRESULT(size_t) cowstring_prepend(CowString* self, String str) {
+    if(self == NULL) return WRESULT_ERR(size_t, 0);
+#ifdef DSTRING_VALIDATE_UTF8
+    if(!string_utf8_validate(str)) return WRESULT_ERR(size_t, self->s.size);
+#endif
+    if(str.size == 0) return WRESULT_OK(size_t, self->s.size);
+    if(!cowstring_make_room(self, str.size, 0)) return WRESULT_ERR(size_t, self->s.size);
+    self->s.start -= str.size;
+    memcpy(self->s.start, str.start, str.size);
+    self->s.size += str.size;
+    return WRESULT_OK(size_t, self->s.size);
+}
+
+/* @brief:  Removes n characters from the beginning of the string. Only the
+ *          view of this handle changes, so this never copies
+ * @param:  CowString* self - reference to the string
+ * @param:  size_t n - number of characters to remove
+ * @return: WRESULT(size_t) - new size of string */
+WRESULT(size_t) cowstring_strippref(CowString* self, size_t n) {
+    if(self == NULL || n > self->s.size) return WRESULT_ERR(size_t, 0);
+    self->s.start += n;
+    self->s.size -= n;
+    return WRESULT_OK(size_t, self->s.size);
+}
+
+/* @brief:  Removes n characters from the end of the string. Only the view of
+ *          this handle changes, so this never copies
+ * @param:  CowString* self - reference to the string
+ * @param:  size_t n - number of characters to remove
+ * @return: WRESULT(size_t) - new size of string */
+WRESULT(size_t) cowstring_stripsuff(CowString* self, size_t n) {
+    if(self == NULL || n > self->s.size) return WRESULT_ERR(size_t, 0);
+    self->s.size -= n;
+    return WRESULT_OK(size_t, self->s.size);
+}
+
+/* @brief:  Releases this handle, freeing the bytes if it was the last one
+ * @param:  void* self - CowString* to delete (void* so it can be used as a
+ *          cleanup function) */
+void cowstring_delete(void* self) {
+    CowString* str = self;
+    cowstring_release(str->block);
+    *str = (CowString){0};
+}
+
+#endif
+#endif
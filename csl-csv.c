@@ -0,0 +1,289 @@
+/*******************************************************************************
+* Name:             csl-csv.c                                                  *
+* Description:      Vectorized CSV/TSV record parser over String               *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   The input is classified 64 bytes at a time into bitmasks   *
+*                   of quotes, delimiters and newlines (AVX2 or SSE2 compares  *
+*                   and movemask, in the style of simdjson/simdcsv). The       *
+*                   prefix XOR of the quote mask marks every byte that is      *
+*                   inside quotes, so delimiters and newlines inside quoted    *
+*                   fields drop out with one AND NOT, and the parity carries   *
+*                   into the next block. Field boundaries are then read off    *
+*                   the remaining bits with count-trailing-zeros. Fields are   *
+*                   String slices into the input. Only quoted fields that      *
+*                   contain an escaped quote ("") are copied, unescaped, into  *
+*                   the arena given by the caller.                             *
+* Usage:            CsvParser csv = csv_parser_new(input, ',', &arena);        *
+*                   WRESULT(CsvRecord) rec;                                    *
+*                   while(!(rec = csv_next(&csv)).err) {                       *
+*                       for(size_t i = 0; i < rec.value.nfields; i++) ...      *
+*                   }                                                          *
+*                   if(rec.code != CSV_END) ...  // malformed input            *
+*                   csv_parser_delete(&csv);                                   *
+*                                                                              *
+*                   - Records end at \n, and a \r before it is dropped, so    *
+*                       both LF and CRLF files work. The last record does not  *
+*                       need a newline.                                        *
+*                   - The fields of a record are only valid until the next     *
+*                       call to csv_next.                                      *
+*                   - The arena can be NULL if no field is expected to contain *
+*                       "" (csv_next errors with CSV_ARENA_FULL if one does).  *
+*******************************************************************************/
+
+#ifndef __CSL_CSV_C
+#define __CSL_CSV_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+#ifndef ARENA_HEADER
+#define ARENA_HEADER
+#endif
+#include "csl-arenas.c"
+
+typedef struct {
+    String* fields;
+    size_t nfields;
+} CsvRecord;
+
+DERIVE_WRESULT(CsvRecord, CSV_END, CSV_UNTERMINATED_QUOTE, CSV_ARENA_FULL, CSV_ALLOC_FAILED);
+
+typedef struct {
+    String input;
+    char delimiter;
+    char quote;
+    Arena* arena;           // destination of unescaped fields (may be NULL)
+    String* fields;         // fields of the current record
+    size_t capacity;
+    size_t next_block;      // offset of the next 64 byte block to classify
+    size_t block;           // offset of the block the mask belongs to
+    uint64_t mask;          // unread field boundaries in the current block
+    uint64_t inquote;       // all ones if the previous block ended inside quotes
+    size_t pos;             // start of the next field
+    bool avx2;
+} CsvParser;
+
+CsvParser csv_parser_new(String input, char delimiter, Arena* arena);
+WRESULT(CsvRecord) csv_next(CsvParser* self);
+void csv_parser_delete(CsvParser* self);
+
+#if !defined(CSL_CSV_INTERFACE)
+
+/* Bit i set for every byte from an odd numbered quote up to (not including)
+ * the next one */
+static inline uint64_t csv_prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+typedef struct {
+    uint64_t quote;
+    uint64_t structural;    // delimiters and newlines
+} CsvMasks;
+
+#ifdef STRING_X86
+__attribute__((target("avx2")))
+static CsvMasks csv_classify_avx2(const uint8_t* p, char quote, char delimiter) {
+    const __m256i q = _mm256_set1_epi8(quote);
+    const __m256i d = _mm256_set1_epi8(delimiter);
+    const __m256i nl = _mm256_set1_epi8('\n');
+    CsvMasks masks = {0};
+    for(int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + 32 * i));
+        uint64_t quotes = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, q));
+        uint64_t structural = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, d), _mm256_cmpeq_epi8(v, nl))
+        );
+        masks.quote |= quotes << (32 * i);
+        masks.structural |= structural << (32 * i);
+    }
+    return masks;
+}
+
+static CsvMasks csv_classify_sse2(const uint8_t* p, char quote, char delimiter) {
+    const __m128i q = _mm_set1_epi8(quote);
+    const __m128i d = _mm_set1_epi8(delimiter);
+    const __m128i nl = _mm_set1_epi8('\n');
+    CsvMasks masks = {0};
+    for(int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + 16 * i));
+        uint64_t quotes = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, q));
+        uint64_t structural = (uint16_t)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, d), _mm_cmpeq_epi8(v, nl))
+        );
+        masks.quote |= quotes << (16 * i);
+        masks.structural |= structural << (16 * i);
+    }
+    return masks;
+}
+#else
+static CsvMasks csv_classify_scalar(const uint8_t* p, char quote, char delimiter) {
+    CsvMasks masks = {0};
+    for(int i = 0; i < 64; i++) {
+        masks.quote |= (uint64_t)(p[i] == (uint8_t)quote) << i;
+        masks.structural |= (uint64_t)(p[i] == (uint8_t)delimiter || p[i] == '\n') << i;
+    }
+    return masks;
+}
+#endif
+
+/* Classifies the next block, false at the end of the input */
+static bool csv_load_block(CsvParser* self) {
+    size_t offset = self->next_block;
+    if(offset >= self->input.size) return false;
+    const uint8_t* p = (const uint8_t*)self->input.start + offset;
+    uint8_t tail[64];
+    size_t left = self->input.size - offset;
+    if(left < 64) {
+        /* Zero padding never matches (unless a separator is '\0') and is masked off below */
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, p, left);
+        p = tail;
+    }
+    CsvMasks masks;
+#ifdef STRING_X86
+    if(self->avx2) masks = csv_classify_avx2(p, self->quote, self->delimiter);
+    else masks = csv_classify_sse2(p, self->quote, self->delimiter);
+#else
+    masks = csv_classify_scalar(p, self->quote, self->delimiter);
+#endif
+    if(left < 64) {
+        uint64_t valid = (UINT64_C(1) << left) - 1;
+        masks.quote &= valid;
+        masks.structural &= valid;
+    }
+    uint64_t inside = csv_prefix_xor(masks.quote) ^ self->inquote;
+    self->inquote = (uint64_t)((int64_t)inside >> 63);
+    self->mask = masks.structural & ~inside;
+    self->block = offset;
+    self->next_block = offset + 64;
+    return true;
+}
+
+/* Turns the raw bytes of a field into its value: strips the surrounding
+ * quotes and unescapes "" into the arena when needed */
+static bool csv_field(CsvParser* self, String raw, String* out) {
+    const char q = self->quote;
+    if(raw.size == 0 || raw.start[0] != q) {
+        *out = raw;
+        return true;
+    }
+    String inner = { .start = raw.start + 1, .size = raw.size - 1 };
+    if(inner.size != 0 && inner.start[inner.size - 1] == q) inner.size--;
+    const char* escape = inner.size ? memchr(inner.start, q, inner.size) : NULL;
+    if(escape == NULL) {
+        *out = inner;
+        return true;
+    }
+    char* dst = self->arena ? arena_alloc(self->arena, inner.size) : NULL;
+    if(dst == NULL) return false;
+    size_t n = escape - inner.start;
+    memcpy(dst, inner.start, n);
+    for(size_t i = n; i < inner.size; i++) {
+        dst[n++] = inner.start[i];
+        if(inner.start[i] == q && i + 1 < inner.size && inner.start[i + 1] == q) i++;
+    }
+    *out = (String){ .start = dst, .size = n };
+    return true;
+}
+
+/* Adds a field to the current record, growing the field array if needed */
+static bool csv_push(CsvParser* self, size_t* nfields, String raw, int* error) {
+    if(*nfields == self->capacity) {
+        size_t capacity = self->capacity ? self->capacity * 2 : 16;
+        String* fields = realloc(self->fields, capacity * sizeof(String));
+        if(fields == NULL) {
+            *error = CSV_ALLOC_FAILED;
+            return false;
+        }
+        self->fields = fields;
+        self->capacity = capacity;
+    }
+    if(!csv_field(self, raw, &self->fields[*nfields])) {
+        *error = CSV_ARENA_FULL;
+        return false;
+    }
+    (*nfields)++;
+    return true;
+}
+
+/* @brief:  Creates a parser over delimiter separated text
+ * @param:  String input - the whole input (e.g. from string_map_file)
+ * @param:  char delimiter - field separator, ',' for CSV and '\t' for TSV
+ * @param:  Arena* arena - where unescaped quoted fields are written (may be NULL)
+ * @return: CsvParser - the parser, positioned at the first record */
+CsvParser csv_parser_new(String input, char delimiter, Arena* arena) {
+    CsvParser self = {
+        .input = input,
+        .delimiter = delimiter,
+        .quote = '"',
+        .arena = arena,
+    };
+#ifdef STRING_X86
+    self.avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return self;
+}
+
+/* @brief:  Parses the next record
+ * @param:  CsvParser* self - the parser
+ * @return: WRESULT(CsvRecord) - the fields of the record, valid until the next
+ *          call. Errors with CSV_END when the input is exhausted,
+ *          CSV_UNTERMINATED_QUOTE if the input ends inside quotes, or
+ *          CSV_ARENA_FULL/CSV_ALLOC_FAILED when memory runs out */
+WRESULT(CsvRecord) csv_next(CsvParser* self) {
+    CsvRecord record = { .fields = self->fields, .nfields = 0 };
+    if(self->pos >= self->input.size) return WRESULT_ERR_CODED(CsvRecord, record, CSV_END);
+    const char* p = self->input.start;
+    size_t n = 0;
+    int error = 0;
+    for(;;) {
+        while(self->mask == 0) {
+            if(csv_load_block(self)) continue;
+            /* End of input ends the last record */
+            if(self->inquote) {
+                self->pos = self->input.size;
+                return WRESULT_ERR_CODED(CsvRecord, record, CSV_UNTERMINATED_QUOTE);
+            }
+            String raw = { .start = (char*)p + self->pos, .size = self->input.size - self->pos };
+            if(raw.size != 0 && raw.start[raw.size - 1] == '\r') raw.size--;
+            self->pos = self->input.size;
+            if(!csv_push(self, &n, raw, &error)) return WRESULT_ERR_CODED(CsvRecord, record, error);
+            record = (CsvRecord){ .fields = self->fields, .nfields = n };
+            return WRESULT_OK(CsvRecord, record);
+        }
+        size_t at = self->block + __builtin_ctzll(self->mask);
+        self->mask &= self->mask - 1;
+        String raw = { .start = (char*)p + self->pos, .size = at - self->pos };
+        bool newline = p[at] == '\n';
+        if(newline && raw.size != 0 && raw.start[raw.size - 1] == '\r') raw.size--;
+        self->pos = at + 1;
+        if(!csv_push(self, &n, raw, &error)) return WRESULT_ERR_CODED(CsvRecord, record, error);
+        if(newline) {
+            record = (CsvRecord){ .fields = self->fields, .nfields = n };
+            return WRESULT_OK(CsvRecord, record);
+        }
+    }
+}
+
+/* @brief:  Frees the field array of the parser (not the input or the arena)
+ * @param:  CsvParser* self - parser to delete */
+void csv_parser_delete(CsvParser* self) {
+    free(self->fields);
+    self->fields = NULL;
+    self->capacity = 0;
+}
+
+#endif
+#endif
@@ -0,0 +1,326 @@
+/* vim: set ft=c : */
+
+/********************************************************************************
+* Name:         csl-epoch.h                                                     *
+* Description:  epoch based memory reclamation for lock-free data structures   *
+* By:           Nigel Sinclair                                                  *
+* Github:       https://github.com/sincngraeme                                  *
+* Implementation:                                                               *
+*               Readers announce the global epoch when they enter a critical    *
+*               section (one atomic exchange on a thread-local line) and clear  *
+*               the announcement when they leave (one store). Writers unlink    *
+*               memory and retire it with its destructor into a per-thread bag  *
+*               for the current epoch. The global epoch only moves from e to    *
+*               e + 1 once every thread inside a critical section has announced *
+*               e, so memory retired in epoch e can no longer be seen once the  *
+*               global epoch reaches e + 2. Every thread keeps 3 bags (one per  *
+*               epoch mod 3) and frees a whole bag at a time.                   *
+* Usage:                                                                        *
+*               #define EPOCH_IMPLEMENTATION                                    *
+*               #include "csl-epoch.h"                                          *
+*                                                                               *
+*               epoch_enter();                                                  *
+*               Node* node = atomic_load(&head);    // safe to read until leave *
+*               epoch_leave();                                                  *
+*                                                                               *
+*               Node* old = atomic_exchange(&head, new_node);                   *
+*               epoch_retire(old, free);            // freed once unreachable   *
+*                                                                               *
+*               - Critical sections nest, and must not block for long: a thread *
+*                   stuck inside one stops memory from being freed everywhere.  *
+*               - epoch_barrier() frees everything retired so far (waiting for  *
+*                   readers), for shutdown and tests.                           *
+*               - Bags left behind by exiting threads are freed by the others.  *
+********************************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef EPOCH_IMPLEMENTATION
+
+/* For optionally removing attributes, or providing alternative syntax */
+#ifndef epoch_attribute
+#define epoch_attribute(attr) __attribute__((attr))
+#endif
+
+/* Retires between attempts to advance the epoch and free old bags */
+#ifndef EPOCH_RETIRE_BATCH
+#define EPOCH_RETIRE_BATCH 64
+#endif
+
+#define EPOCH_ACTIVE ((uint64_t)1)
+
+typedef struct {
+    void* ptr;
+    void (*destructor)(void*);
+} epoch_retired;
+
+/* Memory retired by one thread during one epoch */
+typedef struct epoch_bag {
+    uint64_t epoch;
+    size_t count;
+    size_t capacity;
+    epoch_retired* items;
+    struct epoch_bag* next;         // only used for bags of exited threads
+} epoch_bag;
+
+/* Records are never freed, a thread that exits leaves its record for the next new thread */
+typedef struct epoch_thread {
+    atomic_uint_least64_t state;    // announced epoch << 1 | EPOCH_ACTIVE
+    atomic_bool in_use;
+    struct epoch_thread* next;
+    size_t depth;                   // critical section nesting (owner only)
+    size_t since_collect;           // retires since the last attempt to advance (owner only)
+    epoch_bag bags[3];              // indexed by epoch % 3 (owner only)
+} epoch_thread;
+
+static struct {
+    atomic_uint_least64_t epoch;
+    _Atomic(epoch_thread*) threads;
+    pthread_mutex_t orphans_lock;
+    epoch_bag* orphans;             // bags of exited threads, still waiting for their epoch to pass
+    atomic_size_t norphans;         // so threads can skip the lock when there are none
+    pthread_key_t key;
+    pthread_once_t once;
+} epoch_global = {
+    .epoch = 0,
+    .threads = NULL,
+    .orphans_lock = PTHREAD_MUTEX_INITIALIZER,
+    .orphans = NULL,
+    .norphans = 0,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local epoch_thread* epoch_self;
+
+/* Runs the destructors of a bag and empties it (the storage is kept) */
+static void epoch_bag_free(epoch_bag* bag) {
+    for(size_t i = 0; i < bag->count; i++) bag->items[i].destructor(bag->items[i].ptr);
+    bag->count = 0;
+}
+
+/* A bag retired in epoch e is unreachable once the global epoch is e + 2 */
+static inline bool epoch_bag_safe(const epoch_bag* bag, uint64_t global) {
+    return bag->count != 0 && bag->epoch + 2 <= global;
+}
+
+/* pthread key destructor: hands the thread's unfreed bags to the other threads and releases its record */
+static void epoch_thread_exit(void* arg) {
+    epoch_thread* self = arg;
+    uint64_t global = atomic_load_explicit(&epoch_global.epoch, memory_order_acquire);
+    for(size_t i = 0; i < 3; i++) {
+        epoch_bag* bag = &self->bags[i];
+        if(bag->count == 0) {
+            free(bag->items);
+        } else if(epoch_bag_safe(bag, global)) {
+            epoch_bag_free(bag);
+            free(bag->items);
+        } else {
+            /* If there's no memory for the orphan, the bag leaks (it can't be freed early) */
+            epoch_bag* orphan = malloc(sizeof(epoch_bag));
+            if(orphan != NULL) {
+                *orphan = *bag;
+                pthread_mutex_lock(&epoch_global.orphans_lock);
+                orphan->next = epoch_global.orphans;
+                epoch_global.orphans = orphan;
+                atomic_fetch_add_explicit(&epoch_global.norphans, 1, memory_order_relaxed);
+                pthread_mutex_unlock(&epoch_global.orphans_lock);
+            }
+        }
+        self->bags[i] = (epoch_bag){0};
+    }
+    self->depth = 0;
+    self->since_collect = 0;
+    atomic_store_explicit(&self->state, 0, memory_order_release);
+    atomic_store_explicit(&self->in_use, false, memory_order_release);
+    epoch_self = NULL;
+}
+
+static void epoch_make_key(void) {
+    pthread_key_create(&epoch_global.key, epoch_thread_exit);
+}
+
+/* Takes a free record, or links a new one into the list */
+epoch_attribute(noinline)
+static epoch_thread* epoch_register(void) {
+    pthread_once(&epoch_global.once, epoch_make_key);
+    epoch_thread* self = NULL;
+    for(epoch_thread* t = atomic_load_explicit(&epoch_global.threads, memory_order_acquire); t != NULL; t = t->next) {
+        bool expected = false;
+        if(!atomic_load_explicit(&t->in_use, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&t->in_use, &expected, true, memory_order_acquire, memory_order_relaxed)
+        ) {
+            self = t;
+            break;
+        }
+    }
+    if(self == NULL) {
+        self = calloc(1, sizeof(epoch_thread));
+        if(self == NULL) abort();       // without a record the thread can't announce anything
+        atomic_init(&self->in_use, true);
+        atomic_init(&self->state, 0);
+        epoch_thread* head = atomic_load_explicit(&epoch_global.threads, memory_order_relaxed);
+        do {
+            self->next = head;
+        } while(!atomic_compare_exchange_weak_explicit(
+            &epoch_global.threads, &head, self, memory_order_release, memory_order_relaxed
+        ));
+    }
+    pthread_setspecific(epoch_global.key, self);
+    epoch_self = self;
+    return self;
+}
+
+static inline epoch_thread* epoch_thread_get(void) {
+    epoch_thread* self = epoch_self;
+    return self != NULL ? self : epoch_register();
+}
+
+/* @brief:      Enters a critical section. Memory read from shared structures stays valid until the
+ *              matching epoch_leave. Sections nest */
+epoch_attribute(unused)
+static inline void epoch_enter(void) {
+    epoch_thread* self = epoch_thread_get();
+    if(self->depth++ != 0) return;
+    uint64_t epoch = atomic_load_explicit(&epoch_global.epoch, memory_order_relaxed);
+    /* The announcement has to be visible before any shared memory is read (a store-load ordering), which
+     * takes a full barrier. An exchange is that barrier on x86 */
+    atomic_exchange_explicit(&self->state, epoch << 1 | EPOCH_ACTIVE, memory_order_seq_cst);
+}
+
+/* @brief:      Leaves a critical section. Nothing read inside it may be used afterwards */
+epoch_attribute(unused)
+static inline void epoch_leave(void) {
+    epoch_thread* self = epoch_self;
+    assert(self != NULL && self->depth != 0 && "epoch_leave without epoch_enter");
+    if(--self->depth != 0) return;
+    atomic_store_explicit(&self->state, 0, memory_order_release);
+}
+
+/* @brief:      Moves the global epoch on if every thread in a critical section has seen the current one
+ * @return:     bool - true if the epoch moved */
+epoch_attribute(unused)
+static bool epoch_try_advance(void) {
+    uint64_t epoch = atomic_load_explicit(&epoch_global.epoch, memory_order_seq_cst);
+    for(epoch_thread* t = atomic_load_explicit(&epoch_global.threads, memory_order_acquire); t != NULL; t = t->next) {
+        uint64_t state = atomic_load_explicit(&t->state, memory_order_seq_cst);
+        if((state & EPOCH_ACTIVE) && (state >> 1) != epoch) return false;
+    }
+    return atomic_compare_exchange_strong_explicit(
+        &epoch_global.epoch, &epoch, epoch + 1, memory_order_acq_rel, memory_order_relaxed
+    );
+}
+
+/* Frees the orphaned bags whose epoch has passed */
+static void epoch_collect_orphans(uint64_t global) {
+    if(atomic_load_explicit(&epoch_global.norphans, memory_order_relaxed) == 0) return;
+    if(pthread_mutex_trylock(&epoch_global.orphans_lock) != 0) return;
+    epoch_bag* safe = NULL;
+    for(epoch_bag** link = &epoch_global.orphans; *link != NULL;) {
+        epoch_bag* bag = *link;
+        if(epoch_bag_safe(bag, global)) {
+            *link = bag->next;
+            bag->next = safe;
+            safe = bag;
+            atomic_fetch_sub_explicit(&epoch_global.norphans, 1, memory_order_relaxed);
+        } else {
+            link = &bag->next;
+        }
+    }
+    pthread_mutex_unlock(&epoch_global.orphans_lock);
+    /* Destructors run outside the lock, they may retire more memory */
+    while(safe != NULL) {
+        epoch_bag* next = safe->next;
+        epoch_bag_free(safe);
+        free(safe->items);
+        free(safe);
+        safe = next;
+    }
+}
+
+/* @brief:      Tries to advance the epoch, then frees the calling thread's bags (and any orphaned ones)
+ *              that are no longer reachable. epoch_retire does this every EPOCH_RETIRE_BATCH retires */
+epoch_attribute(unused)
+static void epoch_collect(void) {
+    epoch_thread* self = epoch_thread_get();
+    self->since_collect = 0;
+    epoch_try_advance();
+    uint64_t global = atomic_load_explicit(&epoch_global.epoch, memory_order_acquire);
+    for(size_t i = 0; i < 3; i++) {
+        if(epoch_bag_safe(&self->bags[i], global)) epoch_bag_free(&self->bags[i]);
+    }
+    epoch_collect_orphans(global);
+}
+
+/* @brief:      Defers destructor(ptr) until no thread can still be reading ptr. Unlink ptr from every
+ *              shared structure first
+ * @param:      void* ptr - memory to reclaim
+ * @param:      void (*destructor)(void*) - called on ptr once it is unreachable (e.g. free) */
+epoch_attribute(unused)
+static void epoch_retire(void* ptr, void (*destructor)(void*)) {
+    epoch_thread* self = epoch_thread_get();
+    /* seq_cst so the epoch is read after the unlink that came before the retire */
+    uint64_t epoch = atomic_load_explicit(&epoch_global.epoch, memory_order_seq_cst);
+    epoch_bag* bag = &self->bags[epoch % 3];
+    /* The bag in this slot is 3 epochs old, so it's safe */
+    if(bag->count != 0 && bag->epoch != epoch) epoch_bag_free(bag);
+    bag->epoch = epoch;
+    if(bag->count == bag->capacity) {
+        size_t capacity = bag->capacity ? bag->capacity * 2 : EPOCH_RETIRE_BATCH;
+        epoch_retired* items = realloc(bag->items, capacity * sizeof(epoch_retired));
+        if(items == NULL) {
+            /* No room to defer it: wait until it's unreachable and free it now. Inside a critical section
+             * that would never happen, so it leaks instead */
+            if(self->depth != 0) return;
+            while(atomic_load_explicit(&epoch_global.epoch, memory_order_acquire) < epoch + 2) {
+                if(!epoch_try_advance()) sched_yield();
+            }
+            destructor(ptr);
+            return;
+        }
+        bag->items = items;
+        bag->capacity = capacity;
+    }
+    bag->items[bag->count++] = (epoch_retired){ .ptr = ptr, .destructor = destructor };
+    if(++self->since_collect >= EPOCH_RETIRE_BATCH && self->depth == 0) epoch_collect();
+}
+
+/* @brief:      Number of retired objects of the calling thread that have not been freed yet
+ * @return:     size_t */
+epoch_attribute(unused)
+static size_t epoch_pending(void) {
+    epoch_thread* self = epoch_self;
+    if(self == NULL) return 0;
+    return self->bags[0].count + self->bags[1].count + self->bags[2].count;
+}
+
+/* @brief:      Frees everything the calling thread (and any exited thread) has retired so far, waiting
+ *              for other threads to leave their critical sections. Must not be called inside one */
+epoch_attribute(unused)
+static void epoch_barrier(void) {
+    epoch_thread* self = epoch_thread_get();
+    assert(self->depth == 0 && "epoch_barrier inside a critical section would never return");
+    for(;;) {
+        epoch_collect();
+        if(epoch_pending() == 0 && atomic_load_explicit(&epoch_global.norphans, memory_order_acquire) == 0) return;
+        sched_yield();
+    }
+}
+
+static inline void _epoch_scope_leave(bool* entered) {
+    (void)entered;
+    epoch_leave();
+}
+
+#define EPOCH_CONCAT_(a, b) a##b
+#define EPOCH_CONCAT(a, b) EPOCH_CONCAT_(a, b)
+/* Enters a critical section that is left at the end of the enclosing scope */
+#define epoch_scope() \
+    epoch_attribute(cleanup(_epoch_scope_leave)) bool EPOCH_CONCAT(epoch_scope_, __LINE__) = (epoch_enter(), true)
+
+#endif
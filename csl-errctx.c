@@ -0,0 +1,374 @@
+/*******************************************************************************
+* Name:             csl-errctx.c                                               *
+* Description:      Lazily formatted error context chains for WRESULT          *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   An error context is a linked list of frames, newest first. *
+*                   Each frame holds a static format string, __FILE__,         *
+*                   __LINE__ and a copy of the raw arguments, each tagged with *
+*                   its type (picked by _Generic). Frames come from a thread   *
+*                   local scratch arena, so recording one is a pointer bump    *
+*                   and a handful of stores: no malloc and no formatting. The  *
+*                   text is only built when the chain is printed, by walking   *
+*                   the format and handing each conversion to snprintf with    *
+*                   the length modifier rewritten to match the stored          *
+*                   argument (integers are always stored as long long).        *
+* Usage:            DERIVE_WRESULT_CTX(Config, CONFIG_NOT_FOUND);              *
+*                                                                              *
+*                   return WRESULT_ERR_CODED_CTX(Config, cfg, CONFIG_NOT_FOUND,*
+*                       NULL, "no key %s in %s", key, path);                   *
+*                   ...                                                        *
+*                   // Add a frame on the way up                               *
+*                   return WRESULT_ERR_CTX(App, app, result.ctx,               *
+*                       "loading config %d of %d", i, n);                      *
+*                   ...                                                        *
+*                   errctx_print(result.ctx, stderr);                          *
+*                   errctx_clear();     // error handled, reuse the arena      *
+*                                                                              *
+*                   - Format arguments must outlive the chain: strings are     *
+*                       stored by pointer (like String slices), not copied.    *
+*                   - Frames stay valid until errctx_clear() is called on the  *
+*                       same thread. When the arena is full, new frames are    *
+*                       dropped (the chain is returned unchanged).             *
+*                   - Arguments are int/unsigned/float types (any width),      *
+*                       char*, void*, String and DString.                      *
+*******************************************************************************/
+
+#ifndef __CSL_ERRCTX_C
+#define __CSL_ERRCTX_C
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+#ifndef ARENA_HEADER
+#define ARENA_HEADER
+#endif
+#include "csl-arenas.c"
+#include "csl-recursed.h"
+
+/* Size of the per thread frame arena */
+#ifndef ERRCTX_ARENA_SIZE
+#define ERRCTX_ARENA_SIZE (16 * 1024)
+#endif
+
+enum ErrCtxArgType {
+    ERRCTX_ARG_INT,
+    ERRCTX_ARG_UINT,
+    ERRCTX_ARG_DOUBLE,
+    ERRCTX_ARG_CSTR,
+    ERRCTX_ARG_PTR,
+    ERRCTX_ARG_STRING,
+};
+
+typedef struct {
+    enum ErrCtxArgType type;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const char* cstr;
+        const void* ptr;
+        String str;
+    };
+} ErrCtxArg;
+
+typedef struct ErrCtxFrame {
+    struct ErrCtxFrame* next;   // the frame this one was added on top of (the cause)
+    const char* fmt;
+    const char* file;
+    uint32_t line;
+    uint32_t nargs;
+    ErrCtxArg args[];
+} ErrCtxFrame;
+
+/* @brief:  defines a result type that also carries an error context chain.
+ *          Same as DERIVE_WRESULT with an extra `ctx` member (NULL on success)
+ * @param:  type - the type that result will be derived for
+ */
+#define DERIVE_WRESULT_CTX(T, ...)  \
+    typedef struct {                \
+        bool err;                   \
+        __VA_OPT__(                 \
+         enum {                     \
+            WRESULT_##T##_NO_CODE,  \
+            __VA_ARGS__             \
+         } code;                    \
+        )                           \
+        ErrCtxFrame* ctx;           \
+        T value;                    \
+    } WRESULT(T)
+
+/* Captures one argument with its type */
+#define ERRCTX_ARG(x)                                   \
+    _Generic((x),                                       \
+        _Bool: errctx_arg_uint,                         \
+        char: errctx_arg_int,                           \
+        signed char: errctx_arg_int,                    \
+        short: errctx_arg_int,                          \
+        int: errctx_arg_int,                            \
+        long: errctx_arg_int,                           \
+        long long: errctx_arg_int,                      \
+        unsigned char: errctx_arg_uint,                 \
+        unsigned short: errctx_arg_uint,                \
+        unsigned int: errctx_arg_uint,                  \
+        unsigned long: errctx_arg_uint,                 \
+        unsigned long long: errctx_arg_uint,            \
+        float: errctx_arg_double,                       \
+        double: errctx_arg_double,                      \
+        long double: errctx_arg_double,                 \
+        char*: errctx_arg_cstr,                         \
+        const char*: errctx_arg_cstr,                   \
+        String: errctx_arg_string,                      \
+        DString: errctx_arg_dstring,                    \
+        default: errctx_arg_ptr                         \
+    )(x)
+#define _ERRCTX_ARG(x) ERRCTX_ARG(x),
+
+/* @brief:  records a frame on top of an existing chain
+ * @param:  prev - chain to add to (NULL to start a new one)
+ * @param:  fmt - printf style format, must be a string literal (or outlive
+ *          the chain)
+ * @return: ErrCtxFrame* - the new head of the chain */
+#define ERRCTX(prev, fmt, ...)                                              \
+    _errctx_push((prev), (fmt), __FILE__, __LINE__,                         \
+        (const ErrCtxArg[]){ FOR_EACH(_ERRCTX_ARG, __VA_ARGS__) },          \
+        sizeof((ErrCtxArg[]){ FOR_EACH(_ERRCTX_ARG, __VA_ARGS__) }) / sizeof(ErrCtxArg))
+
+/* @brief:  wraps the value in an error result with a new context frame
+ * @param:  type - the type of the value to be wrapped (derived with
+ *          DERIVE_WRESULT_CTX)
+ * @param:  val - the value to be wrapped
+ * @param:  prev - context of the error being propagated, or NULL
+ * @param:  fmt, ... - message of the new frame
+ */
+#define WRESULT_ERR_CTX(type, val, prev, fmt, ...) \
+    ({ \
+        WRESULT(type) wresult_new = { .value = (val) }; \
+        wresult_new.err = true; \
+        wresult_new.ctx = ERRCTX(prev, fmt __VA_OPT__(,) __VA_ARGS__); \
+        wresult_new; \
+    })
+
+/* @brief:  same as WRESULT_ERR_CTX with an error code */
+#define WRESULT_ERR_CODED_CTX(type, val, errcode, prev, fmt, ...) \
+    ({ \
+        WRESULT(type) wresult_new = { .value = (val) }; \
+        wresult_new.err = true; \
+        wresult_new.code = (errcode); \
+        wresult_new.ctx = ERRCTX(prev, fmt __VA_OPT__(,) __VA_ARGS__); \
+        wresult_new; \
+    })
+
+ErrCtxFrame* _errctx_push(ErrCtxFrame* prev, const char* fmt, const char* file, uint32_t line,
+    const ErrCtxArg* args, size_t nargs);
+WRESULT(size_t) errctx_format(const ErrCtxFrame* frame, DString* out);
+void errctx_print(const ErrCtxFrame* frame, FILE* stream);
+void errctx_clear(void);
+
+static inline ErrCtxArg errctx_arg_int(long long x) {
+    return (ErrCtxArg){ .type = ERRCTX_ARG_INT, .i = x };
+}
+static inline ErrCtxArg errctx_arg_uint(unsigned long long x) {
+    return (ErrCtxArg){ .type = ERRCTX_ARG_UINT, .u = x };
+}
+static inline ErrCtxArg errctx_arg_double(double x) {
+    return (ErrCtxArg){ .type = ERRCTX_ARG_DOUBLE, .d = x };
+}
+static inline ErrCtxArg errctx_arg_cstr(const char* x) {
+    return (ErrCtxArg){ .type = ERRCTX_ARG_CSTR, .cstr = x };
+}
+static inline ErrCtxArg errctx_arg_ptr(const void* x) {
+    return (ErrCtxArg){ .type = ERRCTX_ARG_PTR, .ptr = x };
+}
+static inline ErrCtxArg errctx_arg_string(String x) {
+    return (ErrCtxArg){ .type = ERRCTX_ARG_STRING, .str = x };
+}
+static inline ErrCtxArg errctx_arg_dstring(DString x) {
+    return (ErrCtxArg){ .type = ERRCTX_ARG_STRING, .str = x.s };
+}
+
+#if !defined(CSL_ERRCTX_INTERFACE)
+
+static _Thread_local _Alignas(16) uint8_t errctx_buffer[ERRCTX_ARENA_SIZE];
+static _Thread_local Arena errctx_arena;
+
+/* @brief:  Records a frame (use the ERRCTX macro, which fills in the location
+ *          and captures the arguments)
+ * @param:  ErrCtxFrame* prev - chain to add to, may be NULL
+ * @param:  const char* fmt - format of the message (not copied)
+ * @param:  const char* file - source file
+ * @param:  uint32_t line - source line
+ * @param:  const ErrCtxArg* args - captured arguments
+ * @param:  size_t nargs - number of arguments
+ * @return: ErrCtxFrame* - new head of the chain, or prev if the arena is full */
+ErrCtxFrame* _errctx_push(ErrCtxFrame* prev, const char* fmt, const char* file, uint32_t line,
+    const ErrCtxArg* args, size_t nargs) {
+    if(errctx_arena.scratch.data == NULL) {
+        errctx_arena = (Arena){
+            .strategy = SCRATCH_ALLOC,
+            .scratch = { .data = errctx_buffer, .size = sizeof(errctx_buffer) }
+        };
+    }
+    /* Sizes are kept multiples of 16 so every frame stays aligned */
+    size_t size = (sizeof(ErrCtxFrame) + nargs * sizeof(ErrCtxArg) + 15) & ~(size_t)15;
+    ErrCtxFrame* frame = arena_alloc(&errctx_arena, size);
+    if(frame == NULL) return prev;
+    frame->next = prev;
+    frame->fmt = fmt;
+    frame->file = file;
+    frame->line = line;
+    frame->nargs = (uint32_t)nargs;
+    if(nargs != 0) memcpy(frame->args, args, nargs * sizeof(ErrCtxArg));
+    return frame;
+}
+
+/* @brief:  Forgets every frame recorded on this thread so the arena can be
+ *          reused. Chains from this thread must not be used afterwards */
+void errctx_clear(void) {
+    errctx_arena.scratch.offset = 0;
+}
+
+/* Appends printf output to out */
+__attribute__((format(printf, 2, 3)))
+static bool errctx_appendf(DString* out, const char* spec, ...) {
+    va_list args;
+    va_start(args, spec);
+    int len = vsnprintf(NULL, 0, spec, args);
+    va_end(args);
+    if(len < 0) return false;
+    /* One extra byte for the terminator vsnprintf writes */
+    UNWRAP(dstring_reserve(out, (size_t)len + 1), return false);
+    va_start(args, spec);
+    vsnprintf(out->s.start + out->s.size, (size_t)len + 1, spec, args);
+    va_end(args);
+    out->s.size += len;
+    return true;
+}
+
+/* Formats one conversion. spec holds "%", the flags, width and precision
+ * (length modifiers already removed), conv is the conversion character */
+static bool errctx_format_arg(DString* out, char* spec, size_t len, char conv, const ErrCtxArg* arg) {
+    switch(arg->type) {
+        case ERRCTX_ARG_INT:
+        case ERRCTX_ARG_UINT: {
+            bool is_signed = arg->type == ERRCTX_ARG_INT;
+            if(conv == 'c') {
+                memcpy(spec + len, "c", 2);
+                return errctx_appendf(out, spec, (int)arg->i);
+            }
+            if(strchr("diouxX", conv) == NULL) conv = is_signed ? 'd' : 'u';
+            /* Signedness follows the conversion, like printf itself */
+            spec[len] = 'l';
+            spec[len + 1] = 'l';
+            spec[len + 2] = conv;
+            spec[len + 3] = '\0';
+            if(conv == 'd' || conv == 'i') return errctx_appendf(out, spec, arg->i);
+            return errctx_appendf(out, spec, arg->u);
+        }
+        case ERRCTX_ARG_DOUBLE: {
+            if(strchr("fFeEgGaA", conv) == NULL) conv = 'g';
+            spec[len] = conv;
+            spec[len + 1] = '\0';
+            return errctx_appendf(out, spec, arg->d);
+        }
+        case ERRCTX_ARG_CSTR: {
+            if(conv == 'p') {
+                memcpy(spec + len, "p", 2);
+                return errctx_appendf(out, spec, (const void*)arg->cstr);
+            }
+            memcpy(spec + len, "s", 2);
+            return errctx_appendf(out, spec, arg->cstr ? arg->cstr : "(null)");
+        }
+        case ERRCTX_ARG_PTR: {
+            memcpy(spec + len, "p", 2);
+            return errctx_appendf(out, spec, arg->ptr);
+        }
+        case ERRCTX_ARG_STRING: {
+            /* Slices are not null terminated, so the size becomes the precision
+             * (any precision from the format still limits it) */
+            size_t size = arg->str.size;
+            char* dot = memchr(spec, '.', len);
+            if(dot != NULL) {
+                size_t precision = strtoul(dot + 1, NULL, 10);
+                if(precision < size) size = precision;
+                len = dot - spec;
+            }
+            if(size > INT32_MAX) size = INT32_MAX;
+            memcpy(spec + len, ".*s", 4);
+            return errctx_appendf(out, spec, (int)size, arg->str.start ? arg->str.start : "");
+        }
+    }
+    return false;
+}
+
+/* Formats the message of one frame */
+static bool errctx_format_message(const ErrCtxFrame* frame, DString* out) {
+    const char* p = frame->fmt;
+    size_t next_arg = 0;
+    while(*p != '\0') {
+        const char* percent = strchr(p, '%');
+        size_t literal = percent ? (size_t)(percent - p) : strlen(p);
+        UNWRAP(dstring_append_slice(out, (String){ .start = (char*)p, .size = literal }), return false);
+        if(percent == NULL) break;
+        p = percent + 1;
+        if(*p == '%') {
+            UNWRAP(dstring_append_slice(out, (String){ .start = "%", .size = 1 }), return false);
+            p++;
+            continue;
+        }
+        /* "%" flags width .precision, then skip the length modifiers */
+        char spec[48] = "%";
+        size_t len = 1;
+        while(*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) {
+            if(len < sizeof(spec) - 5) spec[len++] = *p;
+            p++;
+        }
+        while(*p != '\0' && strchr("hlLqjzt", *p) != NULL) p++;
+        if(*p == '\0') break;
+        char conv = *p++;
+        spec[len] = '\0';
+        if(next_arg == frame->nargs) {
+            UNWRAP(dstring_append(out, "(missing)"), return false);
+            continue;
+        }
+        if(!errctx_format_arg(out, spec, len, conv, &frame->args[next_arg++])) return false;
+    }
+    return true;
+}
+
+/* @brief:  Formats a chain, newest frame first, one "file:line: message" line
+ *          per frame
+ * @param:  const ErrCtxFrame* frame - head of the chain (NULL appends nothing)
+ * @param:  DString* out - string to append to
+ * @return: WRESULT(size_t) - size of out */
+WRESULT(size_t) errctx_format(const ErrCtxFrame* frame, DString* out) {
+    if(out == NULL) return WRESULT_ERR(size_t, 0);
+    for(; frame != NULL; frame = frame->next) {
+        if(
+            !errctx_appendf(out, "%s:%u: ", frame->file, (unsigned)frame->line)    ||
+            !errctx_format_message(frame, out)                                      ||
+            !errctx_appendf(out, "\n")
+        ) return WRESULT_ERR(size_t, out->s.size);
+    }
+    return WRESULT_OK(size_t, out->s.size);
+}
+
+/* @brief:  Formats a chain and writes it to a stream
+ * @param:  const ErrCtxFrame* frame - head of the chain
+ * @param:  FILE* stream - where to write it (e.g. stderr) */
+void errctx_print(const ErrCtxFrame* frame, FILE* stream) {
+    DString text = {0};
+    errctx_format(frame, &text);
+    fwrite(text.s.start, 1, text.s.size, stream);
+    dstring_delete(&text);
+}
+
+#endif
+#endif
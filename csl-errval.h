@@ -103,47 +103,127 @@
         T value;                    \
     } WRESULT(T) 
 
-/* @brief:  wraps the value in a result with code OK 
+/* @brief:  defines a compact result type for a given base type. Instead of a
+ *          separate bool (and enum) in front of the value, err and code are
+ *          stored in the top byte of the last 8 byte word of the value, so the
+ *          result is the same size as T. A 16 byte T like String then comes
+ *          back in two registers (RAX:RDX on x86-64 SysV) instead of through
+ *          memory. For pointer results, return the pointer and check it with
+ *          IFNULL instead: NULL already is the error niche.
+ *          Requirements:
+ *          - sizeof(T) is a multiple of 8 and the last word of T is an integer
+ *              or pointer that never uses its top byte (sizes, lengths, user
+ *              space pointers)
+ *          - at most 127 codes
+ *          On error, the top byte of the last word of value holds the flags, so
+ *          only the rest of the value is meaningful.
+ * @param:  type - the type that result will be derived for
+ */
+#define DERIVE_WRESULT_COMPACT(T, ...)                                      \
+    _Static_assert(                                                         \
+        __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,                          \
+        "DERIVE_WRESULT_COMPACT needs a little endian target"               \
+    );                                                                      \
+    _Static_assert(                                                         \
+        sizeof(T) >= 8 && sizeof(T) % 8 == 0,                               \
+        "DERIVE_WRESULT_COMPACT needs a type made of 8 byte words"          \
+    );                                                                      \
+    __VA_OPT__(enum { WRESULT_##T##_NO_CODE, __VA_ARGS__ };)                \
+    typedef union {                                                         \
+        T value;                                                            \
+        struct {                                                            \
+            unsigned long long wresult_pad[sizeof(T) / 8 - 1];              \
+            unsigned long long : 56;                                        \
+            __VA_OPT__(unsigned long long code : 7;)                        \
+            bool err : 1;                                                   \
+        };                                                                  \
+    } WRESULT(T)
+
+/* @brief:  wraps the value in a result with code OK. err is left zero
+ *          initialized, which for compact results is the unused top byte of
+ *          the value
  * @param:  type - the type of the value to be wrapped
  * @parap:  val - the value to be wrapped 
  */
 #define WRESULT_OK(type, val) \
-    (WRESULT(type)){ .err = false, .value = (val) }
+    (WRESULT(type)){ .value = (val) }
 
-/* @brief:  wraps the value in a result with code ERR 
+/* @brief:  wraps the value in a result with code ERR. The value is stored
+ *          before the flags so this also works for compact results
  * @param:  type - the type of the value to be wrapped
  * @parap:  val - the value to be wrapped 
  */
 #define WRESULT_ERR(type, val) \
-    (WRESULT(type)){ .err = true, .value = (val) }
+    ({ \
+        WRESULT(type) wresult_new = { .value = (val) }; \
+        wresult_new.err = true; \
+        wresult_new; \
+    })
 
 /* @brief:  wraps the value in a result with code ERR 
  * @param:  type - the type of the value to be wrapped
  * @parap:  val - the value to be wrapped 
  */
 #define WRESULT_ERR_CODED(type, val, errcode) \
-    (WRESULT(type)){ .err = true, .value = (val), .code = (errcode) }
+    ({ \
+        WRESULT(type) wresult_new = { .value = (val) }; \
+        wresult_new.err = true; \
+        wresult_new.code = (errcode); \
+        wresult_new; \
+    })
+
+/* @brief:  marks a function as an error path: kept out of line and placed away
+ *          from hot code. Use it for error reporting/cleanup functions that
+ *          are called from UNWRAP handlers
+ */
+#define WRESULT_COLD __attribute__((cold, noinline))
 
 /* @brief:  unwraps the value contained in a RESULT() type. Uses the GNU extension
- * statement expressions
+ * statement expressions. The error branch is marked unlikely and the handler
+ * sits behind a cold label, so it is laid out away from the fall-through path
  * @param:  result - the return value of the function to be unwrapped 
  */
 #define UNWRAP(result, handler) \
     ({ \
         typeof(result) wresult = (result); \
-        if (wresult.err) { \
+        if (__builtin_expect(wresult.err, 0)) { \
+            __label__ wresult_cold; \
+            wresult_cold: __attribute__((cold, unused)); \
             handler; \
         } \
         wresult.value; \
     })
 
+/* @brief:  unwraps the value, or returns early from the enclosing function
+ *          with the error
+ *          ex: `size_t n = WRESULT_TRY(dstring_append_slice(&s, str));`
+ *          ex: `size_t n = WRESULT_TRY(dstring_append_slice(&s, str), String);`
+ * @param:  result - the return value of the function to be unwrapped
+ * @param:  T (optional) - base type of the enclosing function's result. If
+ *          omitted, the result is returned as is (the enclosing function must
+ *          return the same type). If given, a WRESULT_ERR(T) with a zeroed
+ *          value is returned (error codes are per type, so they don't carry over)
+ */
+#define WRESULT_TRY(...) \
+    _WRESULT_TRY_SELECT(__VA_ARGS__, _WRESULT_TRY_AS, _WRESULT_TRY_SAME,)(__VA_ARGS__)
+#define _WRESULT_TRY_SELECT(_1, _2, NAME, ...) NAME
+#define _WRESULT_TRY_SAME(result) UNWRAP(result, return wresult)
+#define _WRESULT_TRY_AS(result, T) \
+    UNWRAP(result, { \
+        WRESULT(T) wresult_try = {}; \
+        wresult_try.err = true; \
+        return wresult_try; \
+    })
+
 /* @brief:  skips evaluation of LHS if result is null
  * @param:  result - the return value of the function to be checked for null
  */
 #define IFNULL(result, handler) \
     ({ \
         typeof(result) errval_result = (result); \
-        if (errval_result  == NULL) { \
+        if (__builtin_expect(errval_result == NULL, 0)) { \
+            __label__ errval_cold; \
+            errval_cold: __attribute__((cold, unused)); \
             handler; \
         } \
         errval_result; \
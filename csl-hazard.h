@@ -0,0 +1,332 @@
+/* vim: set ft=c : */
+
+/********************************************************************************
+* Name:         csl-hazard.h                                                    *
+* Description:  hazard pointers for lock-free data structures                   *
+* By:           Nigel Sinclair                                                  *
+* Github:       https://github.com/sincngraeme                                  *
+* Implementation:                                                               *
+*               Every thread has HAZARD_SLOTS hazard slots that other threads   *
+*               can read. A reader publishes the pointer it is about to use in  *
+*               one of them (and checks it is still reachable), a writer        *
+*               retires unlinked memory with its destructor into a per-thread   *
+*               list. Once the list reaches twice the number of hazard slots    *
+*               in use, a scan copies every published hazard into a sorted      *
+*               array and frees whatever is not in it, so each retire costs     *
+*               O(1) amortized and at most that many objects wait per thread.   *
+*               Unlike epochs, a reader that stalls only holds back the objects *
+*               it has published, never everything retired after it.            *
+* Usage:                                                                        *
+*               #define HAZARD_IMPLEMENTATION                                   *
+*               #include "csl-hazard.h"                                         *
+*                                                                               *
+*               Node* node = hazard_protect(0, &head);  // safe until cleared   *
+*               ...                                                             *
+*               hazard_clear(0);                                                *
+*                                                                               *
+*               Node* old = atomic_exchange(&head, new_node);                   *
+*               hazard_retire(old, free);   // freed once nothing protects it   *
+*                                                                               *
+*               - Retired objects left by exiting threads go to the next scan.  *
+*               - hazard_barrier() frees everything retired so far (waiting for *
+*                   hazards to be cleared), for shutdown and tests.             *
+********************************************************************************/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#if defined(HAZARD_IMPLEMENTATION) && !defined(__CSL_HAZARD_H)
+#define __CSL_HAZARD_H
+
+/* For optionally removing attributes, or providing alternative syntax */
+#ifndef hazard_attribute
+#define hazard_attribute(attr) __attribute__((attr))
+#endif
+
+/* Hazard slots per thread */
+#ifndef HAZARD_SLOTS
+#define HAZARD_SLOTS 4
+#endif
+
+/* Smallest retired list that triggers a scan */
+#ifndef HAZARD_SCAN_MIN
+#define HAZARD_SCAN_MIN 64
+#endif
+
+typedef struct {
+    void* ptr;
+    void (*destructor)(void*);
+} hazard_retired;
+
+typedef struct {
+    hazard_retired* items;
+    size_t count;
+    size_t capacity;
+} hazard_list;
+
+/* Records are never freed, a thread that exits leaves its record for the next new thread */
+typedef struct hazard_thread {
+    _Atomic(void*) slots[HAZARD_SLOTS];
+    atomic_bool in_use;
+    struct hazard_thread* next;
+    hazard_list retired;            // owner only
+    void** scratch;                 // sorted hazards during a scan (owner only)
+    size_t scratch_capacity;
+} hazard_thread;
+
+static struct {
+    _Atomic(hazard_thread*) threads;
+    atomic_size_t nthreads;         // records in the list, to size the scan threshold
+    pthread_mutex_t orphans_lock;
+    hazard_list orphans;            // retired by exited threads, taken over by the next scan
+    atomic_size_t norphans;
+    pthread_key_t key;
+    pthread_once_t once;
+} hazard_global = {
+    .threads = NULL,
+    .nthreads = 0,
+    .orphans_lock = PTHREAD_MUTEX_INITIALIZER,
+    .orphans = {0},
+    .norphans = 0,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local hazard_thread* hazard_self;
+
+static bool hazard_list_push(hazard_list* list, hazard_retired item) {
+    if(list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : HAZARD_SCAN_MIN;
+        hazard_retired* items = realloc(list->items, capacity * sizeof(hazard_retired));
+        if(items == NULL) return false;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = item;
+    return true;
+}
+
+static void hazard_scan_thread(hazard_thread* self);
+
+/* pthread key destructor: clears the thread's hazards, frees what it can and hands the rest over */
+static void hazard_thread_exit(void* arg) {
+    hazard_thread* self = arg;
+    for(size_t i = 0; i < HAZARD_SLOTS; i++) atomic_store_explicit(&self->slots[i], NULL, memory_order_release);
+    if(self->retired.count != 0) hazard_scan_thread(self);
+    if(self->retired.count != 0) {
+        pthread_mutex_lock(&hazard_global.orphans_lock);
+        /* If there's no memory to hand them over, the objects leak (they can't be freed early) */
+        for(size_t i = 0; i < self->retired.count; i++) {
+            if(hazard_list_push(&hazard_global.orphans, self->retired.items[i])) {
+                atomic_fetch_add_explicit(&hazard_global.norphans, 1, memory_order_relaxed);
+            }
+        }
+        pthread_mutex_unlock(&hazard_global.orphans_lock);
+    }
+    free(self->retired.items);
+    free(self->scratch);
+    self->retired = (hazard_list){0};
+    self->scratch = NULL;
+    self->scratch_capacity = 0;
+    atomic_store_explicit(&self->in_use, false, memory_order_release);
+    hazard_self = NULL;
+}
+
+static void hazard_make_key(void) {
+    pthread_key_create(&hazard_global.key, hazard_thread_exit);
+}
+
+/* Takes a free record, or links a new one into the list */
+hazard_attribute(noinline)
+static hazard_thread* hazard_register(void) {
+    pthread_once(&hazard_global.once, hazard_make_key);
+    hazard_thread* self = NULL;
+    hazard_thread* t = atomic_load_explicit(&hazard_global.threads, memory_order_acquire);
+    for(; t != NULL; t = t->next) {
+        bool expected = false;
+        if(!atomic_load_explicit(&t->in_use, memory_order_relaxed) && atomic_compare_exchange_strong_explicit(
+            &t->in_use, &expected, true, memory_order_acquire, memory_order_relaxed
+        )) {
+            self = t;
+            break;
+        }
+    }
+    if(self == NULL) {
+        self = calloc(1, sizeof(hazard_thread));
+        if(self == NULL) abort();       // without a record the thread can't protect anything
+        atomic_init(&self->in_use, true);
+        for(size_t i = 0; i < HAZARD_SLOTS; i++) atomic_init(&self->slots[i], NULL);
+        hazard_thread* head = atomic_load_explicit(&hazard_global.threads, memory_order_relaxed);
+        do {
+            self->next = head;
+        } while(!atomic_compare_exchange_weak_explicit(
+            &hazard_global.threads, &head, self, memory_order_release, memory_order_relaxed
+        ));
+        atomic_fetch_add_explicit(&hazard_global.nthreads, 1, memory_order_relaxed);
+    }
+    pthread_setspecific(hazard_global.key, self);
+    hazard_self = self;
+    return self;
+}
+
+static inline hazard_thread* hazard_thread_get(void) {
+    hazard_thread* self = hazard_self;
+    return self != NULL ? self : hazard_register();
+}
+
+/* @brief:      Publishes ptr in one of the calling thread's hazard slots. Only safe if ptr is known to
+ *              be reachable after this call (see hazard_protect)
+ * @param:      size_t slot - slot index (< HAZARD_SLOTS)
+ * @param:      void* ptr - pointer to protect (NULL to clear the slot) */
+hazard_attribute(unused)
+static inline void hazard_set(size_t slot, void* ptr) {
+    assert(slot < HAZARD_SLOTS && "hazard slot out of range");
+    /* seq_cst: the hazard must be visible before the pointer is checked again */
+    atomic_store_explicit(&hazard_thread_get()->slots[slot], ptr, memory_order_seq_cst);
+}
+
+/* @brief:      Clears a hazard slot. The pointer it held may be freed from here on
+ * @param:      size_t slot - slot index (< HAZARD_SLOTS) */
+hazard_attribute(unused)
+static inline void hazard_clear(size_t slot) {
+    assert(slot < HAZARD_SLOTS && "hazard slot out of range");
+    atomic_store_explicit(&hazard_thread_get()->slots[slot], NULL, memory_order_release);
+}
+
+/* Loads src and publishes it until the published value is still the current one */
+static inline void* _hazard_protect(size_t slot, _Atomic(void*)* src) {
+    void* ptr = atomic_load_explicit(src, memory_order_acquire);
+    for(;;) {
+        hazard_set(slot, ptr);
+        void* again = atomic_load_explicit(src, memory_order_acquire);
+        if(again == ptr) return ptr;
+        ptr = again;
+    }
+}
+
+/* @brief:      Loads an atomic pointer and protects it, so it stays valid until the slot is cleared or
+ *              reused, even if another thread unlinks and retires it
+ * @param:      size_t slot - slot index (< HAZARD_SLOTS)
+ * @param:      src - pointer to any _Atomic(T*)
+ * @return:     T* - the protected pointer (may be NULL) */
+#define hazard_protect(slot, src) \
+    ((typeof(atomic_load(src)))_hazard_protect(slot, (_Atomic(void*)*)(src)))
+
+static int hazard_compare(const void* a, const void* b) {
+    uintptr_t x = (uintptr_t)*(void* const*)a;
+    uintptr_t y = (uintptr_t)*(void* const*)b;
+    return (x > y) - (x < y);
+}
+
+/* Frees the retired objects of self that no thread has published */
+static void hazard_scan_thread(hazard_thread* self) {
+    /* Take over anything exited threads left behind */
+    if(atomic_load_explicit(&hazard_global.norphans, memory_order_relaxed) != 0) {
+        pthread_mutex_lock(&hazard_global.orphans_lock);
+        for(size_t i = 0; i < hazard_global.orphans.count; i++) {
+            if(!hazard_list_push(&self->retired, hazard_global.orphans.items[i])) break;
+            hazard_global.orphans.items[i] = (hazard_retired){0};
+            atomic_fetch_sub_explicit(&hazard_global.norphans, 1, memory_order_relaxed);
+        }
+        /* Keep whatever didn't fit */
+        size_t kept = 0;
+        for(size_t i = 0; i < hazard_global.orphans.count; i++) {
+            if(hazard_global.orphans.items[i].ptr != NULL) hazard_global.orphans.items[kept++] = hazard_global.orphans.items[i];
+        }
+        hazard_global.orphans.count = kept;
+        pthread_mutex_unlock(&hazard_global.orphans_lock);
+    }
+
+    size_t capacity = atomic_load_explicit(&hazard_global.nthreads, memory_order_acquire) * HAZARD_SLOTS;
+    if(capacity > self->scratch_capacity) {
+        void** scratch = realloc(self->scratch, capacity * sizeof(void*));
+        if(scratch == NULL) return;     // try again on the next scan
+        self->scratch = scratch;
+        self->scratch_capacity = capacity;
+    }
+    size_t nhazards = 0;
+    hazard_thread* t = atomic_load_explicit(&hazard_global.threads, memory_order_acquire);
+    for(; t != NULL && nhazards + HAZARD_SLOTS <= self->scratch_capacity; t = t->next) {
+        for(size_t i = 0; i < HAZARD_SLOTS; i++) {
+            void* ptr = atomic_load_explicit(&t->slots[i], memory_order_seq_cst);
+            if(ptr != NULL) self->scratch[nhazards++] = ptr;
+        }
+    }
+    /* A record linked after nthreads was read: be safe and try again later */
+    if(t != NULL) return;
+    qsort(self->scratch, nhazards, sizeof(void*), hazard_compare);
+
+    /* Split off the unprotected objects first: their destructors may retire more */
+    hazard_list list = self->retired;
+    size_t kept = 0;
+    size_t nfree = list.count;
+    for(size_t i = 0; i < list.count; i++) {
+        hazard_retired item = list.items[i];
+        if(bsearch(&item.ptr, self->scratch, nhazards, sizeof(void*), hazard_compare) != NULL) {
+            list.items[i] = list.items[kept];
+            list.items[kept++] = item;
+        }
+    }
+    nfree -= kept;
+    hazard_retired* dead = list.items + kept;
+    hazard_retired* copy = malloc((nfree ? nfree : 1) * sizeof(hazard_retired));
+    if(copy == NULL) return;
+    memcpy(copy, dead, nfree * sizeof(hazard_retired));
+    self->retired.count = kept;
+    for(size_t i = 0; i < nfree; i++) copy[i].destructor(copy[i].ptr);
+    free(copy);
+}
+
+/* @brief:      Frees the calling thread's retired objects that nothing protects. hazard_retire does this
+ *              whenever the list reaches twice the number of hazard slots (at least HAZARD_SCAN_MIN) */
+hazard_attribute(unused)
+static void hazard_scan(void) {
+    hazard_scan_thread(hazard_thread_get());
+}
+
+/* @brief:      Defers destructor(ptr) until no hazard slot holds ptr. Unlink ptr from every shared
+ *              structure first
+ * @param:      void* ptr - memory to reclaim
+ * @param:      void (*destructor)(void*) - called on ptr once it is unprotected (e.g. free) */
+hazard_attribute(unused)
+static void hazard_retire(void* ptr, void (*destructor)(void*)) {
+    hazard_thread* self = hazard_thread_get();
+    if(!hazard_list_push(&self->retired, (hazard_retired){ .ptr = ptr, .destructor = destructor })) {
+        /* No room to defer it: scan until it is unprotected and free it now */
+        hazard_scan_thread(self);
+        while(!hazard_list_push(&self->retired, (hazard_retired){ .ptr = ptr, .destructor = destructor })) {
+            sched_yield();
+            hazard_scan_thread(self);
+        }
+    }
+    size_t threshold = 2 * HAZARD_SLOTS * atomic_load_explicit(&hazard_global.nthreads, memory_order_relaxed);
+    if(threshold < HAZARD_SCAN_MIN) threshold = HAZARD_SCAN_MIN;
+    if(self->retired.count >= threshold) hazard_scan_thread(self);
+}
+
+/* @brief:      Number of retired objects of the calling thread that have not been freed yet
+ * @return:     size_t */
+hazard_attribute(unused)
+static size_t hazard_pending(void) {
+    hazard_thread* self = hazard_self;
+    return self != NULL ? self->retired.count : 0;
+}
+
+/* @brief:      Frees everything the calling thread (and any exited thread) has retired so far, waiting for
+ *              the hazards that protect it to be cleared. The calling thread's own slots must be clear */
+hazard_attribute(unused)
+static void hazard_barrier(void) {
+    hazard_thread* self = hazard_thread_get();
+    for(;;) {
+        hazard_scan_thread(self);
+        if(self->retired.count == 0 && atomic_load_explicit(&hazard_global.norphans, memory_order_acquire) == 0) return;
+        sched_yield();
+    }
+}
+
+#endif
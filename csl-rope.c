@@ -0,0 +1,462 @@
+/*******************************************************************************
+* Name:             csl-rope.c                                                 *
+* Description:      Rope string for large, frequently edited text              *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   An implicit treap of chunks. Every node holds up to        *
+*                   ROPE_CHUNK_SIZE bytes inline, the text is the in-order     *
+*                   concatenation of the chunks, and each node caches the      *
+*                   byte count of its subtree so positions are found by        *
+*                   descending on sizes. Random node priorities keep the tree  *
+*                   balanced in expectation, giving O(log n) insert, remove,   *
+*                   index and slice lookup. Edits that fit inside one chunk    *
+*                   only move bytes within that chunk; larger edits split the  *
+*                   tree at the edit points and merge the pieces back.         *
+*                   Chunks left small by an edit are joined with an in-order   *
+*                   neighbour when the pair fits in one chunk, so repeated     *
+*                   edits don't leave a trail of nearly empty nodes that each  *
+*                   still cost a whole ROPE_CHUNK_SIZE.                        *
+* Usage:            Rope rope = UNWRAP(rope_new(text), return 1);              *
+*                   rope_insert(&rope, 10, insertion);                         *
+*                   rope_remove(&rope, 100, 250);                              *
+*                   String chunk;                                              *
+*                   for(size_t it = 0; rope_next(&rope, &it, &chunk);) ...     *
+*                   DString flat = UNWRAP(rope_flatten(&rope), return 1);      *
+*                   rope_delete(&rope);                                        *
+*                                                                              *
+*                   - Ranges are [lower, upper) byte offsets, like             *
+*                       dstring_get_slice.                                     *
+*                   - Chunks returned by rope_next are invalidated by the next *
+*                       edit.                                                  *
+*******************************************************************************/
+
+#ifndef __CSL_ROPE_C
+#define __CSL_ROPE_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+
+#ifndef ROPE_CHUNK_SIZE
+#define ROPE_CHUNK_SIZE 1024
+#endif
+
+typedef struct RopeNode {
+    struct RopeNode* left;
+    struct RopeNode* right;
+    size_t weight;      // bytes in this subtree
+    uint32_t priority;
+    uint32_t size;      // bytes in this chunk
+    char data[ROPE_CHUNK_SIZE];
+} RopeNode;
+
+typedef struct {
+    RopeNode* root;
+    uint64_t seed;
+} Rope;
+
+DERIVE_WRESULT(Rope);
+
+WRESULT(Rope) rope_new(String str);
+size_t rope_size(const Rope* self);
+WRESULT(size_t) rope_insert(Rope* self, size_t index, String str);
+WRESULT(size_t) rope_remove(Rope* self, size_t lower, size_t upper);
+WRESULT(char) rope_index(const Rope* self, size_t index);
+WRESULT(DString) rope_slice(const Rope* self, size_t lower, size_t upper);
+bool rope_next(const Rope* self, size_t* iter, String* chunk);
+WRESULT(DString) rope_flatten(const Rope* self);
+void rope_delete(Rope* self);
+
+#if !defined(CSL_ROPE_INTERFACE)
+
+static inline size_t rope_weight(const RopeNode* node) {
+    return node == NULL ? 0 : node->weight;
+}
+
+static inline void rope_update(RopeNode* node) {
+    node->weight = rope_weight(node->left) + node->size + rope_weight(node->right);
+}
+
+static inline uint32_t rope_priority(Rope* self) {
+    /* xorshift64* */
+    self->seed ^= self->seed >> 12;
+    self->seed ^= self->seed << 25;
+    self->seed ^= self->seed >> 27;
+    return (uint32_t)((self->seed * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static RopeNode* rope_node_new(Rope* self, const char* bytes, size_t size) {
+    RopeNode* node = malloc(sizeof(RopeNode));
+    if(node == NULL) return NULL;
+    node->left = node->right = NULL;
+    node->priority = rope_priority(self);
+    node->size = (uint32_t)size;
+    node->weight = size;
+    if(size != 0) memcpy(node->data, bytes, size);
+    return node;
+}
+
+static void rope_free_nodes(RopeNode* node) {
+    while(node != NULL) {
+        rope_free_nodes(node->left);
+        RopeNode* right = node->right;
+        free(node);
+        node = right;
+    }
+}
+
+/* Concatenates two treaps, every byte of a comes before every byte of b */
+static RopeNode* rope_merge(RopeNode* a, RopeNode* b) {
+    if(a == NULL) return b;
+    if(b == NULL) return a;
+    if(a->priority >= b->priority) {
+        a->right = rope_merge(a->right, b);
+        rope_update(a);
+        return a;
+    }
+    b->left = rope_merge(a, b->left);
+    rope_update(b);
+    return b;
+}
+
+/* Splits node into the first pos bytes (*l) and the rest (*r). A chunk that
+ * straddles pos is cut in two, taking its second half from *spare */
+static void rope_split(RopeNode* node, size_t pos, RopeNode** l, RopeNode** r, RopeNode** spare) {
+    if(node == NULL) {
+        *l = *r = NULL;
+        return;
+    }
+    size_t lw = rope_weight(node->left);
+    if(pos <= lw) {
+        rope_split(node->left, pos, l, &node->left, spare);
+        rope_update(node);
+        *r = node;
+    } else if(pos >= lw + node->size) {
+        rope_split(node->right, pos - lw - node->size, &node->right, r, spare);
+        rope_update(node);
+        *l = node;
+    } else {
+        size_t offset = pos - lw;
+        RopeNode* tail = *spare;
+        *spare = NULL;
+        tail->size = node->size - (uint32_t)offset;
+        tail->weight = tail->size;
+        memcpy(tail->data, node->data + offset, tail->size);
+        node->size = (uint32_t)offset;
+        RopeNode* right = node->right;
+        node->right = NULL;
+        rope_update(node);
+        *l = node;
+        *r = rope_merge(tail, right);
+    }
+}
+
+/* Concatenates like rope_merge, first moving the leftmost chunk of b into the
+ * rightmost chunk of a when both fit in one */
+static RopeNode* rope_join(RopeNode* a, RopeNode* b) {
+    if(a == NULL || b == NULL) return rope_merge(a, b);
+    RopeNode* last = a;
+    while(last->right != NULL) last = last->right;
+    RopeNode* first = b;
+    while(first->left != NULL) first = first->left;
+    if(last->size + first->size > ROPE_CHUNK_SIZE) return rope_merge(a, b);
+
+    memcpy(last->data + last->size, first->data, first->size);
+    last->size += first->size;
+    for(RopeNode* walk = a; walk != NULL; walk = walk->right) walk->weight += first->size;
+    /* Unlink first, its right subtree keeps the heap order in its place */
+    RopeNode** link = &b;
+    while(*link != first) {
+        (*link)->weight -= first->size;
+        link = &(*link)->left;
+    }
+    *link = first->right;
+    free(first);
+    return rope_merge(a, b);
+}
+
+/* Joins the chunks on either side of pos, which must be a chunk boundary */
+static void rope_fuse(Rope* self, size_t pos) {
+    if(pos == 0 || pos >= rope_weight(self->root)) return;
+    RopeNode *l, *r, *spare = NULL;
+    rope_split(self->root, pos, &l, &r, &spare);
+    self->root = rope_join(l, r);
+}
+
+/* Joins the chunk holding byte index with whichever neighbours it fits with */
+static void rope_fuse_around(Rope* self, size_t index) {
+    if(index >= rope_weight(self->root)) return;
+    RopeNode* node = self->root;
+    size_t pos = index;
+    for(;;) {
+        size_t lw = rope_weight(node->left);
+        if(pos < lw) {
+            node = node->left;
+        } else if(pos < lw + node->size) {
+            pos -= lw;
+            break;
+        } else {
+            pos -= lw + node->size;
+            node = node->right;
+        }
+    }
+    /* Boundaries don't move when chunks are joined, so end stays valid */
+    size_t start = index - pos, end = start + node->size;
+    rope_fuse(self, start);
+    rope_fuse(self, end);
+}
+
+/* Builds a treap from the bytes of str, false if an allocation fails */
+static bool rope_build(Rope* self, String str, RopeNode** out) {
+    RopeNode* root = NULL;
+    for(size_t i = 0; i < str.size; i += ROPE_CHUNK_SIZE) {
+        size_t size = str.size - i < ROPE_CHUNK_SIZE ? str.size - i : ROPE_CHUNK_SIZE;
+        RopeNode* node = rope_node_new(self, str.start + i, size);
+        if(node == NULL) {
+            rope_free_nodes(root);
+            return false;
+        }
+        root = rope_merge(root, node);
+    }
+    *out = root;
+    return true;
+}
+
+/* @brief:  Creates a rope holding a copy of str
+ * @param:  String str - initial contents (may be empty)
+ * @return: WRESULT(Rope) - the new rope */
+WRESULT(Rope) rope_new(String str) {
+    Rope rope = { .root = NULL, .seed = string_hash_random_seed() | 1 };
+    if(!rope_build(&rope, str, &rope.root)) return WRESULT_ERR(Rope, rope);
+    return WRESULT_OK(Rope, rope);
+}
+
+/* @brief:  Gets the number of bytes in the rope
+ * @param:  const Rope* self - reference to the rope
+ * @return: size_t - the size of the rope */
+size_t rope_size(const Rope* self) {
+    return rope_weight(self->root);
+}
+
+/* @brief:  Inserts a copy of str before the byte at index
+ * @param:  Rope* self - reference to the rope
+ * @param:  size_t index - insertion point, rope_size() appends
+ * @param:  String str - bytes to insert (must not point into the rope)
+ * @return: WRESULT(size_t) - new size of the rope */
+WRESULT(size_t) rope_insert(Rope* self, size_t index, String str) {
+    if(self == NULL) return WRESULT_ERR(size_t, 0);
+    if(index > rope_weight(self->root)) return WRESULT_ERR(size_t, rope_weight(self->root));
+    if(str.size == 0) return WRESULT_OK(size_t, rope_weight(self->root));
+
+    /* Find the chunk that index falls in (or at the end of) */
+    RopeNode* node = self->root;
+    size_t pos = index;
+    while(node != NULL) {
+        size_t lw = rope_weight(node->left);
+        if(pos < lw || (pos == lw && node->left != NULL)) {
+            node = node->left;
+        } else if(pos <= lw + node->size) {
+            pos -= lw;
+            break;
+        } else {
+            pos -= lw + node->size;
+            node = node->right;
+        }
+    }
+    if(node != NULL && node->size + str.size <= ROPE_CHUNK_SIZE) {
+        /* Fits: shift within the chunk and fix the weights along the path */
+        memmove(node->data + pos + str.size, node->data + pos, node->size - pos);
+        memcpy(node->data + pos, str.start, str.size);
+        node->size += (uint32_t)str.size;
+        RopeNode* walk = self->root;
+        size_t at = index;
+        while(walk != node) {
+            size_t lw = rope_weight(walk->left);
+            walk->weight += str.size;
+            if(at < lw || (at == lw && walk->left != NULL)) {
+                walk = walk->left;
+            } else {
+                at -= lw + walk->size;
+                walk = walk->right;
+            }
+        }
+        rope_update(node);
+        return WRESULT_OK(size_t, rope_weight(self->root));
+    }
+
+    RopeNode* middle;
+    RopeNode* spare = malloc(sizeof(RopeNode));
+    if(spare == NULL) return WRESULT_ERR(size_t, rope_weight(self->root));
+    if(!rope_build(self, str, &middle)) {
+        free(spare);
+        return WRESULT_ERR(size_t, rope_weight(self->root));
+    }
+    spare->left = spare->right = NULL;
+    spare->priority = rope_priority(self);
+    RopeNode *l, *r;
+    rope_split(self->root, index, &l, &r, &spare);
+    self->root = rope_join(rope_join(l, middle), r);
+    free(spare);
+    return WRESULT_OK(size_t, rope_weight(self->root));
+}
+
+/* @brief:  Removes the bytes in [lower, upper)
+ * @param:  Rope* self - reference to the rope
+ * @param:  size_t lower - first byte to remove
+ * @param:  size_t upper - one past the last byte to remove
+ * @return: WRESULT(size_t) - new size of the rope */
+WRESULT(size_t) rope_remove(Rope* self, size_t lower, size_t upper) {
+    if(self == NULL) return WRESULT_ERR(size_t, 0);
+    if(lower > upper || upper > rope_weight(self->root)) return WRESULT_ERR(size_t, rope_weight(self->root));
+    if(lower == upper) return WRESULT_OK(size_t, rope_weight(self->root));
+
+    /* Find the chunk holding byte lower */
+    RopeNode* node = self->root;
+    size_t pos = lower;
+    for(;;) {
+        size_t lw = rope_weight(node->left);
+        if(pos < lw) {
+            node = node->left;
+        } else if(pos < lw + node->size) {
+            pos -= lw;
+            break;
+        } else {
+            pos -= lw + node->size;
+            node = node->right;
+        }
+    }
+    size_t count = upper - lower;
+    if(pos + count <= node->size && count < node->size) {
+        /* Stays inside one chunk and leaves it non empty */
+        memmove(node->data + pos, node->data + pos + count, node->size - pos - count);
+        node->size -= (uint32_t)count;
+        RopeNode* walk = self->root;
+        size_t at = lower;
+        while(walk != node) {
+            size_t lw = rope_weight(walk->left);
+            walk->weight -= count;
+            if(at < lw) {
+                walk = walk->left;
+            } else {
+                at -= lw + walk->size;
+                walk = walk->right;
+            }
+        }
+        rope_update(node);
+        /* Only look for a neighbour to join once the chunk is under half full */
+        if(node->size < ROPE_CHUNK_SIZE / 2) rope_fuse_around(self, lower - pos);
+        return WRESULT_OK(size_t, rope_weight(self->root));
+    }
+
+    RopeNode* spares[2] = { malloc(sizeof(RopeNode)), malloc(sizeof(RopeNode)) };
+    if(spares[0] == NULL || spares[1] == NULL) {
+        free(spares[0]);
+        free(spares[1]);
+        return WRESULT_ERR(size_t, rope_weight(self->root));
+    }
+    for(int i = 0; i < 2; i++) {
+        spares[i]->left = spares[i]->right = NULL;
+        spares[i]->priority = rope_priority(self);
+    }
+    RopeNode *l, *m, *r;
+    rope_split(self->root, upper, &l, &r, &spares[0]);
+    rope_split(l, lower, &l, &m, &spares[1]);
+    rope_free_nodes(m);
+    self->root = rope_join(l, r);
+    free(spares[0]);
+    free(spares[1]);
+    /* The cut chunks on either side may now fit with their other neighbours */
+    if(lower > 0) rope_fuse_around(self, lower - 1);
+    rope_fuse_around(self, lower);
+    return WRESULT_OK(size_t, rope_weight(self->root));
+}
+
+/* @brief:  Gets the byte at index
+ * @param:  const Rope* self - reference to the rope
+ * @param:  size_t index - offset of the byte
+ * @return: WRESULT(char) - the byte, err if index is out of range */
+WRESULT(char) rope_index(const Rope* self, size_t index) {
+    if(self == NULL || index >= rope_weight(self->root)) return WRESULT_ERR(char, '\0');
+    RopeNode* node = self->root;
+    for(;;) {
+        size_t lw = rope_weight(node->left);
+        if(index < lw) {
+            node = node->left;
+        } else if(index < lw + node->size) {
+            return WRESULT_OK(char, node->data[index - lw]);
+        } else {
+            index -= lw + node->size;
+            node = node->right;
+        }
+    }
+}
+
+/* @brief:  Iterates the chunks of the rope starting at byte *iter
+ *          ex: `for(size_t it = 0; rope_next(&rope, &it, &chunk);)`
+ * @param:  const Rope* self - reference to the rope
+ * @param:  size_t* iter - byte offset to continue from, start at 0 (or at
+ *          any offset to begin mid-rope)
+ * @param:  String* chunk - set to the bytes from *iter to the end of its chunk
+ * @return: bool - false once the end of the rope is reached */
+bool rope_next(const Rope* self, size_t* iter, String* chunk) {
+    if(self == NULL || *iter >= rope_weight(self->root)) return false;
+    RopeNode* node = self->root;
+    size_t pos = *iter;
+    for(;;) {
+        size_t lw = rope_weight(node->left);
+        if(pos < lw) {
+            node = node->left;
+        } else if(pos < lw + node->size) {
+            pos -= lw;
+            break;
+        } else {
+            pos -= lw + node->size;
+            node = node->right;
+        }
+    }
+    *chunk = (String){ .start = node->data + pos, .size = node->size - pos };
+    *iter += chunk->size;
+    return true;
+}
+
+/* @brief:  Copies the bytes in [lower, upper) into a new DString
+ * @param:  const Rope* self - reference to the rope
+ * @param:  size_t lower - first byte of the slice
+ * @param:  size_t upper - one past the last byte of the slice
+ * @return: WRESULT(DString) - the copied slice */
+WRESULT(DString) rope_slice(const Rope* self, size_t lower, size_t upper) {
+    DString out = {0};
+    if(self == NULL || lower > upper || upper > rope_weight(self->root)) return WRESULT_ERR(DString, out);
+    UNWRAP(dstring_reserve(&out, upper - lower), return WRESULT_ERR(DString, out));
+    String chunk;
+    for(size_t it = lower; it < upper && rope_next(self, &it, &chunk);) {
+        if(it > upper) chunk.size -= it - upper;
+        memcpy(out.s.start + out.s.size, chunk.start, chunk.size);
+        out.s.size += chunk.size;
+    }
+    return WRESULT_OK(DString, out);
+}
+
+/* @brief:  Copies the whole rope into one contiguous DString
+ * @param:  const Rope* self - reference to the rope
+ * @return: WRESULT(DString) - the flattened text */
+WRESULT(DString) rope_flatten(const Rope* self) {
+    DString empty = {0};
+    if(self == NULL) return WRESULT_ERR(DString, empty);
+    return rope_slice(self, 0, rope_weight(self->root));
+}
+
+/* @brief:  Frees every chunk of the rope
+ * @param:  Rope* self - rope to delete */
+void rope_delete(Rope* self) {
+    rope_free_nodes(self->root);
+    self->root = NULL;
+}
+
+#endif
+#endif
@@ -0,0 +1,253 @@
+/*******************************************************************************
+* Name:             csl-slotmap.h                                              *
+* Description:      Slot maps with generational handles, generated per type    *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   SLOTMAP(T) keeps its values densely packed in one array,   *
+*                   so iterating is a linear scan with no holes. Values are    *
+*                   reached through a SlotMapHandle, an (index, generation)    *
+*                   pair: index names a slot, and the slot holds the value's   *
+*                   position in the dense array and a generation that is       *
+*                   bumped on every erase. A handle whose value was erased no  *
+*                   longer matches its slot's generation, so stale handles are *
+*                   detected like a failed weak pointer lock, without a heap   *
+*                   object or any reference counts. Erase moves the last value *
+*                   into the hole (O(1) swap-remove) and frees the slot for    *
+*                   reuse. The types are generated with the csl-templates.h    *
+*                   GENERATE machinery, and every generated type has the same  *
+*                   field names, so the operations are plain macros.           *
+* Usage:            Generate the types you need once, at file scope:           *
+*                                                                              *
+*                   #define TEMPLATE SLOTMAP_TEMPLATE                          *
+*                   GENERATE(Entity, Particle)                                 *
+*                   #undef TEMPLATE                                            *
+*                                                                              *
+*                   SLOTMAP(Entity) entities = {0};                            *
+*                   SlotMapHandle h = UNWRAP(slotmap_insert(&entities, e),     *
+*                       return 1);                                             *
+*                   Entity* found = slotmap_get(&entities, h);  // or NULL     *
+*                   slotmap_foreach(it, &entities) update(it);                 *
+*                   slotmap_erase(&entities, h);                               *
+*                   slotmap_free(&entities);                                   *
+*                                                                              *
+*                   - Pointers into the map (from get or foreach) are only     *
+*                       valid until the next insert or erase. Keep handles.    *
+*                   - Values are copied in and dropped as is, anything they    *
+*                       own must be released before erasing them.              *
+*                   - A zeroed SlotMapHandle is never valid.                   *
+*******************************************************************************/
+
+#ifndef __CSL_SLOTMAP_H
+#define __CSL_SLOTMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "csl-errval.h"
+#include "csl-templates.h"
+
+typedef struct {
+    uint32_t index;
+    uint32_t generation;
+} SlotMapHandle;
+
+DERIVE_WRESULT(SlotMapHandle);
+
+typedef struct {
+    uint32_t generation;    // odd while the slot holds a value
+    uint32_t index;         // dense position while it holds one, next free slot + 1 while free
+} SlotMapSlot;
+
+/* The part of a slot map that doesn't depend on the value type */
+typedef struct {
+    SlotMapSlot* slots;
+    uint32_t* owners;       // slot of each dense value
+    uint32_t count;
+    uint32_t capacity;      // of the values and owners arrays
+    uint32_t nslots;
+    uint32_t slots_capacity;
+    uint32_t free_head;     // first free slot + 1, 0 if there is none
+} SlotMapIndex;
+
+#define SLOTMAP_NONE UINT32_MAX
+
+#define SLOTMAP(T) SlotMap##T
+
+/* Template for GENERATE: defines SLOTMAP(T). Zero initialized, it is an empty map */
+#define SLOTMAP_TEMPLATE(T)                                                     \
+    typedef struct {                                                            \
+        T* values;                                                              \
+        SlotMapIndex index;                                                     \
+    } SlotMap##T;
+
+/* Doubles the dense arrays: returns the reallocated values, or NULL (leaving the values as they were) */
+__attribute__((unused))
+static void* _slotmap_grow(SlotMapIndex* index, void* values, size_t size) {
+    if(index->capacity == UINT32_MAX - 1) return NULL;     // SLOTMAP_NONE is never a position
+    uint32_t capacity = index->capacity == 0 ? 16
+        : index->capacity >= (UINT32_MAX - 1) / 2 ? UINT32_MAX - 1 : index->capacity * 2;
+    uint32_t* owners = realloc(index->owners, (size_t)capacity * sizeof(uint32_t));
+    if(owners == NULL) return NULL;
+    index->owners = owners;
+    void* grown = realloc(values, (size_t)capacity * size);
+    if(grown == NULL) return NULL;      // the bigger owners array is harmless
+    index->capacity = capacity;
+    return grown;
+}
+
+/* Takes a free slot (or a new one) for a value appended to the dense array, which must have room */
+__attribute__((unused))
+static bool _slotmap_acquire(SlotMapIndex* index, SlotMapHandle* handle) {
+    uint32_t slot;
+    if(index->free_head != 0) {
+        slot = index->free_head - 1;
+        index->free_head = index->slots[slot].index;
+    }
+    else {
+        if(index->nslots == index->slots_capacity) {
+            if(index->slots_capacity == UINT32_MAX) return false;
+            uint32_t capacity = index->slots_capacity == 0 ? 16
+                : index->slots_capacity >= UINT32_MAX / 2 ? UINT32_MAX : index->slots_capacity * 2;
+            SlotMapSlot* slots = realloc(index->slots, (size_t)capacity * sizeof(SlotMapSlot));
+            if(slots == NULL) return false;
+            index->slots = slots;
+            index->slots_capacity = capacity;
+        }
+        slot = index->nslots++;
+        index->slots[slot].generation = 0;
+    }
+    index->slots[slot].generation++;
+    index->slots[slot].index = index->count;
+    index->owners[index->count++] = slot;
+    *handle = (SlotMapHandle){ .index = slot, .generation = index->slots[slot].generation };
+    return true;
+}
+
+/* Dense position of the value a handle refers to, or SLOTMAP_NONE if it is stale */
+__attribute__((unused))
+static inline uint32_t _slotmap_find(const SlotMapIndex* index, SlotMapHandle handle) {
+    if(handle.index >= index->nslots || !(handle.generation & 1)) return SLOTMAP_NONE;
+    const SlotMapSlot* slot = &index->slots[handle.index];
+    return slot->generation == handle.generation ? slot->index : SLOTMAP_NONE;
+}
+
+/* Frees the slot of the value at position hole and points the last value's slot at hole. Returns the
+ * last position, whose value the caller moves into hole */
+__attribute__((unused))
+static uint32_t _slotmap_release(SlotMapIndex* index, uint32_t hole) {
+    uint32_t slot = index->owners[hole];
+    uint32_t last = --index->count;
+    uint32_t moved = index->owners[last];
+    index->owners[hole] = moved;
+    index->slots[moved].index = hole;
+    /* A slot whose generation wraps around is retired, so a very old handle can't match it again */
+    if(++index->slots[slot].generation != 0) {
+        index->slots[slot].index = index->free_head;
+        index->free_head = slot + 1;
+    }
+    return last;
+}
+
+/* Erases every value, so every handle goes stale */
+__attribute__((unused))
+static void _slotmap_clear(SlotMapIndex* index) {
+    while(index->count != 0) _slotmap_release(index, index->count - 1);
+}
+
+/* @brief:  Copies a value into the map
+ * @param:  self - pointer to any SLOTMAP(T)
+ * @param:  item - T, evaluated before the map grows
+ * @return: WRESULT(SlotMapHandle) - handle to the value, or error (and
+ *          unchanged) if memory ran out */
+#define slotmap_insert(self, item) ({                                          \
+        typeof(self) slotmap_self = (self);                                     \
+        typeof(*slotmap_self->values) slotmap_item = (item);                  \
+        WRESULT(SlotMapHandle) slotmap_result = {0};                            \
+        if(slotmap_self->index.count == slotmap_self->index.capacity) {         \
+            void* slotmap_grown = _slotmap_grow(&slotmap_self->index,           \
+                slotmap_self->values, sizeof(*slotmap_self->values));           \
+            if(slotmap_grown != NULL) slotmap_self->values = slotmap_grown;     \
+        }                                                                       \
+        if(slotmap_self->index.count == slotmap_self->index.capacity            \
+            || !_slotmap_acquire(&slotmap_self->index, &slotmap_result.value)) {\
+            slotmap_result.err = true;                                          \
+        }                                                                       \
+        else slotmap_self->values[slotmap_self->index.count - 1] = slotmap_item; \
+        slotmap_result;                                                         \
+    })
+
+/* @brief:  Looks up the value of a handle
+ * @param:  self - pointer to any SLOTMAP(T)
+ * @param:  SlotMapHandle handle
+ * @return: T* - the value, or NULL if the handle is stale */
+#define slotmap_get(self, handle) ({                                            \
+        typeof(self) slotmap_self = (self);                                     \
+        uint32_t slotmap_at = _slotmap_find(&slotmap_self->index, (handle));    \
+        slotmap_at == SLOTMAP_NONE ? NULL : &slotmap_self->values[slotmap_at];  \
+    })
+
+/* @brief:  Checks if a handle still refers to a value
+ * @param:  self - pointer to any SLOTMAP(T)
+ * @param:  SlotMapHandle handle
+ * @return: bool */
+#define slotmap_contains(self, handle) \
+    (_slotmap_find(&(self)->index, (handle)) != SLOTMAP_NONE)
+
+/* @brief:  Erases the value of a handle, moving the last value into its place
+ * @param:  self - pointer to any SLOTMAP(T)
+ * @param:  SlotMapHandle handle
+ * @return: bool - false if the handle was already stale */
+#define slotmap_erase(self, handle) ({                                          \
+        typeof(self) slotmap_self = (self);                                     \
+        uint32_t slotmap_hole = _slotmap_find(&slotmap_self->index, (handle));  \
+        if(slotmap_hole != SLOTMAP_NONE) {                                      \
+            uint32_t slotmap_last = _slotmap_release(&slotmap_self->index, slotmap_hole); \
+            if(slotmap_hole != slotmap_last) {                                  \
+                slotmap_self->values[slotmap_hole] = slotmap_self->values[slotmap_last]; \
+            }                                                                   \
+        }                                                                       \
+        slotmap_hole != SLOTMAP_NONE;                                           \
+    })
+
+/* @brief:  Gets the number of values in the map
+ * @param:  self - pointer to any SLOTMAP(T)
+ * @return: uint32_t */
+#define slotmap_size(self) ((self)->index.count)
+
+/* @brief:  Loops over every value, in dense order (a linear scan). Don't insert
+ *          or erase inside the loop
+ * @param:  it - name of the T* loop variable
+ * @param:  self - pointer to any SLOTMAP(T) */
+#define slotmap_foreach(it, self) \
+    for(typeof((self)->values) it = (self)->values; it != (self)->values + (self)->index.count; it++)
+
+/* @brief:  Gets the handle of the value at a dense position, e.g. while looping
+ *          with slotmap_foreach (position it - self->values)
+ * @param:  self - pointer to any SLOTMAP(T)
+ * @param:  i - position (< slotmap_size(self))
+ * @return: SlotMapHandle */
+#define slotmap_handle_at(self, i) ({                                           \
+        typeof(self) slotmap_self = (self);                                     \
+        uint32_t slotmap_slot = slotmap_self->index.owners[(i)];                \
+        (SlotMapHandle){                                                        \
+            .index = slotmap_slot,                                              \
+            .generation = slotmap_self->index.slots[slotmap_slot].generation,   \
+        };                                                                      \
+    })
+
+/* @brief:  Erases every value (every handle goes stale) and keeps the memory
+ * @param:  self - pointer to any SLOTMAP(T) */
+#define slotmap_clear(self) _slotmap_clear(&(self)->index)
+
+/* @brief:  Frees the map's memory and leaves it empty. Handles from before
+ *          may match values inserted afterwards
+ * @param:  self - pointer to any SLOTMAP(T) */
+#define slotmap_free(self) ({                                                   \
+        typeof(self) slotmap_self = (self);                                     \
+        free(slotmap_self->values);                                             \
+        free(slotmap_self->index.slots);                                        \
+        free(slotmap_self->index.owners);                                       \
+        *slotmap_self = (typeof(*slotmap_self)){0};                             \
+    })
+
+#endif
@@ -11,6 +11,10 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
 
 #ifdef __cplusplus
 #error "This library is C-only. Use <memory> for C++"
@@ -44,7 +48,8 @@ enum smrtptr_errors {
     SMRTPTR_MALLOC_FAILED       = 0b1000000000000,
 };
 
-static enum smrtptr_errors smrtptr_errno = 0;
+/* One per thread: an error flagged on one thread isn't seen (or cleared) by another */
+static _Thread_local enum smrtptr_errors smrtptr_errno = 0;
 
 /* For optionally removing attributes, or providing alternative syntax */
 #ifndef smrtptr_attribute
@@ -54,6 +59,768 @@ static enum smrtptr_errors smrtptr_errno = 0;
 #define deref_smrtptr(smrtptr) *smrtptr.ptr
 #define ref_smrtptr(smrtptr) smrtptr.ptr
 
+/* Opt in with SMRTPTR_PADDED_CTRLBLK. The atomic control block is then aligned to a cache line, with the
+ * strong count and the weak count on lines of their own, so threads working on neighbouring objects (or on
+ * the strong and weak pointers of one object) don't invalidate each other's lines. Costs 2 lines per block */
+#ifndef SMRTPTR_CACHE_LINE
+#define SMRTPTR_CACHE_LINE 64
+#endif
+#ifdef SMRTPTR_PADDED_CTRLBLK
+#define SMRTPTR_CACHE_ALIGNED _Alignas(SMRTPTR_CACHE_LINE)
+#else
+#define SMRTPTR_CACHE_ALIGNED
+#endif
+
+/* malloc, or aligned_alloc (rounding size up to the alignment) for over-aligned control blocks */
+static inline void* smrtptr_malloc_aligned(size_t size, size_t align) {
+    if(align <= _Alignof(max_align_t)) return malloc(size);
+    return aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+/* Offset of the object from the start of a combined control block allocation */
+#define SMRTPTR_INLINE_OFFSET(ctrlblk) \
+    ((sizeof(ctrlblk) + _Alignof(max_align_t) - 1) / _Alignof(max_align_t) * _Alignof(max_align_t))
+
+
+/*************************** CONTROL BLOCK POOL *******************************/// {{{
+
+/* Opt in with SMRTPTR_POOL_CTRLBLK. Control blocks (and objects from smrtptr_new_strong that fit) then
+ * come from fixed size blocks carved out of slabs instead of malloc/free:
+ *  - every thread has its own free list, so an alloc or free is a few non-atomic pointer moves
+ *  - a block freed on another thread just goes on that thread's list. Once a list holds
+ *      2 * SMRTPTR_POOL_BATCH blocks, one batch is handed to a central mutex protected list, where threads
+ *      that run dry pick up whole batches before carving a new slab (so producer/consumer threads don't
+ *      grow the pool forever)
+ *  - a thread's list is handed back to the central list when the thread exits
+ *  - slabs are never returned to the system */
+#ifdef SMRTPTR_POOL_CTRLBLK
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifndef SMRTPTR_POOL_BLOCK_SIZE
+#ifdef SMRTPTR_PADDED_CTRLBLK
+#define SMRTPTR_POOL_BLOCK_SIZE (2 * SMRTPTR_CACHE_LINE)
+#else
+#define SMRTPTR_POOL_BLOCK_SIZE 64
+#endif
+#endif
+#ifndef SMRTPTR_POOL_SLAB_BLOCKS
+#define SMRTPTR_POOL_SLAB_BLOCKS 256
+#endif
+#ifndef SMRTPTR_POOL_BATCH
+#define SMRTPTR_POOL_BATCH 64
+#endif
+
+static_assert(SMRTPTR_POOL_BLOCK_SIZE % _Alignof(max_align_t) == 0, "pool blocks must keep max_align_t alignment");
+
+typedef struct smrtptr_pool_node {
+    struct smrtptr_pool_node* next;
+    struct smrtptr_pool_node* next_batch;   // only used on the first node of a central batch
+} smrtptr_pool_node;
+
+/* Counters are only written by their own thread (relaxed load + store, no RMW) and summed by
+ * smrtptr_pool_get_stats */
+typedef struct smrtptr_pool_thread {
+    smrtptr_pool_node* free;
+    size_t nfree;
+    char* slab_next;        // blocks of the current slab that were never handed out
+    char* slab_end;
+    atomic_size_t allocs;
+    atomic_size_t frees;
+    bool registered;
+    struct smrtptr_pool_thread* prev_thread;
+    struct smrtptr_pool_thread* next_thread;
+} smrtptr_pool_thread;
+
+typedef struct {
+    size_t slabs;           // slabs carved so far
+    size_t blocks;          // blocks in those slabs
+    size_t in_use;          // blocks handed out and not yet freed
+    size_t central;         // blocks waiting in the central list
+    size_t threads;         // threads currently using the pool
+    size_t allocs;          // total allocations (including exited threads)
+    size_t frees;           // total frees (including exited threads)
+} smrtptr_pool_stats;
+
+static struct {
+    pthread_mutex_t lock;
+    smrtptr_pool_node* batches;
+    size_t nbatches_blocks;
+    size_t slabs;
+    size_t exited_allocs;
+    size_t exited_frees;
+    smrtptr_pool_thread* threads;
+    size_t nthreads;
+    pthread_key_t key;
+    pthread_once_t once;
+} smrtptr_pool = { .lock = PTHREAD_MUTEX_INITIALIZER, .once = PTHREAD_ONCE_INIT };
+
+static _Thread_local smrtptr_pool_thread smrtptr_pool_local;
+
+static inline void smrtptr_pool_count(atomic_size_t* counter) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/* Hands nodes (a list of count blocks) to the central list. Caller holds the lock */
+static void smrtptr_pool_push_central(smrtptr_pool_node* nodes, size_t count) {
+    nodes->next_batch = smrtptr_pool.batches;
+    smrtptr_pool.batches = nodes;
+    smrtptr_pool.nbatches_blocks += count;
+}
+
+/* Runs when a thread that used the pool exits */
+static void smrtptr_pool_thread_exit(void* arg) {
+    smrtptr_pool_thread* t = arg;
+    /* Blocks of the slab that were never used join the list first */
+    for(; t->slab_next < t->slab_end; t->slab_next += SMRTPTR_POOL_BLOCK_SIZE) {
+        smrtptr_pool_node* node = (smrtptr_pool_node*)t->slab_next;
+        node->next = t->free;
+        t->free = node;
+        t->nfree++;
+    }
+    pthread_mutex_lock(&smrtptr_pool.lock);
+    if(t->free != NULL) smrtptr_pool_push_central(t->free, t->nfree);
+    if(t->prev_thread != NULL) t->prev_thread->next_thread = t->next_thread;
+    else smrtptr_pool.threads = t->next_thread;
+    if(t->next_thread != NULL) t->next_thread->prev_thread = t->prev_thread;
+    smrtptr_pool.nthreads--;
+    smrtptr_pool.exited_allocs += atomic_load_explicit(&t->allocs, memory_order_relaxed);
+    smrtptr_pool.exited_frees += atomic_load_explicit(&t->frees, memory_order_relaxed);
+    pthread_mutex_unlock(&smrtptr_pool.lock);
+    t->free = NULL;
+    t->nfree = 0;
+    t->registered = false;
+}
+
+static void smrtptr_pool_make_key(void) {
+    pthread_key_create(&smrtptr_pool.key, smrtptr_pool_thread_exit);
+}
+
+static void smrtptr_pool_register(smrtptr_pool_thread* t) {
+    pthread_once(&smrtptr_pool.once, smrtptr_pool_make_key);
+    pthread_setspecific(smrtptr_pool.key, t);
+    pthread_mutex_lock(&smrtptr_pool.lock);
+    t->prev_thread = NULL;
+    t->next_thread = smrtptr_pool.threads;
+    if(smrtptr_pool.threads != NULL) smrtptr_pool.threads->prev_thread = t;
+    smrtptr_pool.threads = t;
+    smrtptr_pool.nthreads++;
+    pthread_mutex_unlock(&smrtptr_pool.lock);
+    t->registered = true;
+}
+
+/* Refills an empty thread list: a central batch if there is one, a new slab otherwise */
+smrtptr_attribute(noinline)
+static bool smrtptr_pool_refill(smrtptr_pool_thread* t) {
+    if(!t->registered) smrtptr_pool_register(t);
+    pthread_mutex_lock(&smrtptr_pool.lock);
+    smrtptr_pool_node* batch = smrtptr_pool.batches;
+    if(batch != NULL) {
+        smrtptr_pool.batches = batch->next_batch;
+        size_t count = 0;
+        for(smrtptr_pool_node* node = batch; node != NULL; node = node->next) count++;
+        smrtptr_pool.nbatches_blocks -= count;
+        pthread_mutex_unlock(&smrtptr_pool.lock);
+        t->free = batch;
+        t->nfree = count;
+        return true;
+    }
+    pthread_mutex_unlock(&smrtptr_pool.lock);
+    char* slab = aligned_alloc(SMRTPTR_POOL_BLOCK_SIZE, SMRTPTR_POOL_BLOCK_SIZE * SMRTPTR_POOL_SLAB_BLOCKS);
+    if(slab == NULL) return false;
+    pthread_mutex_lock(&smrtptr_pool.lock);
+    smrtptr_pool.slabs++;
+    pthread_mutex_unlock(&smrtptr_pool.lock);
+    /* The first block goes on the list, the rest is handed out in order */
+    t->free = (smrtptr_pool_node*)slab;
+    t->free->next = NULL;
+    t->nfree = 1;
+    t->slab_next = slab + SMRTPTR_POOL_BLOCK_SIZE;
+    t->slab_end = slab + SMRTPTR_POOL_BLOCK_SIZE * SMRTPTR_POOL_SLAB_BLOCKS;
+    return true;
+}
+
+/* Moves one batch from a full thread list to the central list. The most recently freed
+ * SMRTPTR_POOL_BATCH blocks stay (they are the most likely to still be in cache) */
+smrtptr_attribute(noinline)
+static void smrtptr_pool_flush(smrtptr_pool_thread* t) {
+    smrtptr_pool_node* keep = t->free;
+    for(size_t i = 1; i < SMRTPTR_POOL_BATCH; i++) keep = keep->next;
+    smrtptr_pool_node* batch = keep->next;
+    smrtptr_pool_node* last = batch;
+    for(size_t i = 1; i < SMRTPTR_POOL_BATCH; i++) last = last->next;
+    keep->next = last->next;
+    last->next = NULL;
+    t->nfree -= SMRTPTR_POOL_BATCH;
+    pthread_mutex_lock(&smrtptr_pool.lock);
+    smrtptr_pool_push_central(batch, SMRTPTR_POOL_BATCH);
+    pthread_mutex_unlock(&smrtptr_pool.lock);
+}
+
+/* @brief:      Takes a block of SMRTPTR_POOL_BLOCK_SIZE bytes from the calling thread's list
+ * @return:     void* - the block, NULL if a new slab was needed and could not be allocated */
+static inline void* smrtptr_pool_alloc(void) {
+    smrtptr_pool_thread* t = &smrtptr_pool_local;
+    if(t->free == NULL) {
+        if(t->slab_next < t->slab_end) {
+            void* block = t->slab_next;
+            t->slab_next += SMRTPTR_POOL_BLOCK_SIZE;
+            smrtptr_pool_count(&t->allocs);
+            return block;
+        }
+        if(!smrtptr_pool_refill(t)) return NULL;
+    }
+    smrtptr_pool_node* node = t->free;
+    t->free = node->next;
+    t->nfree--;
+    smrtptr_pool_count(&t->allocs);
+    return node;
+}
+
+/* @brief:      Returns a block to the calling thread's list (it may have come from any thread)
+ * @param:      void* block - block from smrtptr_pool_alloc */
+static inline void smrtptr_pool_free(void* block) {
+    smrtptr_pool_thread* t = &smrtptr_pool_local;
+    if(!t->registered) smrtptr_pool_register(t);
+    smrtptr_pool_node* node = block;
+    node->next = t->free;
+    t->free = node;
+    t->nfree++;
+    smrtptr_pool_count(&t->frees);
+    if(t->nfree >= 2 * SMRTPTR_POOL_BATCH) smrtptr_pool_flush(t);
+}
+
+/* @brief:      Collects the usage of the pool across all threads
+ * @return:     smrtptr_pool_stats - a snapshot (counters of running threads may be slightly behind) */
+smrtptr_attribute(unused)
+static smrtptr_pool_stats smrtptr_pool_get_stats(void) {
+    pthread_mutex_lock(&smrtptr_pool.lock);
+    smrtptr_pool_stats stats = {
+        .slabs = smrtptr_pool.slabs,
+        .blocks = smrtptr_pool.slabs * SMRTPTR_POOL_SLAB_BLOCKS,
+        .central = smrtptr_pool.nbatches_blocks,
+        .threads = smrtptr_pool.nthreads,
+        .allocs = smrtptr_pool.exited_allocs,
+        .frees = smrtptr_pool.exited_frees,
+    };
+    for(smrtptr_pool_thread* t = smrtptr_pool.threads; t != NULL; t = t->next_thread) {
+        stats.allocs += atomic_load_explicit(&t->allocs, memory_order_relaxed);
+        stats.frees += atomic_load_explicit(&t->frees, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&smrtptr_pool.lock);
+    stats.in_use = stats.allocs - stats.frees;
+    return stats;
+}
+
+/* The pooled flag lives in the control block so the last release knows where the block came from */
+#define SMRTPTR_CTRLBLK_POOL_FIELD bool pooled;
+#define SMRTPTR_CTRLBLK_SET_POOLED(ctrl, value) ((ctrl)->pooled = (value))
+#define SMRTPTR_CTRLBLK_DEALLOC(ctrl) ((ctrl)->pooled ? smrtptr_pool_free(ctrl) : free(ctrl))
+
+static inline void* smrtptr_ctrlblk_alloc(size_t size, size_t align, bool* pooled) {
+    if(size <= SMRTPTR_POOL_BLOCK_SIZE && align <= SMRTPTR_POOL_BLOCK_SIZE) {
+        void* block = smrtptr_pool_alloc();
+        *pooled = block != NULL;
+        if(block != NULL) return block;
+    }
+    *pooled = false;
+    return smrtptr_malloc_aligned(size, align);
+}
+
+#else
+
+#define SMRTPTR_CTRLBLK_POOL_FIELD
+#define SMRTPTR_CTRLBLK_SET_POOLED(ctrl, value) ((void)(value))
+#define SMRTPTR_CTRLBLK_DEALLOC(ctrl) free(ctrl)
+
+static inline void* smrtptr_ctrlblk_alloc(size_t size, size_t align, bool* pooled) {
+    *pooled = false;
+    return smrtptr_malloc_aligned(size, align);
+}
+
+#endif // }}}
+
+/************************** DEFERRED DESTRUCTION ******************************/// {{{
+
+/* Opt in with SMRTPTR_DEFERRED_DESTROY. When the last strong reference goes, the control block is pushed on a
+ * queue of the dropping thread instead of running the destructor there, and destructors run in batches from
+ * smrtptr_drain() or a background reclaimer thread (smrtptr_start_reclaimer). A latency critical thread that
+ * drops a large object graph then only pays for the push:
+ *  - every thread has a lock-free list, linked through the control blocks themselves (no allocation). The
+ *      owner pushes with a CAS, a drainer takes the whole list with one exchange
+ *  - destructors run in the order the objects were dropped, and may drop (and so queue) more objects
+ *  - weak pointers see the object as dead as soon as it is queued
+ *  - smrtptr_strong objects that still have weak pointers are destroyed inline: their non-atomic counts
+ *      can't be touched from another thread
+ *  - a thread's list outlives the thread: it is drained like any other, and reused by the next new thread */
+#ifdef SMRTPTR_DEFERRED_DESTROY
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/* How often the reclaimer thread drains the queues */
+#ifndef SMRTPTR_RECLAIM_INTERVAL_US
+#define SMRTPTR_RECLAIM_INTERVAL_US 1000
+#endif
+
+typedef struct smrtptr_deferred {
+    struct smrtptr_deferred* next;
+    void* object;
+    void (*release)(struct smrtptr_deferred*);      // destroys the object and drops the control block
+} smrtptr_deferred;
+
+/* Records are never freed, a thread that exits leaves its record for the next new thread */
+typedef struct smrtptr_defer_thread {
+    _Atomic(smrtptr_deferred*) queue;
+    atomic_bool in_use;
+    struct smrtptr_defer_thread* next;
+} smrtptr_defer_thread;
+
+static struct {
+    _Atomic(smrtptr_defer_thread*) threads;
+    pthread_mutex_t drain_lock;         // one drainer at a time, so smrtptr_drain also waits out the reclaimer
+    pthread_mutex_t reclaimer_lock;
+    pthread_cond_t reclaimer_wake;
+    pthread_t reclaimer;
+    bool reclaimer_running;
+    bool reclaimer_stop;
+    pthread_key_t key;
+    pthread_once_t once;
+} smrtptr_defer = {
+    .threads = NULL,
+    .drain_lock = PTHREAD_MUTEX_INITIALIZER,
+    .reclaimer_lock = PTHREAD_MUTEX_INITIALIZER,
+    .reclaimer_wake = PTHREAD_COND_INITIALIZER,
+    .reclaimer_running = false,
+    .reclaimer_stop = false,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local smrtptr_defer_thread* smrtptr_defer_self;
+
+/* pthread key destructor: the queue stays in the list with whatever is still on it */
+static void smrtptr_defer_thread_exit(void* arg) {
+    smrtptr_defer_thread* self = arg;
+    atomic_store_explicit(&self->in_use, false, memory_order_release);
+    smrtptr_defer_self = NULL;
+}
+
+static void smrtptr_defer_make_key(void) {
+    pthread_key_create(&smrtptr_defer.key, smrtptr_defer_thread_exit);
+}
+
+/* Takes a free record, or links a new one into the list */
+smrtptr_attribute(noinline)
+static smrtptr_defer_thread* smrtptr_defer_register(void) {
+    pthread_once(&smrtptr_defer.once, smrtptr_defer_make_key);
+    smrtptr_defer_thread* self = NULL;
+    smrtptr_defer_thread* t = atomic_load_explicit(&smrtptr_defer.threads, memory_order_acquire);
+    for(; t != NULL; t = t->next) {
+        bool expected = false;
+        if(!atomic_load_explicit(&t->in_use, memory_order_relaxed) && atomic_compare_exchange_strong_explicit(
+            &t->in_use, &expected, true, memory_order_acquire, memory_order_relaxed
+        )) {
+            self = t;
+            break;
+        }
+    }
+    if(self == NULL) {
+        self = calloc(1, sizeof(smrtptr_defer_thread));
+        if(self == NULL) abort();       // nowhere to queue the object, and running it inline breaks the promise
+        atomic_init(&self->queue, NULL);
+        atomic_init(&self->in_use, true);
+        smrtptr_defer_thread* head = atomic_load_explicit(&smrtptr_defer.threads, memory_order_relaxed);
+        do {
+            self->next = head;
+        } while(!atomic_compare_exchange_weak_explicit(
+            &smrtptr_defer.threads, &head, self, memory_order_release, memory_order_relaxed
+        ));
+    }
+    pthread_setspecific(smrtptr_defer.key, self);
+    smrtptr_defer_self = self;
+    return self;
+}
+
+/* Queues a control block whose last strong reference is gone */
+static void smrtptr_defer_push(smrtptr_deferred* node, void* object, void (*release)(smrtptr_deferred*)) {
+    smrtptr_defer_thread* self = smrtptr_defer_self;
+    if(self == NULL) self = smrtptr_defer_register();
+    node->object = object;
+    node->release = release;
+    smrtptr_deferred* head = atomic_load_explicit(&self->queue, memory_order_relaxed);
+    do {
+        node->next = head;
+    } while(!atomic_compare_exchange_weak_explicit(
+        &self->queue, &head, node, memory_order_release, memory_order_relaxed
+    ));
+}
+
+/* @brief:      Runs the destructors of every object queued so far (on any thread), including objects the
+ *              destructors drop along the way. Must not be called from a destructor
+ * @return:     size_t - number of objects destroyed */
+smrtptr_attribute(unused)
+static size_t smrtptr_drain(void) {
+    size_t ndestroyed = 0;
+    pthread_mutex_lock(&smrtptr_defer.drain_lock);
+    bool found;
+    do {
+        found = false;
+        smrtptr_defer_thread* t = atomic_load_explicit(&smrtptr_defer.threads, memory_order_acquire);
+        for(; t != NULL; t = t->next) {
+            if(atomic_load_explicit(&t->queue, memory_order_relaxed) == NULL) continue;
+            smrtptr_deferred* batch = atomic_exchange_explicit(&t->queue, NULL, memory_order_acquire);
+            /* The list is newest first, destroy in drop order */
+            smrtptr_deferred* ordered = NULL;
+            while(batch != NULL) {
+                smrtptr_deferred* next = batch->next;
+                batch->next = ordered;
+                ordered = batch;
+                batch = next;
+            }
+            while(ordered != NULL) {
+                smrtptr_deferred* next = ordered->next;
+                ordered->release(ordered);
+                ordered = next;
+                ndestroyed++;
+            }
+            found = true;
+        }
+    } while(found);
+    pthread_mutex_unlock(&smrtptr_defer.drain_lock);
+    return ndestroyed;
+}
+
+static void* smrtptr_reclaimer_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&smrtptr_defer.reclaimer_lock);
+    while(!smrtptr_defer.reclaimer_stop) {
+        pthread_mutex_unlock(&smrtptr_defer.reclaimer_lock);
+        smrtptr_drain();
+        pthread_mutex_lock(&smrtptr_defer.reclaimer_lock);
+        if(smrtptr_defer.reclaimer_stop) break;
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (SMRTPTR_RECLAIM_INTERVAL_US % 1000000) * 1000;
+        deadline.tv_sec += SMRTPTR_RECLAIM_INTERVAL_US / 1000000 + deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        pthread_cond_timedwait(&smrtptr_defer.reclaimer_wake, &smrtptr_defer.reclaimer_lock, &deadline);
+    }
+    pthread_mutex_unlock(&smrtptr_defer.reclaimer_lock);
+    smrtptr_drain();
+    return NULL;
+}
+
+/* @brief:      Starts a background thread that drains the queues every SMRTPTR_RECLAIM_INTERVAL_US
+ * @return:     bool - false if the thread couldn't be created (it is fine to call this twice) */
+smrtptr_attribute(unused)
+static bool smrtptr_start_reclaimer(void) {
+    pthread_mutex_lock(&smrtptr_defer.reclaimer_lock);
+    bool ok = true;
+    if(!smrtptr_defer.reclaimer_running) {
+        smrtptr_defer.reclaimer_stop = false;
+        ok = pthread_create(&smrtptr_defer.reclaimer, NULL, smrtptr_reclaimer_main, NULL) == 0;
+        smrtptr_defer.reclaimer_running = ok;
+    }
+    pthread_mutex_unlock(&smrtptr_defer.reclaimer_lock);
+    return ok;
+}
+
+/* @brief:      Stops the background reclaimer, once it has destroyed everything queued so far */
+smrtptr_attribute(unused)
+static void smrtptr_stop_reclaimer(void) {
+    pthread_mutex_lock(&smrtptr_defer.reclaimer_lock);
+    if(!smrtptr_defer.reclaimer_running) {
+        pthread_mutex_unlock(&smrtptr_defer.reclaimer_lock);
+        return;
+    }
+    smrtptr_defer.reclaimer_stop = true;
+    smrtptr_defer.reclaimer_running = false;
+    pthread_cond_signal(&smrtptr_defer.reclaimer_wake);
+    pthread_t reclaimer = smrtptr_defer.reclaimer;
+    pthread_mutex_unlock(&smrtptr_defer.reclaimer_lock);
+    pthread_join(reclaimer, NULL);
+}
+
+#define SMRTPTR_CTRLBLK_DEFER_FIELD smrtptr_deferred deferred;
+
+#else
+
+#define SMRTPTR_CTRLBLK_DEFER_FIELD
+
+#endif // }}}
+
+/******************************** STATISTICS **********************************/// {{{
+
+/* Opt in with SMRTPTR_STATS. Every shared pointer type (smrtptr_strong and smrtptr_strong_atomic) then gets
+ * counters for its control blocks, reference copies, weak locks and destructor calls:
+ *  - counters live in a shard of the thread that bumps them (relaxed load + store, no RMW), and are summed
+ *      by smrtptr_get_stats. Shards of exited threads are folded into a total first
+ *  - live and peak control blocks are the exception: a peak can't be put back together from shards, so
+ *      they are shared atomics (one fetch_add per make and free, and a CAS when the peak moves)
+ *  - the typed make/new macros tag the next control block with its type. Control blocks made through the
+ *      _smrtptr_ functions directly are counted under SMRTPTR_STATS_UNTYPED
+ *  - destructors are timed with CLOCK_MONOTONIC, two clock reads per call (most of what stats add to a make and
+ *      drop). Define SMRTPTR_STATS_NO_TIMING to only count the calls
+ * Without SMRTPTR_STATS every hook is an empty macro. */
+#ifdef SMRTPTR_STATS
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/* SMRTPTR_STATS_STRONG_##T and SMRTPTR_STATS_ATOMIC_##T for every type in the lists */
+#define SHARED_PTR_DERIVE(T) SMRTPTR_STATS_STRONG_##T,
+#define SMRTPTR_DERIVE_SHARED_ATOMIC(T) SMRTPTR_STATS_ATOMIC_##T,
+enum smrtptr_stats_type {
+    SMRTPTR_STATS_UNTYPED,
+#ifdef SHARED_PTR_TYPE_LIST
+    SHARED_PTR_TYPE_LIST
+#endif
+#ifdef SMRTPTR_SHARED_ATOMIC_TYPE_LIST
+    SMRTPTR_SHARED_ATOMIC_TYPE_LIST
+#endif
+    SMRTPTR_STATS_NTYPES,
+};
+#undef SHARED_PTR_DERIVE
+#undef SMRTPTR_DERIVE_SHARED_ATOMIC
+
+#define SHARED_PTR_DERIVE(T) #T,
+#define SMRTPTR_DERIVE_SHARED_ATOMIC(T) "atomic " #T,
+static const char* const smrtptr_stats_names[SMRTPTR_STATS_NTYPES] = {
+    "untyped",
+#ifdef SHARED_PTR_TYPE_LIST
+    SHARED_PTR_TYPE_LIST
+#endif
+#ifdef SMRTPTR_SHARED_ATOMIC_TYPE_LIST
+    SMRTPTR_SHARED_ATOMIC_TYPE_LIST
+#endif
+};
+#undef SHARED_PTR_DERIVE
+#undef SMRTPTR_DERIVE_SHARED_ATOMIC
+
+enum smrtptr_stats_counter {
+    SMRTPTR_STATS_CREATED,
+    SMRTPTR_STATS_FREED,
+    SMRTPTR_STATS_COPIES,
+    SMRTPTR_STATS_LOCKS,
+    SMRTPTR_STATS_FAILED_LOCKS,
+    SMRTPTR_STATS_DESTRUCTOR_CALLS,
+    SMRTPTR_STATS_DESTRUCTOR_NS,
+    SMRTPTR_STATS_NCOUNTERS,
+};
+
+typedef struct {
+    size_t created;             // control blocks made
+    size_t freed;               // control blocks freed
+    size_t live;                // control blocks made and not yet freed
+    size_t peak;                // most control blocks live at once
+    size_t copies;              // strong and weak references copied (and atomic slot loads)
+    size_t locks;               // weak pointers locked
+    size_t failed_locks;        // weak pointers found dead by a lock
+    size_t destructor_calls;    // destructors run (NULL destructors aren't counted)
+    uint64_t destructor_ns;     // time spent in them (0 with SMRTPTR_STATS_NO_TIMING)
+} smrtptr_stats;
+
+/* Counters are only written by their own thread */
+typedef struct smrtptr_stats_shard {
+    atomic_size_t counters[SMRTPTR_STATS_NTYPES][SMRTPTR_STATS_NCOUNTERS];
+    bool registered;
+    struct smrtptr_stats_shard* prev_thread;
+    struct smrtptr_stats_shard* next_thread;
+} smrtptr_stats_shard;
+
+/* live and peak have one more entry, for all types together */
+static struct {
+    pthread_mutex_t lock;
+    smrtptr_stats_shard* threads;
+    size_t exited[SMRTPTR_STATS_NTYPES][SMRTPTR_STATS_NCOUNTERS];
+    atomic_size_t live[SMRTPTR_STATS_NTYPES + 1];
+    atomic_size_t peak[SMRTPTR_STATS_NTYPES + 1];
+    pthread_key_t key;
+    pthread_once_t once;
+} smrtptr_stats_global = { .lock = PTHREAD_MUTEX_INITIALIZER, .once = PTHREAD_ONCE_INIT };
+
+static _Thread_local smrtptr_stats_shard smrtptr_stats_local;
+
+/* Type of the next control block made on this thread, set by the typed macros */
+static _Thread_local uint16_t smrtptr_stats_tag;
+
+/* Runs when a thread that counted something exits */
+static void smrtptr_stats_thread_exit(void* arg) {
+    smrtptr_stats_shard* t = arg;
+    pthread_mutex_lock(&smrtptr_stats_global.lock);
+    if(t->prev_thread != NULL) t->prev_thread->next_thread = t->next_thread;
+    else smrtptr_stats_global.threads = t->next_thread;
+    if(t->next_thread != NULL) t->next_thread->prev_thread = t->prev_thread;
+    for(size_t type = 0; type < SMRTPTR_STATS_NTYPES; type++) {
+        for(size_t counter = 0; counter < SMRTPTR_STATS_NCOUNTERS; counter++) {
+            smrtptr_stats_global.exited[type][counter] +=
+                atomic_load_explicit(&t->counters[type][counter], memory_order_relaxed);
+            atomic_store_explicit(&t->counters[type][counter], 0, memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&smrtptr_stats_global.lock);
+    t->registered = false;
+}
+
+static void smrtptr_stats_make_key(void) {
+    pthread_key_create(&smrtptr_stats_global.key, smrtptr_stats_thread_exit);
+}
+
+smrtptr_attribute(noinline)
+static void smrtptr_stats_register(smrtptr_stats_shard* t) {
+    pthread_once(&smrtptr_stats_global.once, smrtptr_stats_make_key);
+    pthread_setspecific(smrtptr_stats_global.key, t);
+    pthread_mutex_lock(&smrtptr_stats_global.lock);
+    t->prev_thread = NULL;
+    t->next_thread = smrtptr_stats_global.threads;
+    if(smrtptr_stats_global.threads != NULL) smrtptr_stats_global.threads->prev_thread = t;
+    smrtptr_stats_global.threads = t;
+    pthread_mutex_unlock(&smrtptr_stats_global.lock);
+    t->registered = true;
+}
+
+static inline void smrtptr_stats_add(uint16_t type, enum smrtptr_stats_counter counter, size_t n) {
+    smrtptr_stats_shard* t = &smrtptr_stats_local;
+    if(!t->registered) smrtptr_stats_register(t);
+    atomic_size_t* c = &t->counters[type][counter];
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline void smrtptr_stats_live_add(size_t index) {
+    size_t live = atomic_fetch_add_explicit(&smrtptr_stats_global.live[index], 1, memory_order_relaxed) + 1;
+    size_t peak = atomic_load_explicit(&smrtptr_stats_global.peak[index], memory_order_relaxed);
+    while(live > peak && !atomic_compare_exchange_weak_explicit(
+        &smrtptr_stats_global.peak[index], &peak, live, memory_order_relaxed, memory_order_relaxed
+    ));
+}
+
+/* Takes the tag set by a typed macro, so a later untyped make doesn't inherit it */
+static inline uint16_t smrtptr_stats_take_tag(void) {
+    uint16_t type = smrtptr_stats_tag;
+    smrtptr_stats_tag = SMRTPTR_STATS_UNTYPED;
+    return type;
+}
+
+static inline void smrtptr_stats_created(uint16_t type) {
+    smrtptr_stats_add(type, SMRTPTR_STATS_CREATED, 1);
+    smrtptr_stats_live_add(type);
+    smrtptr_stats_live_add(SMRTPTR_STATS_NTYPES);
+}
+
+static inline void smrtptr_stats_freed(uint16_t type) {
+    smrtptr_stats_add(type, SMRTPTR_STATS_FREED, 1);
+    atomic_fetch_sub_explicit(&smrtptr_stats_global.live[type], 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&smrtptr_stats_global.live[SMRTPTR_STATS_NTYPES], 1, memory_order_relaxed);
+}
+
+smrtptr_attribute(unused)
+static inline uint64_t smrtptr_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void smrtptr_stats_destroy(uint16_t type, void (*destructor)(void*), void* object) {
+    if(destructor == NULL) return;
+#ifdef SMRTPTR_STATS_NO_TIMING
+    destructor(object);
+#else
+    uint64_t start = smrtptr_stats_now();
+    destructor(object);
+    smrtptr_stats_add(type, SMRTPTR_STATS_DESTRUCTOR_NS, (size_t)(smrtptr_stats_now() - start));
+#endif
+    smrtptr_stats_add(type, SMRTPTR_STATS_DESTRUCTOR_CALLS, 1);
+}
+
+/* Sums the shards (under the lock) into stats, for one type or all of them */
+static void smrtptr_stats_collect(smrtptr_stats* stats, size_t first, size_t last) {
+    size_t sums[SMRTPTR_STATS_NCOUNTERS] = {0};
+    pthread_mutex_lock(&smrtptr_stats_global.lock);
+    for(size_t type = first; type < last; type++) {
+        for(size_t counter = 0; counter < SMRTPTR_STATS_NCOUNTERS; counter++) {
+            sums[counter] += smrtptr_stats_global.exited[type][counter];
+        }
+        for(smrtptr_stats_shard* t = smrtptr_stats_global.threads; t != NULL; t = t->next_thread) {
+            for(size_t counter = 0; counter < SMRTPTR_STATS_NCOUNTERS; counter++) {
+                sums[counter] += atomic_load_explicit(&t->counters[type][counter], memory_order_relaxed);
+            }
+        }
+    }
+    pthread_mutex_unlock(&smrtptr_stats_global.lock);
+    stats->created = sums[SMRTPTR_STATS_CREATED];
+    stats->freed = sums[SMRTPTR_STATS_FREED];
+    stats->copies = sums[SMRTPTR_STATS_COPIES];
+    stats->locks = sums[SMRTPTR_STATS_LOCKS];
+    stats->failed_locks = sums[SMRTPTR_STATS_FAILED_LOCKS];
+    stats->destructor_calls = sums[SMRTPTR_STATS_DESTRUCTOR_CALLS];
+    stats->destructor_ns = sums[SMRTPTR_STATS_DESTRUCTOR_NS];
+}
+
+/* @brief:      Collects the counters of one pointer type across all threads
+ * @param:      enum smrtptr_stats_type type: SMRTPTR_STATS_STRONG_##T, SMRTPTR_STATS_ATOMIC_##T or
+ *              SMRTPTR_STATS_UNTYPED
+ * @return:     smrtptr_stats - a snapshot (counters of running threads may be slightly behind) */
+smrtptr_attribute(unused)
+static smrtptr_stats smrtptr_get_stats(enum smrtptr_stats_type type) {
+    smrtptr_stats stats = {0};
+    if((size_t)type >= SMRTPTR_STATS_NTYPES) return stats;
+    smrtptr_stats_collect(&stats, type, type + 1);
+    stats.live = atomic_load_explicit(&smrtptr_stats_global.live[type], memory_order_relaxed);
+    stats.peak = atomic_load_explicit(&smrtptr_stats_global.peak[type], memory_order_relaxed);
+    return stats;
+}
+
+/* @brief:      Collects the counters of all pointer types together. The peak is the most control blocks
+ *              live at once overall, not the sum of the peaks of each type
+ * @return:     smrtptr_stats */
+smrtptr_attribute(unused)
+static smrtptr_stats smrtptr_get_stats_total(void) {
+    smrtptr_stats stats = {0};
+    smrtptr_stats_collect(&stats, 0, SMRTPTR_STATS_NTYPES);
+    stats.live = atomic_load_explicit(&smrtptr_stats_global.live[SMRTPTR_STATS_NTYPES], memory_order_relaxed);
+    stats.peak = atomic_load_explicit(&smrtptr_stats_global.peak[SMRTPTR_STATS_NTYPES], memory_order_relaxed);
+    return stats;
+}
+
+/* @brief:      Prints a table of the counters of every type that made a control block, then the total
+ * @param:      FILE* out */
+smrtptr_attribute(unused)
+static void smrtptr_print_stats(FILE* out) {
+    fprintf(out, "%-24s %10s %10s %10s %12s %10s %10s %10s %12s\n",
+        "type", "created", "live", "peak", "copies", "locks", "failed", "dtors", "dtor ms");
+    for(size_t type = 0; type <= SMRTPTR_STATS_NTYPES; type++) {
+        smrtptr_stats stats = type < SMRTPTR_STATS_NTYPES ? smrtptr_get_stats(type) : smrtptr_get_stats_total();
+        if(type < SMRTPTR_STATS_NTYPES && stats.created == 0) continue;
+        fprintf(out, "%-24s %10zu %10zu %10zu %12zu %10zu %10zu %10zu %12.3f\n",
+            type < SMRTPTR_STATS_NTYPES ? smrtptr_stats_names[type] : "total",
+            stats.created, stats.live, stats.peak, stats.copies, stats.locks, stats.failed_locks,
+            stats.destructor_calls, stats.destructor_ns / 1e6);
+    }
+}
+
+#define SMRTPTR_CTRLBLK_STATS_FIELD uint16_t stats_type;
+/* In a make function: takes the type tag before anything can fail */
+#define SMRTPTR_STATS_TAKE_TAG(name) const uint16_t name = smrtptr_stats_take_tag()
+#define SMRTPTR_STATS_CREATED(ctrl, type) ((ctrl)->stats_type = (type), smrtptr_stats_created(type))
+/* Prefix of a typed make/new macro call, followed by the call itself */
+#define SMRTPTR_STATS_TAG(kind, T) smrtptr_stats_tag = SMRTPTR_STATS_##kind##_##T,
+#define SMRTPTR_STATS_COUNT(ctrl, counter) smrtptr_stats_add((ctrl)->stats_type, SMRTPTR_STATS_##counter, 1)
+#define SMRTPTR_CTRLBLK_DESTROY(ctrl, object) smrtptr_stats_destroy((ctrl)->stats_type, (ctrl)->destructor, (object))
+#define SMRTPTR_CTRLBLK_FREE(ctrl) (smrtptr_stats_freed((ctrl)->stats_type), SMRTPTR_CTRLBLK_DEALLOC(ctrl))
+
+#else
+
+#define SMRTPTR_CTRLBLK_STATS_FIELD
+#define SMRTPTR_STATS_TAKE_TAG(name)
+#define SMRTPTR_STATS_CREATED(ctrl, type) ((void)0)
+#define SMRTPTR_STATS_TAG(kind, T)
+#define SMRTPTR_STATS_COUNT(ctrl, counter) ((void)0)
+/* NULL for objects from smrtptr_new_strong with nothing to release */
+#define SMRTPTR_CTRLBLK_DESTROY(ctrl, object) \
+    ((ctrl)->destructor != NULL ? (ctrl)->destructor(object) : (void)0)
+#define SMRTPTR_CTRLBLK_FREE(ctrl) SMRTPTR_CTRLBLK_DEALLOC(ctrl)
+
+#endif // }}}
 
 /****************************** UNIQUE POINTERS *******************************/// {{{
 
@@ -136,6 +903,9 @@ typedef struct {
     size_t nstrong;
     size_t nweak;
     void (*destructor)(void*);
+    SMRTPTR_CTRLBLK_POOL_FIELD
+    SMRTPTR_CTRLBLK_STATS_FIELD
+    SMRTPTR_CTRLBLK_DEFER_FIELD
 } shared_ptr_ctrlblk;
 
 /* @brief:      Defines the necessary structures and unions for a the list of weak and
@@ -194,16 +964,26 @@ typedef union {
  *              out of scope and gets freed
  */
 [[nodiscard]] static union smrtptr_strong_types _smrtptr_make_strong(void *alloc, void (*dealloc)(void*)) {
+    SMRTPTR_STATS_TAKE_TAG(stats_type);
     if (alloc == NULL) {
         smrtptr_errno |= SMRTPTR_MAKE_RECIEVED_NULL;
         return (union smrtptr_strong_types){0};
     }
-    shared_ptr_ctrlblk *temp_ctrl = malloc(sizeof(shared_ptr_ctrlblk));
+    bool pooled;
+    shared_ptr_ctrlblk *temp_ctrl = smrtptr_ctrlblk_alloc(
+        sizeof(shared_ptr_ctrlblk), _Alignof(shared_ptr_ctrlblk), &pooled
+    );
+    if (temp_ctrl == NULL) {
+        smrtptr_errno |= SMRTPTR_MALLOC_FAILED;
+        return (union smrtptr_strong_types){0};
+    }
     *temp_ctrl = (shared_ptr_ctrlblk){
         .nstrong = 1,
         .nweak = 1,
         .destructor = dealloc
     };
+    SMRTPTR_CTRLBLK_SET_POOLED(temp_ctrl, pooled);
+    SMRTPTR_STATS_CREATED(temp_ctrl, stats_type);
     _generic_shared_ptr generic_ptr = {
         .ptr = alloc,
         .ctrl = temp_ctrl,
@@ -211,9 +991,47 @@ typedef union {
     return (union smrtptr_strong_types)generic_ptr;
 }
 
+/* @brief:      Allocates the control block and a zeroed object of the given size in one block
+ *              (like std::make_shared). The object sits right after the control block, so
+ *              refcounting and dereferencing touch neighbouring memory, and everything is
+ *              released with a single free once the last weak reference is gone
+ * @param:      size_t size:    size of the object
+ * @param:      void (*finalizer)(void*): called on the object when the last strong pointer
+ *              goes away, to release anything it owns (NULL if there is nothing to release).
+ *              It must not free the object itself
+ */
+[[nodiscard]] smrtptr_attribute(unused)
+static union smrtptr_strong_types _smrtptr_new_strong(size_t size, void (*finalizer)(void*)) {
+    SMRTPTR_STATS_TAKE_TAG(stats_type);
+    const size_t offset = SMRTPTR_INLINE_OFFSET(shared_ptr_ctrlblk);
+    bool pooled;
+    shared_ptr_ctrlblk *temp_ctrl = smrtptr_ctrlblk_alloc(
+        offset + size, _Alignof(shared_ptr_ctrlblk), &pooled
+    );
+    if (temp_ctrl == NULL) {
+        smrtptr_errno |= SMRTPTR_MALLOC_FAILED;
+        return (union smrtptr_strong_types){0};
+    }
+    *temp_ctrl = (shared_ptr_ctrlblk){
+        .nstrong = 1,
+        .nweak = 1,
+        .destructor = finalizer
+    };
+    SMRTPTR_CTRLBLK_SET_POOLED(temp_ctrl, pooled);
+    SMRTPTR_STATS_CREATED(temp_ctrl, stats_type);
+    void* object = (char*)temp_ctrl + offset;
+    memset(object, 0, size);
+    _generic_shared_ptr generic_ptr = {
+        .ptr = object,
+        .ctrl = temp_ctrl,
+    };
+    return (union smrtptr_strong_types)generic_ptr;
+}
+
 /* @brief:      copies a strong pointer into a weak or strong pointer
  * @param:      */
-[[nodiscard]] static shared_ptr_option _smrtptr_copy_strong(
+[[nodiscard]] smrtptr_attribute(unused)
+static shared_ptr_option _smrtptr_copy_strong(
     union smrtptr_strong_types ptr,
     enum smrtptr_types type
 ) {
@@ -235,9 +1053,18 @@ typedef union {
             return (shared_ptr_option){0};
         }
     }
+    SMRTPTR_STATS_COUNT(ptr.generic.ctrl, COPIES);
     return (shared_ptr_option)ptr;
 }
 
+#ifdef SMRTPTR_DEFERRED_DESTROY
+static void smrtptr_ctrlblk_deferred_release(smrtptr_deferred* node) {
+    shared_ptr_ctrlblk* ctrl = (shared_ptr_ctrlblk*)((char*)node - offsetof(shared_ptr_ctrlblk, deferred));
+    SMRTPTR_CTRLBLK_DESTROY(ctrl, node->object);
+    SMRTPTR_CTRLBLK_FREE(ctrl);     // only queued without weak pointers
+}
+#endif
+
 static void smrtptr_free_strong(void* ptr) {
     _generic_shared_ptr* _ptr = (_generic_shared_ptr*)ptr;
     if(_ptr->ctrl == NULL) {
@@ -245,8 +1072,14 @@ static void smrtptr_free_strong(void* ptr) {
         return;
     }
     if(--_ptr->ctrl->nstrong == 0) {
-        _ptr->ctrl->destructor(_ptr->ptr);
-        if(--_ptr->ctrl->nweak == 0) free(_ptr->ctrl);
+#ifdef SMRTPTR_DEFERRED_DESTROY
+        if(_ptr->ctrl->nweak == 1) {
+            smrtptr_defer_push(&_ptr->ctrl->deferred, _ptr->ptr, smrtptr_ctrlblk_deferred_release);
+            return;
+        }
+#endif
+        SMRTPTR_CTRLBLK_DESTROY(_ptr->ctrl, _ptr->ptr);
+        if(--_ptr->ctrl->nweak == 0) SMRTPTR_CTRLBLK_FREE(_ptr->ctrl);
     }
 }
 
@@ -258,10 +1091,12 @@ static void smrtptr_free_strong(void* ptr) {
     switch(type){
         case SMRTPTR_WEAK: {
             ptr.generic.ctrl->nweak++;
+            SMRTPTR_STATS_COUNT(ptr.generic.ctrl, COPIES);
             return (shared_ptr_option)ptr;
         }
         case SMRTPTR_STRONG: {
             ptr.generic.ctrl->nstrong++;
+            SMRTPTR_STATS_COUNT(ptr.generic.ctrl, COPIES);
             return (shared_ptr_option)ptr;
         }
         default: {
@@ -271,6 +1106,7 @@ static void smrtptr_free_strong(void* ptr) {
     }
 }
 
+smrtptr_attribute(unused)
 static void smrtptr_free_weak(void* ptr) {
     /* This type points to void and has no strong or weak association
      * this allows for any type to be implemented */
@@ -278,7 +1114,7 @@ static void smrtptr_free_weak(void* ptr) {
     /* we don't check the strong count because nweak only becomes 0
      * once all strong pointers are gone due to strong pointers implicitly
      * having a weak reference */
-    if(--_ptr->ctrl->nweak == 0) free(_ptr->ctrl);
+    if(--_ptr->ctrl->nweak == 0) SMRTPTR_CTRLBLK_FREE(_ptr->ctrl);
 }
 
 [[nodiscard]] smrtptr_attribute(unused)
@@ -288,6 +1124,7 @@ static bool _smrtptr_lock_weak(
 ) {
     if(src_ptr.generic.ctrl == NULL || src_ptr.generic.ctrl->nstrong == 0) {
         /* Ptr is dead */
+        if(src_ptr.generic.ctrl != NULL) SMRTPTR_STATS_COUNT(src_ptr.generic.ctrl, FAILED_LOCKS);
         dest_ptr->generic.ptr = NULL;
         dest_ptr->generic.ctrl = NULL;
         return false;
@@ -295,6 +1132,7 @@ static bool _smrtptr_lock_weak(
     /* Ptr is not dead */
     dest_ptr->generic = src_ptr.generic;
     dest_ptr->generic.ctrl->nstrong++;
+    SMRTPTR_STATS_COUNT(dest_ptr->generic.ctrl, LOCKS);
     return true;
 }
 
@@ -303,7 +1141,12 @@ static bool _smrtptr_lock_weak(
 #define smrtptr_strong(T) smrtptr_attribute( cleanup(smrtptr_free_strong) ) T##_smrtptr_strong
 #define smrtptr_weak(T) smrtptr_attribute( cleanup(smrtptr_free_weak) ) T##_smrtptr_weak
 #define smrtptr_make_strong(T, alloc, dealloc)  \
-    _smrtptr_make_strong(alloc, dealloc).T##_field
+    (SMRTPTR_STATS_TAG(STRONG, T) _smrtptr_make_strong(alloc, dealloc)).T##_field
+#define smrtptr_new_strong(T, finalizer) ({                                             \
+        static_assert(_Alignof(T) <= _Alignof(max_align_t), "over-aligned type");       \
+        SMRTPTR_STATS_TAG(STRONG, T)                                                    \
+        _smrtptr_new_strong(sizeof(T), finalizer).T##_field;                            \
+    })
 #define smrtptr_copy_strong(T, ptr, type) \
     _smrtptr_copy_strong((union smrtptr_strong_types)ptr, type).type##_FIELD.T##_field
 #define smrtptr_copy_weak(T, ptr, type) \
@@ -318,13 +1161,356 @@ static bool _smrtptr_lock_weak(
 /* Thread safe implementation of shared and weak pointers using atomic reference counting */
 #include <stdatomic.h>
 
+/* Opt in with SMRTPTR_HAZARD (includes csl-hazard.h). Destruction of the object is then retired through
+ * hazard_retire instead of running as soon as the strong count hits 0, which gives weak pointers:
+ *  - smrtptr_protect_weak_atomic: a borrowed pointer that stays valid while a hazard slot holds the
+ *      control block, for the price of one hazard store and a load (no reference count traffic at all)
+ *  - a weak lock that is a single fetch_add instead of a CAS loop. The strong count is "sticky": the
+ *      decrement that takes it to 0 also sets SMRTPTR_STRONG_DEAD with a CAS, so a lock adds 1
+ *      unconditionally and fails if DEAD was already set. A lock that lands between the decrement and the
+ *      CAS revives the object, and the CAS fails (the revived reference will try again when it drops)
+ * Objects are destroyed a little later than without it, by whichever thread's scan finds them unprotected. */
+#ifdef SMRTPTR_HAZARD
+#ifdef SMRTPTR_BIASED_REFCOUNT
+#error "SMRTPTR_HAZARD can't be combined with SMRTPTR_BIASED_REFCOUNT"
+#endif
+#ifdef SMRTPTR_DEFERRED_DESTROY
+#error "SMRTPTR_HAZARD already defers destruction, it can't be combined with SMRTPTR_DEFERRED_DESTROY"
+#endif
+#ifndef HAZARD_IMPLEMENTATION
+#define HAZARD_IMPLEMENTATION
+#endif
+#include "csl-hazard.h"
+
+#define SMRTPTR_STRONG_DEAD ((size_t)1 << (sizeof(size_t) * 8 - 1))
+#endif
+
+struct smrtptr_brc_thread;
+
 /* The control block that is used for strong and weak pointers for all base types */
-typedef struct {
-    atomic_size_t nstrong;
-    atomic_size_t nweak;
+typedef struct atomic_shared_ptr_ctrlblk {
+#ifdef SMRTPTR_BIASED_REFCOUNT
+    SMRTPTR_CACHE_ALIGNED size_t nbiased;               // strong count of the owner thread (owner only)
+    _Atomic(struct smrtptr_brc_thread*) owner;
+    atomic_intptr_t nshared;                            // strong count of other threads << 2 | QUEUED | MERGED
+    struct atomic_shared_ptr_ctrlblk* next_queued;      // link in the owner's merge queue
+#else
+    SMRTPTR_CACHE_ALIGNED atomic_size_t nstrong;
+#endif
+    SMRTPTR_CACHE_ALIGNED atomic_size_t nweak;
+    void* object;           // for releases that only have the control block (merges, atomic slots)
     void (*destructor)(void*);
+    SMRTPTR_CTRLBLK_POOL_FIELD
+    SMRTPTR_CTRLBLK_STATS_FIELD
+    SMRTPTR_CTRLBLK_DEFER_FIELD
 } atomic_shared_ptr_ctrlblk;
 
+/* Runs the destructor once the strong count reaches 0, and frees the control block if there are
+ * no weak pointers left. Decrements that can hit 0 are acq_rel rather than release + an acquire fence:
+ * the same instructions on x86, and ThreadSanitizer understands them */
+#ifdef SMRTPTR_HAZARD
+static void smrtptr_ctrlblk_atomic_destroy(void* ptr) {
+    atomic_shared_ptr_ctrlblk* ctrl = ptr;
+    SMRTPTR_CTRLBLK_DESTROY(ctrl, ctrl->object);
+    if(atomic_fetch_sub_explicit(&ctrl->nweak, 1, memory_order_acq_rel) == 1) {
+        SMRTPTR_CTRLBLK_FREE(ctrl);
+    }
+}
+
+/* The object is always ctrl->object here, it's destroyed once no hazard slot holds the control block */
+static void smrtptr_ctrlblk_atomic_release(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    (void)object;
+    hazard_retire(ctrl, smrtptr_ctrlblk_atomic_destroy);
+}
+#elif defined(SMRTPTR_DEFERRED_DESTROY)
+static void smrtptr_ctrlblk_atomic_deferred_release(smrtptr_deferred* node) {
+    atomic_shared_ptr_ctrlblk* ctrl = (atomic_shared_ptr_ctrlblk*)(
+        (char*)node - offsetof(atomic_shared_ptr_ctrlblk, deferred)
+    );
+    SMRTPTR_CTRLBLK_DESTROY(ctrl, node->object);
+    if(atomic_fetch_sub_explicit(&ctrl->nweak, 1, memory_order_acq_rel) == 1) {
+        SMRTPTR_CTRLBLK_FREE(ctrl);
+    }
+}
+
+/* The strong group's weak reference keeps the control block alive while it's queued */
+static void smrtptr_ctrlblk_atomic_release(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    smrtptr_defer_push(&ctrl->deferred, object, smrtptr_ctrlblk_atomic_deferred_release);
+}
+#else
+static void smrtptr_ctrlblk_atomic_release(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    SMRTPTR_CTRLBLK_DESTROY(ctrl, object);
+    if(atomic_fetch_sub_explicit(&ctrl->nweak, 1, memory_order_acq_rel) == 1) {
+        SMRTPTR_CTRLBLK_FREE(ctrl);
+    }
+}
+#endif
+
+#ifdef SMRTPTR_BIASED_REFCOUNT
+/* Biased reference counting. Most copies and drops happen on the thread that made the object, so that
+ * thread (the owner) counts with plain non-atomic increments in nbiased. Other threads count in nshared
+ * with atomics, and their count can go negative (they may drop copies the owner made). The true count is
+ * nbiased + nshared, and the two are merged into nshared:
+ *  - when the owner's count drops to 0 (unless the object is queued, then the owner's drain merges it)
+ *  - when another thread takes nshared below 0. It sets QUEUED and pushes the object on the owner's
+ *      merge queue, which the owner empties on its next make, drop or weak lock (or at thread exit)
+ *  - by the thread that queues it, if the owner has already exited
+ * Once MERGED is set the object is counted in nshared only, like the plain atomic implementation. */
+#include <pthread.h>
+#include <stdint.h>
+
+#define SMRTPTR_BRC_MERGED          ((intptr_t)1)
+#define SMRTPTR_BRC_QUEUED          ((intptr_t)2)
+#define SMRTPTR_BRC_ONE             ((intptr_t)4)
+#define SMRTPTR_BRC_COUNT(word)     ((word) >> 2)
+
+typedef struct smrtptr_brc_thread {
+    _Atomic(atomic_shared_ptr_ctrlblk*) queue;      // objects waiting to be merged by this thread
+    atomic_size_t refs;                             // 1 while the thread runs, + 1 per unmerged object
+} smrtptr_brc_thread;
+
+/* Owner of every merged object, so no thread ever matches it */
+static smrtptr_brc_thread smrtptr_brc_nobody;
+/* Queue value once the owner has exited */
+#define SMRTPTR_BRC_EXITED ((atomic_shared_ptr_ctrlblk*)&smrtptr_brc_nobody)
+
+static _Thread_local smrtptr_brc_thread* smrtptr_brc_self;
+static pthread_key_t smrtptr_brc_key;
+static pthread_once_t smrtptr_brc_once = PTHREAD_ONCE_INIT;
+
+/* Folds the owner's count into nshared. The caller must be the owner, or the owner must have exited */
+static void smrtptr_brc_merge(atomic_shared_ptr_ctrlblk* ctrl) {
+    smrtptr_brc_thread* owner = atomic_load_explicit(&ctrl->owner, memory_order_relaxed);
+    intptr_t biased = (intptr_t)ctrl->nbiased;
+    ctrl->nbiased = 0;
+    atomic_store_explicit(&ctrl->owner, &smrtptr_brc_nobody, memory_order_relaxed);
+    intptr_t old = atomic_fetch_add_explicit(
+        &ctrl->nshared, biased * SMRTPTR_BRC_ONE + SMRTPTR_BRC_MERGED, memory_order_acq_rel
+    );
+    if(atomic_fetch_sub_explicit(&owner->refs, 1, memory_order_acq_rel) == 1) free(owner);
+    /* Any other thread may free ctrl as soon as it is merged, so only touch it if the count hit 0 */
+    if(SMRTPTR_BRC_COUNT(old) + biased == 0) smrtptr_ctrlblk_atomic_release(ctrl, ctrl->object);
+}
+
+/* The owner's count dropped to 0. A queued object (or one being queued right now) is left for the drain,
+ * merging it here as well would release it twice. Otherwise MERGED is set with a CAS, which can't succeed
+ * once QUEUED is set, so no thread queues the object after this. The CAS also takes a temporary reference,
+ * which keeps the control block alive until owner has been reset */
+static void smrtptr_brc_merge_owned(atomic_shared_ptr_ctrlblk* ctrl) {
+    intptr_t old = atomic_load_explicit(&ctrl->nshared, memory_order_relaxed);
+    do {
+        if(old & SMRTPTR_BRC_QUEUED) return;
+    } while(!atomic_compare_exchange_weak_explicit(
+        &ctrl->nshared, &old, (old + SMRTPTR_BRC_ONE) | SMRTPTR_BRC_MERGED, memory_order_acq_rel, memory_order_relaxed
+    ));
+    smrtptr_brc_thread* owner = atomic_load_explicit(&ctrl->owner, memory_order_relaxed);
+    atomic_store_explicit(&ctrl->owner, &smrtptr_brc_nobody, memory_order_relaxed);
+    if(atomic_fetch_sub_explicit(&owner->refs, 1, memory_order_acq_rel) == 1) free(owner);
+    old = atomic_fetch_sub_explicit(&ctrl->nshared, SMRTPTR_BRC_ONE, memory_order_acq_rel);
+    if(SMRTPTR_BRC_COUNT(old) == 1) smrtptr_ctrlblk_atomic_release(ctrl, ctrl->object);
+}
+
+static void smrtptr_brc_merge_list(atomic_shared_ptr_ctrlblk* ctrl) {
+    while(ctrl != NULL) {
+        atomic_shared_ptr_ctrlblk* next = ctrl->next_queued;
+        smrtptr_brc_merge(ctrl);
+        ctrl = next;
+    }
+}
+
+/* pthread key destructor. Objects the thread still owns are merged by whoever queues them next */
+static void smrtptr_brc_thread_exit(void* arg) {
+    smrtptr_brc_thread* self = arg;
+    smrtptr_brc_self = NULL;
+    smrtptr_brc_merge_list(atomic_exchange_explicit(&self->queue, SMRTPTR_BRC_EXITED, memory_order_acq_rel));
+    if(atomic_fetch_sub_explicit(&self->refs, 1, memory_order_acq_rel) == 1) free(self);
+}
+
+static void smrtptr_brc_make_key(void) {
+    pthread_key_create(&smrtptr_brc_key, smrtptr_brc_thread_exit);
+}
+
+smrtptr_attribute(noinline)
+static smrtptr_brc_thread* smrtptr_brc_register(void) {
+    pthread_once(&smrtptr_brc_once, smrtptr_brc_make_key);
+    smrtptr_brc_thread* self = malloc(sizeof(smrtptr_brc_thread));
+    if(self == NULL) return NULL;
+    atomic_init(&self->queue, NULL);
+    atomic_init(&self->refs, 1);
+    if(pthread_setspecific(smrtptr_brc_key, self) != 0) {
+        free(self);
+        return NULL;
+    }
+    smrtptr_brc_self = self;
+    return self;
+}
+
+smrtptr_attribute(noinline)
+static void smrtptr_brc_drain(smrtptr_brc_thread* self) {
+    smrtptr_brc_merge_list(atomic_exchange_explicit(&self->queue, NULL, memory_order_acquire));
+}
+
+/* Hands an object whose nshared went negative to its owner, or merges it here if the owner exited */
+smrtptr_attribute(noinline)
+static void smrtptr_brc_enqueue(atomic_shared_ptr_ctrlblk* ctrl) {
+    smrtptr_brc_thread* owner = atomic_load_explicit(&ctrl->owner, memory_order_relaxed);
+    atomic_shared_ptr_ctrlblk* head = atomic_load_explicit(&owner->queue, memory_order_acquire);
+    do {
+        if(head == SMRTPTR_BRC_EXITED) {
+            smrtptr_brc_merge(ctrl);
+            return;
+        }
+        ctrl->next_queued = head;
+    } while(!atomic_compare_exchange_weak_explicit(
+        &owner->queue, &head, ctrl, memory_order_release, memory_order_acquire
+    ));
+}
+
+static inline void smrtptr_strong_atomic_init(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    smrtptr_brc_thread* self = smrtptr_brc_self;
+    if(self == NULL) self = smrtptr_brc_register();
+    else if(atomic_load_explicit(&self->queue, memory_order_relaxed) != NULL) smrtptr_brc_drain(self);
+    ctrl->object = object;
+    ctrl->next_queued = NULL;
+    if(self == NULL) {
+        /* No thread record, so the object starts out merged */
+        ctrl->nbiased = 0;
+        atomic_init(&ctrl->owner, &smrtptr_brc_nobody);
+        atomic_init(&ctrl->nshared, SMRTPTR_BRC_ONE + SMRTPTR_BRC_MERGED);
+        return;
+    }
+    atomic_fetch_add_explicit(&self->refs, 1, memory_order_relaxed);
+    ctrl->nbiased = 1;
+    atomic_init(&ctrl->owner, self);
+    atomic_init(&ctrl->nshared, 0);
+}
+
+static inline void smrtptr_strong_atomic_add(atomic_shared_ptr_ctrlblk* ctrl, size_t n) {
+    if(atomic_load_explicit(&ctrl->owner, memory_order_relaxed) == smrtptr_brc_self) ctrl->nbiased += n;
+    else atomic_fetch_add_explicit(&ctrl->nshared, (intptr_t)n * SMRTPTR_BRC_ONE, memory_order_relaxed);
+}
+
+static inline void smrtptr_strong_atomic_inc(atomic_shared_ptr_ctrlblk* ctrl) {
+    smrtptr_strong_atomic_add(ctrl, 1);
+}
+
+smrtptr_attribute(noinline)
+static void smrtptr_brc_dec_shared(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    intptr_t old = atomic_load_explicit(&ctrl->nshared, memory_order_relaxed);
+    /* MERGED never gets cleared, so a plain decrement is enough from then on */
+    if(old & SMRTPTR_BRC_MERGED) {
+        old = atomic_fetch_sub_explicit(&ctrl->nshared, SMRTPTR_BRC_ONE, memory_order_acq_rel);
+        if(SMRTPTR_BRC_COUNT(old) == 1) smrtptr_ctrlblk_atomic_release(ctrl, object);
+        return;
+    }
+    intptr_t new;
+    do {
+        new = old - SMRTPTR_BRC_ONE;
+        if(!(old & SMRTPTR_BRC_MERGED) && SMRTPTR_BRC_COUNT(new) < 0) new |= SMRTPTR_BRC_QUEUED;
+    } while(!atomic_compare_exchange_weak_explicit(
+        &ctrl->nshared, &old, new, memory_order_acq_rel, memory_order_relaxed
+    ));
+    if(old & SMRTPTR_BRC_MERGED) {
+        if(SMRTPTR_BRC_COUNT(new) == 0) smrtptr_ctrlblk_atomic_release(ctrl, object);
+    } else if((new & SMRTPTR_BRC_QUEUED) && !(old & SMRTPTR_BRC_QUEUED)) {
+        smrtptr_brc_enqueue(ctrl);
+    }
+}
+
+static inline void smrtptr_strong_atomic_dec(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    smrtptr_brc_thread* self = smrtptr_brc_self;
+    if(atomic_load_explicit(&ctrl->owner, memory_order_relaxed) != self) {
+        smrtptr_brc_dec_shared(ctrl, object);
+        return;
+    }
+    if(--ctrl->nbiased == 0) smrtptr_brc_merge_owned(ctrl);
+    if(atomic_load_explicit(&self->queue, memory_order_relaxed) != NULL) smrtptr_brc_drain(self);
+}
+
+/* Takes a strong reference unless the object is dead. An unmerged object is never freed, so it can
+ * always be locked (from another thread that includes one whose last pointer was just dropped, until
+ * its owner merges it) */
+static inline bool smrtptr_strong_atomic_try_inc(atomic_shared_ptr_ctrlblk* ctrl) {
+    smrtptr_brc_thread* self = smrtptr_brc_self;
+    if(self != NULL && atomic_load_explicit(&self->queue, memory_order_relaxed) != NULL) smrtptr_brc_drain(self);
+    /* Once the queue is empty the owner's unmerged objects are all alive */
+    if(atomic_load_explicit(&ctrl->owner, memory_order_relaxed) == self) {
+        ctrl->nbiased++;
+        return true;
+    }
+    intptr_t old = atomic_load_explicit(&ctrl->nshared, memory_order_acquire);
+    do {
+        if((old & SMRTPTR_BRC_MERGED) && SMRTPTR_BRC_COUNT(old) == 0) return false;
+    } while(!atomic_compare_exchange_weak_explicit(
+        &ctrl->nshared, &old, old + SMRTPTR_BRC_ONE, memory_order_acq_rel, memory_order_acquire
+    ));
+    return true;
+}
+
+/* @brief:      Merges the objects other threads have queued for the calling thread. This already happens
+ *              on every make and drop, so it's only needed by a thread that holds on to its pointers for
+ *              a long time while other threads drop copies of them */
+smrtptr_attribute(unused)
+static void smrtptr_merge_biased(void) {
+    smrtptr_brc_thread* self = smrtptr_brc_self;
+    if(self != NULL) smrtptr_brc_drain(self);
+}
+
+#else
+
+static inline void smrtptr_strong_atomic_init(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    ctrl->object = object;
+    atomic_init(&ctrl->nstrong, 1);
+}
+
+static inline void smrtptr_strong_atomic_add(atomic_shared_ptr_ctrlblk* ctrl, size_t n) {
+    atomic_fetch_add_explicit(&ctrl->nstrong, n, memory_order_relaxed);
+}
+
+static inline void smrtptr_strong_atomic_inc(atomic_shared_ptr_ctrlblk* ctrl) {
+    smrtptr_strong_atomic_add(ctrl, 1);
+}
+
+static inline void smrtptr_strong_atomic_dec(atomic_shared_ptr_ctrlblk* ctrl, void* object) {
+    /* atomic_fetch_sub_explicit returns the old value. If we subtracted 1 and old value is
+     * 1 then count must be 0 */
+    if(atomic_fetch_sub_explicit(&ctrl->nstrong, 1, memory_order_acq_rel) == 1) {
+#ifdef SMRTPTR_HAZARD
+        /* Fails if a weak lock revived it in the meantime. seq_cst so the scan that follows sees the
+         * hazard of any smrtptr_protect_weak_atomic that read the count before it */
+        size_t zero = 0;
+        if(!atomic_compare_exchange_strong_explicit(
+            &ctrl->nstrong, &zero, SMRTPTR_STRONG_DEAD, memory_order_seq_cst, memory_order_relaxed
+        )) return;
+#endif
+        smrtptr_ctrlblk_atomic_release(ctrl, object);
+    }
+}
+
+static inline bool smrtptr_strong_atomic_try_inc(atomic_shared_ptr_ctrlblk* ctrl) {
+#ifdef SMRTPTR_HAZARD
+    /* Once DEAD is set the low bits no longer mean anything, so a failed lock doesn't undo its increment */
+    return !(atomic_fetch_add_explicit(&ctrl->nstrong, 1, memory_order_acq_rel) & SMRTPTR_STRONG_DEAD);
+#else
+    size_t nrefs = atomic_load_explicit(&ctrl->nstrong, memory_order_acquire);
+    do {
+        if(nrefs == 0) return false;
+    } while(!atomic_compare_exchange_weak_explicit(
+        &ctrl->nstrong,
+        &nrefs,
+        nrefs + 1,
+        memory_order_acq_rel,
+        memory_order_acquire
+    ));
+    return true;
+#endif
+}
+
+smrtptr_attribute(unused)
+static void smrtptr_merge_biased(void) {}
+
+#endif
+
 /* @brief:      Defines the necessary structures and unions for a the list of weak and
  *              strong pointer types
  *                  - T##_smrtptr_strong: Clonable owning pointer
@@ -382,14 +1568,24 @@ typedef union {
  */
 [[nodiscard]] smrtptr_attribute(unused)
 static union smrtptr_strong_atomic_types _smrtptr_make_strong_atomic(void *alloc, void (*dealloc)(void*)) {
+    SMRTPTR_STATS_TAKE_TAG(stats_type);
     if (alloc == NULL) {
         smrtptr_errno |= SMRTPTR_MAKE_RECIEVED_NULL;
         return (union smrtptr_strong_atomic_types){0};
     }
-    atomic_shared_ptr_ctrlblk* temp_ctrl = malloc(sizeof(shared_ptr_ctrlblk));
-    atomic_init(&temp_ctrl->nstrong, 1);
+    bool pooled;
+    atomic_shared_ptr_ctrlblk* temp_ctrl = smrtptr_ctrlblk_alloc(
+        sizeof(atomic_shared_ptr_ctrlblk), _Alignof(atomic_shared_ptr_ctrlblk), &pooled
+    );
+    if (temp_ctrl == NULL) {
+        smrtptr_errno |= SMRTPTR_MALLOC_FAILED;
+        return (union smrtptr_strong_atomic_types){0};
+    }
+    SMRTPTR_CTRLBLK_SET_POOLED(temp_ctrl, pooled);
+    smrtptr_strong_atomic_init(temp_ctrl, alloc);
     atomic_init(&temp_ctrl->nweak, 1);
     temp_ctrl->destructor = dealloc;
+    SMRTPTR_STATS_CREATED(temp_ctrl, stats_type);
     _generic_atomic_shared_ptr generic_ptr = {
         .ptr = alloc,
         .ctrl = temp_ctrl,
@@ -397,6 +1593,38 @@ static union smrtptr_strong_atomic_types _smrtptr_make_strong_atomic(void *alloc
     return (union smrtptr_strong_atomic_types)generic_ptr;
 }
 
+/* @brief:      Allocates the atomic control block and a zeroed object in one block. See
+ *              _smrtptr_new_strong
+ * @param:      size_t size:    size of the object
+ * @param:      void (*finalizer)(void*): called on the object when the last strong pointer
+ *              goes away (NULL if there is nothing to release)
+ */
+[[nodiscard]] smrtptr_attribute(unused)
+static union smrtptr_strong_atomic_types _smrtptr_new_strong_atomic(size_t size, void (*finalizer)(void*)) {
+    SMRTPTR_STATS_TAKE_TAG(stats_type);
+    const size_t offset = SMRTPTR_INLINE_OFFSET(atomic_shared_ptr_ctrlblk);
+    bool pooled;
+    atomic_shared_ptr_ctrlblk* temp_ctrl = smrtptr_ctrlblk_alloc(
+        offset + size, _Alignof(atomic_shared_ptr_ctrlblk), &pooled
+    );
+    if (temp_ctrl == NULL) {
+        smrtptr_errno |= SMRTPTR_MALLOC_FAILED;
+        return (union smrtptr_strong_atomic_types){0};
+    }
+    SMRTPTR_CTRLBLK_SET_POOLED(temp_ctrl, pooled);
+    void* object = (char*)temp_ctrl + offset;
+    memset(object, 0, size);
+    smrtptr_strong_atomic_init(temp_ctrl, object);
+    atomic_init(&temp_ctrl->nweak, 1);
+    temp_ctrl->destructor = finalizer;
+    SMRTPTR_STATS_CREATED(temp_ctrl, stats_type);
+    _generic_atomic_shared_ptr generic_ptr = {
+        .ptr = object,
+        .ctrl = temp_ctrl,
+    };
+    return (union smrtptr_strong_atomic_types)generic_ptr;
+}
+
 /* @brief:      copys a strong atomic pointer into a weak or strong atomic pointer
  * @param:      union smrtptr_strong_atomic_types ptr: Union containing all the smrtptr types
  *              implemented for atomic reference counting
@@ -414,7 +1642,7 @@ static atomic_shared_ptr_option _smrtptr_copy_strong_atomic(
     switch (type) {
         /* ++ and -- operators are not suitable for atomic reference counting */
         case SMRTPTR_STRONG_ATOMIC: {
-            atomic_fetch_add_explicit(&ptr.generic.ctrl->nstrong, 1, memory_order_relaxed);
+            smrtptr_strong_atomic_inc(ptr.generic.ctrl);
             break;
         }
         case SMRTPTR_WEAK_ATOMIC: {
@@ -426,6 +1654,7 @@ static atomic_shared_ptr_option _smrtptr_copy_strong_atomic(
             return (atomic_shared_ptr_option){0};
         }
     }
+    SMRTPTR_STATS_COUNT(ptr.generic.ctrl, COPIES);
     return (atomic_shared_ptr_option)ptr;
 }
 
@@ -436,16 +1665,7 @@ static void smrtptr_free_strong_atomic(void* ptr) {
         smrtptr_errno |= SMRTPTR_NULL_CTRL_BLOCK;
         return;
     }
-    /* atomic_fetch_sub_explicit returns the old value. If we subtracted 1 and old value is
-     * 1 then count must be 0 */
-    if(atomic_fetch_sub_explicit(&_ptr->ctrl->nstrong, 1, memory_order_release) == 1) {
-        atomic_thread_fence(memory_order_acquire);
-        _ptr->ctrl->destructor(_ptr->ptr);
-        if(atomic_fetch_sub_explicit(&_ptr->ctrl->nweak, 1, memory_order_release) == 1) {
-            atomic_thread_fence(memory_order_acquire);
-            free(_ptr->ctrl);
-        }
-    }
+    smrtptr_strong_atomic_dec(_ptr->ctrl, _ptr->ptr);
 }
 
 /* Weak pointers (are implemented for any type that strong ptr is implemented for) */
@@ -456,10 +1676,12 @@ static void smrtptr_free_strong_atomic(void* ptr) {
     switch(type){
         case SMRTPTR_WEAK_ATOMIC: {
             ptr.generic.ctrl->nweak++;
+            SMRTPTR_STATS_COUNT(ptr.generic.ctrl, COPIES);
             return (atomic_shared_ptr_option)ptr;
         }
         case SMRTPTR_STRONG_ATOMIC: {
-             ptr.generic.ctrl->nstrong++;
+             smrtptr_strong_atomic_inc(ptr.generic.ctrl);
+             SMRTPTR_STATS_COUNT(ptr.generic.ctrl, COPIES);
              return (atomic_shared_ptr_option)ptr;
         }
         default: {
@@ -471,9 +1693,8 @@ static void smrtptr_free_strong_atomic(void* ptr) {
 
 smrtptr_attribute(unused) static void smrtptr_free_weak_atomic(void* ptr) {
     _generic_atomic_shared_ptr* _ptr = ptr;
-    if(atomic_fetch_sub_explicit(&_ptr->ctrl->nweak, 1, memory_order_release) == 1) {
-        atomic_thread_fence(memory_order_acquire);
-        free(_ptr->ctrl);
+    if(atomic_fetch_sub_explicit(&_ptr->ctrl->nweak, 1, memory_order_acq_rel) == 1) {
+        SMRTPTR_CTRLBLK_FREE(_ptr->ctrl);
     }
 }
 
@@ -482,32 +1703,53 @@ static bool _smrtptr_lock_weak_atomic(
     union smrtptr_strong_atomic_types* dest_ptr,
     union smrtptr_weak_atomic_types* src_ptr
 ) {
-    size_t nrefs;
-    do {
-        nrefs = atomic_load_explicit(&src_ptr->generic.ctrl->nstrong, memory_order_acquire);
-        if(nrefs == 0) {
-            /* Is dead */
-            src_ptr->generic.ctrl = NULL;
-            src_ptr->generic.ptr = NULL;
-            return false;
-        }
-    } while(!atomic_compare_exchange_weak_explicit(
-        &src_ptr->generic.ctrl->nstrong,
-        &nrefs,
-        nrefs + 1,
-        memory_order_acq_rel,
-        memory_order_acquire
-    ));
+    if(!smrtptr_strong_atomic_try_inc(src_ptr->generic.ctrl)) {
+        /* Is dead */
+        SMRTPTR_STATS_COUNT(src_ptr->generic.ctrl, FAILED_LOCKS);
+        src_ptr->generic.ctrl = NULL;
+        src_ptr->generic.ptr = NULL;
+        return false;
+    }
     dest_ptr->generic = src_ptr->generic;
+    SMRTPTR_STATS_COUNT(dest_ptr->generic.ctrl, LOCKS);
     return true;
 }
 
+#ifdef SMRTPTR_HAZARD
+/* @brief:      Borrows the object of a weak pointer without taking a strong reference: the control block is
+ *              published in a hazard slot, so the object can't be destroyed until the slot is cleared
+ * @param:      size_t slot - hazard slot of the calling thread to use (< HAZARD_SLOTS)
+ * @param:      src_ptr - pointer to the weak pointer
+ * @return:     void* - the object, valid until hazard_clear(slot), or NULL if it is (being) destroyed */
+smrtptr_attribute(unused)
+static void* _smrtptr_protect_weak_atomic(size_t slot, union smrtptr_weak_atomic_types* src_ptr) {
+    atomic_shared_ptr_ctrlblk* ctrl = src_ptr->generic.ctrl;
+    if(ctrl == NULL) return NULL;
+    hazard_set(slot, ctrl);
+    size_t nstrong = atomic_load_explicit(&ctrl->nstrong, memory_order_seq_cst);
+    /* 0 without DEAD is a drop racing with a lock: treat it as dead rather than wait */
+    if(nstrong == 0 || (nstrong & SMRTPTR_STRONG_DEAD)) {
+        hazard_clear(slot);
+        return NULL;
+    }
+    return src_ptr->generic.ptr;
+}
+
+#define smrtptr_protect_weak_atomic(T, slot, src) \
+    ((T*)_smrtptr_protect_weak_atomic(slot, (union smrtptr_weak_atomic_types*)(src)))
+#endif
+
 #define smrtptr_strong_atomic(T) \
     smrtptr_attribute( cleanup(smrtptr_free_strong_atomic) ) T##_smrtptr_strong_atomic
 #define smrtptr_weak_atomic(T) \
     smrtptr_attribute( cleanup(smrtptr_free_weak_atomic) ) T##_smrtptr_weak_atomic
 #define smrtptr_make_strong_atomic(T, alloc, dealloc) \
-    _smrtptr_make_strong_atomic(alloc, dealloc).T##_field
+    (SMRTPTR_STATS_TAG(ATOMIC, T) _smrtptr_make_strong_atomic(alloc, dealloc)).T##_field
+#define smrtptr_new_strong_atomic(T, finalizer) ({                                      \
+        static_assert(_Alignof(T) <= _Alignof(max_align_t), "over-aligned type");       \
+        SMRTPTR_STATS_TAG(ATOMIC, T)                                                    \
+        _smrtptr_new_strong_atomic(sizeof(T), finalizer).T##_field;                     \
+    })
 #define smrtptr_copy_strong_atomic(T, ptr, type) \
     _smrtptr_copy_strong_atomic((union smrtptr_strong_atomic_types)ptr, type).type##_FIELD.T##_field
 #define smrtptr_copy_weak_atomic(T, ptr, type) \
@@ -515,6 +1757,135 @@ static bool _smrtptr_lock_weak_atomic(
 #define smrtptr_lock_weak_atomic(dest, src) \
     _smrtptr_lock_weak_atomic((union smrtptr_strong_atomic_types*)dest, (union smrtptr_weak_atomic_types*)src)
 
+/******************************** ATOMIC SLOT *********************************/
+
+/* A slot holding one strong atomic pointer, that any thread can load, store or compare_exchange without a
+ * lock (for snapshots that many threads read and a writer occasionally replaces). It uses split reference
+ * counts: the control block pointer and an external count share one word, with the count in the top 16 bits
+ * (user space addresses on x86-64 and AArch64 leave them clear). A load:
+ *  1. increments the external count, which keeps the control block alive, because whoever replaces the
+ *      pointer adds the external count to the strong count before dropping the slot's reference
+ *  2. takes a strong reference of its own
+ *  3. gives the external count back, or if the pointer was replaced in the meantime, drops the strong
+ *      reference the replacing thread added for it
+ * So a load is 3 atomic operations and never waits on another thread. */
+#define SMRTPTR_SLOT_SHIFT      48
+#define SMRTPTR_SLOT_ONE        ((uintptr_t)1 << SMRTPTR_SLOT_SHIFT)
+#define SMRTPTR_SLOT_CTRL(word) ((atomic_shared_ptr_ctrlblk*)((word) & (SMRTPTR_SLOT_ONE - 1)))
+
+static_assert(sizeof(uintptr_t) == 8, "atomic slots need 64 bit pointers");
+
+typedef struct {
+    _Atomic(uintptr_t) word;
+} smrtptr_atomic_slot;
+
+#define SMRTPTR_SLOT_INIT { 0 }
+
+/* Turns the external count of a pointer taken out of the slot into strong references, for the loads that
+ * are still in flight. The slot's own reference is then owned by the caller */
+static inline _generic_atomic_shared_ptr smrtptr_slot_take(uintptr_t word) {
+    atomic_shared_ptr_ctrlblk* ctrl = SMRTPTR_SLOT_CTRL(word);
+    if(ctrl == NULL) return (_generic_atomic_shared_ptr){0};
+    if(word >> SMRTPTR_SLOT_SHIFT) smrtptr_strong_atomic_add(ctrl, word >> SMRTPTR_SLOT_SHIFT);
+    return (_generic_atomic_shared_ptr){ .ptr = ctrl->object, .ctrl = ctrl };
+}
+
+static inline uintptr_t smrtptr_slot_word(atomic_shared_ptr_ctrlblk* ctrl) {
+    assert(((uintptr_t)ctrl >> SMRTPTR_SLOT_SHIFT) == 0 && "control block address uses the top 16 bits");
+    if(ctrl != NULL) smrtptr_strong_atomic_inc(ctrl);
+    return (uintptr_t)ctrl;
+}
+
+/* @brief:      Loads a new strong reference to the pointer in the slot
+ * @param:      smrtptr_atomic_slot* slot
+ * @return:     _generic_atomic_shared_ptr - empty (NULL ctrl) if the slot is empty */
+smrtptr_attribute(unused)
+static _generic_atomic_shared_ptr _smrtptr_slot_load(smrtptr_atomic_slot* slot) {
+    if(SMRTPTR_SLOT_CTRL(atomic_load_explicit(&slot->word, memory_order_relaxed)) == NULL) {
+        return (_generic_atomic_shared_ptr){0};
+    }
+    uintptr_t word = atomic_fetch_add_explicit(&slot->word, SMRTPTR_SLOT_ONE, memory_order_acquire);
+    word += SMRTPTR_SLOT_ONE;
+    atomic_shared_ptr_ctrlblk* ctrl = SMRTPTR_SLOT_CTRL(word);
+    _generic_atomic_shared_ptr loaded = {0};
+    if(ctrl != NULL) {
+        smrtptr_strong_atomic_inc(ctrl);
+        SMRTPTR_STATS_COUNT(ctrl, COPIES);
+        loaded = (_generic_atomic_shared_ptr){ .ptr = ctrl->object, .ctrl = ctrl };
+    }
+    /* A count of 0 means the pointer was replaced and stored again since step 1 */
+    while(SMRTPTR_SLOT_CTRL(word) == ctrl && (word >> SMRTPTR_SLOT_SHIFT) != 0) {
+        if(atomic_compare_exchange_weak_explicit(
+            &slot->word, &word, word - SMRTPTR_SLOT_ONE, memory_order_relaxed, memory_order_relaxed
+        )) return loaded;
+    }
+    if(ctrl != NULL) smrtptr_strong_atomic_dec(ctrl, ctrl->object);
+    return loaded;
+}
+
+/* @brief:      Replaces the pointer in the slot and returns the previous one
+ * @param:      smrtptr_atomic_slot* slot
+ * @param:      _generic_atomic_shared_ptr desired: pointer to store (the slot takes its own reference)
+ * @return:     _generic_atomic_shared_ptr - the previous pointer, owned by the caller */
+[[nodiscard]] smrtptr_attribute(unused)
+static _generic_atomic_shared_ptr _smrtptr_slot_exchange(smrtptr_atomic_slot* slot, _generic_atomic_shared_ptr desired) {
+    uintptr_t old = atomic_exchange_explicit(&slot->word, smrtptr_slot_word(desired.ctrl), memory_order_acq_rel);
+    return smrtptr_slot_take(old);
+}
+
+/* @brief:      Replaces the pointer in the slot and drops the previous one
+ * @param:      smrtptr_atomic_slot* slot
+ * @param:      _generic_atomic_shared_ptr desired: pointer to store (the slot takes its own reference) */
+smrtptr_attribute(unused)
+static void _smrtptr_slot_store(smrtptr_atomic_slot* slot, _generic_atomic_shared_ptr desired) {
+    _generic_atomic_shared_ptr old = _smrtptr_slot_exchange(slot, desired);
+    if(old.ctrl != NULL) smrtptr_free_strong_atomic(&old);
+}
+
+/* @brief:      Stores desired if the slot still holds the same control block as expected. Otherwise expected
+ *              is replaced with a new reference to the current pointer
+ * @param:      smrtptr_atomic_slot* slot
+ * @param:      union smrtptr_strong_atomic_types* expected: pointer the caller last loaded
+ * @param:      _generic_atomic_shared_ptr desired: pointer to store (the slot takes its own reference)
+ * @return:     bool - true if desired was stored */
+smrtptr_attribute(unused)
+static bool _smrtptr_slot_compare_exchange(
+    smrtptr_atomic_slot* slot,
+    union smrtptr_strong_atomic_types* expected,
+    _generic_atomic_shared_ptr desired
+) {
+    uintptr_t want = smrtptr_slot_word(desired.ctrl);
+    uintptr_t word = atomic_load_explicit(&slot->word, memory_order_relaxed);
+    /* The external count may change under us, only the control block has to match */
+    while(SMRTPTR_SLOT_CTRL(word) == expected->generic.ctrl) {
+        if(atomic_compare_exchange_weak_explicit(
+            &slot->word, &word, want, memory_order_acq_rel, memory_order_relaxed
+        )) {
+            _generic_atomic_shared_ptr old = smrtptr_slot_take(word);
+            if(old.ctrl != NULL) smrtptr_free_strong_atomic(&old);
+            return true;
+        }
+    }
+    if(desired.ctrl != NULL) smrtptr_strong_atomic_dec(desired.ctrl, desired.ptr);
+    _generic_atomic_shared_ptr current = _smrtptr_slot_load(slot);
+    if(expected->generic.ctrl != NULL) smrtptr_free_strong_atomic(&expected->generic);
+    expected->generic = current;
+    return false;
+}
+
+#define smrtptr_slot_load(T, slot) \
+    ((union smrtptr_strong_atomic_types)_smrtptr_slot_load(slot)).T##_field
+#define smrtptr_slot_store(slot, ptr) \
+    _smrtptr_slot_store(slot, ((union smrtptr_strong_atomic_types)ptr).generic)
+#define smrtptr_slot_exchange(T, slot, ptr) \
+    ((union smrtptr_strong_atomic_types)_smrtptr_slot_exchange(slot, ((union smrtptr_strong_atomic_types)ptr).generic)).T##_field
+#define smrtptr_slot_compare_exchange(slot, expected, desired) \
+    _smrtptr_slot_compare_exchange(slot, (union smrtptr_strong_atomic_types*)expected, \
+        ((union smrtptr_strong_atomic_types)desired).generic)
+/* Drops the slot's reference (for a slot that is going away) */
+#define smrtptr_slot_reset(slot) \
+    _smrtptr_slot_store(slot, (_generic_atomic_shared_ptr){0})
+
 #endif // }}}
 
 #endif
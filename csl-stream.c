@@ -0,0 +1,374 @@
+/*******************************************************************************
+* Name:             csl-stream.c                                               *
+* Description:      Buffered file reader/writer built on DString               *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   StreamReader owns a page aligned DString refill buffer     *
+*                   which is filled with read(2) in multiples of the block     *
+*                   size (1 MiB by default). Records are returned as String    *
+*                   slices pointing into the buffer, so nothing is copied      *
+*                   except the tail of a record that straddles a refill, which *
+*                   is moved to the front of the buffer before the next read.  *
+*                   StreamWriter queues String slices and flushes them with a  *
+*                   single writev(2) once enough bytes or slices are pending.  *
+* Usage:            StreamReader in = UNWRAP(stream_reader_open(path, 0), ..); *
+*                   WRESULT(String) line;                                      *
+*                   while(!(line = stream_read_line(&in)).err) {               *
+*                       ...                                                    *
+*                   }                                                          *
+*                   if(in.error) perror("read");                               *
+*                   stream_reader_close(&in);                                  *
+*                                                                              *
+*                   - Slices returned by the reader are invalidated by the     *
+*                       next read from the same reader.                        *
+*                   - stream_write copies the slice into the writer, so it can *
+*                       be reused immediately. stream_write_ref only keeps a   *
+*                       reference, so the bytes must stay valid until the next *
+*                       flush.                                                 *
+*                   - Both close functions take a void* so they can be used    *
+*                       as cleanup/smrtptr destructors.                        *
+*******************************************************************************/
+
+#ifndef __CSL_STREAM_C
+#define __CSL_STREAM_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+
+#define STREAM_DEFAULT_BLOCK    (1 << 20)
+#define STREAM_ALIGNMENT        4096
+#define STREAM_WRITER_SEGMENTS  256
+
+typedef struct {
+    int fd;
+    bool owns_fd;
+    bool eof;
+    int error;          // errno of the last failed read, 0 if none
+    DString buffer;     // s.size is the number of bytes read into the buffer
+    size_t pos;         // offset of the first byte not yet returned
+    size_t block_size;
+} StreamReader;
+
+/* A queued write, either a referenced slice or a range of the staging buffer */
+typedef struct {
+    const char* base;   // NULL if the bytes are in the staging buffer
+    size_t offset;
+    size_t size;
+} StreamSegment;
+
+typedef struct {
+    int fd;
+    bool owns_fd;
+    int error;          // errno of the last failed write, 0 if none
+    DString staging;    // copies made by stream_write
+    StreamSegment* segments;
+    size_t nsegments;
+    size_t pending;     // bytes queued
+    size_t flush_size;
+} StreamWriter;
+
+DERIVE_WRESULT(StreamReader);
+DERIVE_WRESULT(StreamWriter);
+
+WRESULT(StreamReader) stream_reader_from_fd(int fd, size_t block_size);
+WRESULT(StreamReader) stream_reader_open(const char* path, size_t block_size);
+WRESULT(String) stream_read_until(StreamReader* self, char delim);
+WRESULT(String) stream_read_line(StreamReader* self);
+void stream_reader_close(void* reader);
+WRESULT(StreamWriter) stream_writer_from_fd(int fd, size_t flush_size);
+WRESULT(StreamWriter) stream_writer_open(const char* path, size_t flush_size);
+WRESULT(size_t) stream_write(StreamWriter* self, String str);
+WRESULT(size_t) stream_write_ref(StreamWriter* self, String str);
+WRESULT(size_t) stream_flush(StreamWriter* self);
+void stream_writer_close(void* writer);
+
+#if !defined(CSL_STREAM_INTERFACE)
+
+static inline size_t stream_round_up(size_t n, size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+/******************************** READER **************************************/
+
+/* @brief:  Creates a reader over an already open file descriptor. The
+ *          descriptor is not closed by stream_reader_close
+ * @param:  int fd - descriptor to read from
+ * @param:  size_t block_size - bytes per read (rounded up to a page), 0 for default
+ * @return: WRESULT(StreamReader) - the new reader */
+WRESULT(StreamReader) stream_reader_from_fd(int fd, size_t block_size) {
+    StreamReader reader = { .fd = fd };
+    if(fd < 0) return WRESULT_ERR(StreamReader, reader);
+    if(block_size == 0) block_size = STREAM_DEFAULT_BLOCK;
+    reader.block_size = stream_round_up(block_size, STREAM_ALIGNMENT);
+    size_t capacity = 2 * reader.block_size;
+    reader.buffer.s.start = aligned_alloc(STREAM_ALIGNMENT, capacity);
+    if(reader.buffer.s.start == NULL) return WRESULT_ERR(StreamReader, reader);
+    reader.buffer.capacity = capacity;
+    return WRESULT_OK(StreamReader, reader);
+}
+
+/* @brief:  Opens a file for buffered reading
+ * @param:  const char* path - file to open
+ * @param:  size_t block_size - bytes per read (rounded up to a page), 0 for default
+ * @return: WRESULT(StreamReader) - the new reader */
+WRESULT(StreamReader) stream_reader_open(const char* path, size_t block_size) {
+    int fd = path == NULL ? -1 : open(path, O_RDONLY | O_CLOEXEC);
+    WRESULT(StreamReader) reader = stream_reader_from_fd(fd, block_size);
+    if(reader.err) {
+        reader.value.error = errno;
+        if(fd >= 0) close(fd);
+        return reader;
+    }
+    reader.value.owns_fd = true;
+    /* Ask for aggressive read-ahead, we only ever move forward */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return reader;
+}
+
+/* Reads at least one more block into the buffer. Moves the unreturned tail to the
+ * front of the buffer first if there is not room for a full block, and grows the
+ * buffer if a single record is larger than it. Returns false on EOF or error */
+static bool stream_refill(StreamReader* self) {
+    DString* buf = &self->buffer;
+    if(buf->capacity - buf->s.size < self->block_size && self->pos > 0) {
+        size_t tail = buf->s.size - self->pos;
+        memmove(buf->s.start, buf->s.start + self->pos, tail);
+        buf->s.size = tail;
+        self->pos = 0;
+    }
+    if(buf->capacity - buf->s.size < self->block_size) {
+        /* realloc does not keep the alignment */
+        size_t capacity = stream_round_up(buf->capacity * 2, STREAM_ALIGNMENT);
+        char* start = aligned_alloc(STREAM_ALIGNMENT, capacity);
+        if(start == NULL) {
+            self->error = ENOMEM;
+            return false;
+        }
+        memcpy(start, buf->s.start, buf->s.size);
+        free(buf->s.start);
+        buf->s.start = start;
+        buf->capacity = capacity;
+    }
+    /* Read as many whole blocks as fit */
+    size_t space = (buf->capacity - buf->s.size) / self->block_size * self->block_size;
+    for(;;) {
+        ssize_t n = read(self->fd, buf->s.start + buf->s.size, space);
+        if(n > 0) {
+            buf->s.size += (size_t)n;
+            return true;
+        }
+        if(n == 0) {
+            self->eof = true;
+            return false;
+        }
+        if(errno != EINTR) {
+            self->error = errno;
+            return false;
+        }
+    }
+}
+
+/* @brief:  Reads the next record ending in delim
+ * @param:  StreamReader* self - reference to the reader
+ * @param:  char delim - record terminator (not included in the returned slice)
+ * @return: WRESULT(String) - slice into the reader's buffer, valid until the next
+ *          read. The last record does not need a terminator. Errors at the end of
+ *          the file or on a read error (self->error is set) */
+WRESULT(String) stream_read_until(StreamReader* self, char delim) {
+    String fail = (String){0};
+    if(self == NULL || self->buffer.s.start == NULL) return WRESULT_ERR(String, fail);
+    size_t scanned = self->pos;
+    for(;;) {
+        DString* buf = &self->buffer;
+        char* found = memchr(buf->s.start + scanned, delim, buf->s.size - scanned);
+        if(found != NULL) {
+            String record = { .start = buf->s.start + self->pos, .size = (size_t)(found - buf->s.start) - self->pos };
+            self->pos += record.size + 1;
+            return WRESULT_OK(String, record);
+        }
+        /* Keep our place relative to pos, the refill may move the tail */
+        size_t offset = buf->s.size - self->pos;
+        if(self->eof || self->error || !stream_refill(self)) {
+            if(self->error || self->pos == buf->s.size) return WRESULT_ERR(String, fail);
+            String record = { .start = buf->s.start + self->pos, .size = buf->s.size - self->pos };
+            self->pos = buf->s.size;
+            return WRESULT_OK(String, record);
+        }
+        scanned = self->pos + offset;
+    }
+}
+
+/* @brief:  Reads the next line, without the "\n" or "\r\n" terminator
+ * @param:  StreamReader* self - reference to the reader
+ * @return: WRESULT(String) - see stream_read_until */
+WRESULT(String) stream_read_line(StreamReader* self) {
+    WRESULT(String) line = stream_read_until(self, '\n');
+    if(!line.err && line.value.size > 0 && line.value.start[line.value.size - 1] == '\r') line.value.size--;
+    return line;
+}
+
+/* @brief:  Frees the buffer, and closes the file if the reader opened it
+ * @param:  void* reader - pointer to the StreamReader */
+void stream_reader_close(void* reader) {
+    StreamReader* self = reader;
+    if(self == NULL) return;
+    if(self->owns_fd && self->fd >= 0) close(self->fd);
+    dstring_delete(&self->buffer);
+    *self = (StreamReader){ .fd = -1 };
+}
+
+/******************************** WRITER **************************************/
+
+/* @brief:  Creates a writer over an already open file descriptor. The
+ *          descriptor is not closed by stream_writer_close
+ * @param:  int fd - descriptor to write to
+ * @param:  size_t flush_size - pending bytes that trigger a flush, 0 for default
+ * @return: WRESULT(StreamWriter) - the new writer */
+WRESULT(StreamWriter) stream_writer_from_fd(int fd, size_t flush_size) {
+    StreamWriter writer = { .fd = fd, .flush_size = flush_size ? flush_size : STREAM_DEFAULT_BLOCK };
+    if(fd < 0) return WRESULT_ERR(StreamWriter, writer);
+    writer.segments = malloc(STREAM_WRITER_SEGMENTS * sizeof(StreamSegment));
+    if(writer.segments == NULL) return WRESULT_ERR(StreamWriter, writer);
+    return WRESULT_OK(StreamWriter, writer);
+}
+
+/* @brief:  Creates (or truncates) a file for buffered writing
+ * @param:  const char* path - file to open
+ * @param:  size_t flush_size - pending bytes that trigger a flush, 0 for default
+ * @return: WRESULT(StreamWriter) - the new writer */
+WRESULT(StreamWriter) stream_writer_open(const char* path, size_t flush_size) {
+    int fd = path == NULL ? -1 : open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    WRESULT(StreamWriter) writer = stream_writer_from_fd(fd, flush_size);
+    if(writer.err) {
+        writer.value.error = errno;
+        if(fd >= 0) close(fd);
+        return writer;
+    }
+    writer.value.owns_fd = true;
+    return writer;
+}
+
+/* @brief:  Writes everything queued with one writev call (more if the kernel
+ *          accepts a partial write)
+ * @param:  StreamWriter* self - reference to the writer
+ * @return: WRESULT(size_t) - number of bytes written */
+WRESULT(size_t) stream_flush(StreamWriter* self) {
+    if(self == NULL || self->segments == NULL) return WRESULT_ERR(size_t, 0);
+    struct iovec iov[STREAM_WRITER_SEGMENTS];
+    for(size_t i = 0; i < self->nsegments; i++) {
+        StreamSegment seg = self->segments[i];
+        iov[i].iov_base = (char*)(seg.base != NULL ? seg.base : self->staging.s.start) + seg.offset;
+        iov[i].iov_len = seg.size;
+    }
+    struct iovec* next = iov;
+    int remaining = (int)self->nsegments;
+    size_t written = 0;
+    while(remaining > 0) {
+        ssize_t n = writev(self->fd, next, remaining);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            self->error = errno;
+            /* Keep only the unwritten bytes so the next flush doesn't repeat them */
+            size_t done = (size_t)(next - iov);
+            for(size_t i = 0; i < (size_t)remaining; i++) {
+                StreamSegment seg = self->segments[done + i];
+                if(i == 0) {
+                    seg.offset += seg.size - next->iov_len;
+                    seg.size = next->iov_len;
+                }
+                self->segments[i] = seg;
+            }
+            self->nsegments = (size_t)remaining;
+            self->pending -= written;
+            return WRESULT_ERR(size_t, written);
+        }
+        written += (size_t)n;
+        /* Skip the fully written segments and trim the partial one */
+        while(remaining > 0 && (size_t)n >= next->iov_len) {
+            n -= next->iov_len;
+            next++;
+            remaining--;
+        }
+        if(remaining > 0) {
+            next->iov_base = (char*)next->iov_base + n;
+            next->iov_len -= n;
+        }
+    }
+    self->nsegments = 0;
+    self->pending = 0;
+    self->staging.s.size = 0;
+    return WRESULT_OK(size_t, written);
+}
+
+static WRESULT(size_t) stream_queue(StreamWriter* self, StreamSegment seg) {
+    if(self->nsegments == STREAM_WRITER_SEGMENTS) {
+        UNWRAP(stream_flush(self), return WRESULT_ERR(size_t, self->pending));
+    }
+    StreamSegment* last = self->nsegments ? &self->segments[self->nsegments - 1] : NULL;
+    /* Consecutive copies are contiguous in the staging buffer */
+    if(last != NULL && last->base == NULL && seg.base == NULL && last->offset + last->size == seg.offset) {
+        last->size += seg.size;
+    } else {
+        self->segments[self->nsegments++] = seg;
+    }
+    self->pending += seg.size;
+    if(self->pending >= self->flush_size) {
+        UNWRAP(stream_flush(self), return WRESULT_ERR(size_t, self->pending));
+    }
+    return WRESULT_OK(size_t, self->pending);
+}
+
+/* @brief:  Queues a copy of str
+ * @param:  StreamWriter* self - reference to the writer
+ * @param:  String str - bytes to write
+ * @return: WRESULT(size_t) - bytes pending after the call */
+WRESULT(size_t) stream_write(StreamWriter* self, String str) {
+    if(self == NULL || self->segments == NULL) return WRESULT_ERR(size_t, 0);
+    if(str.size == 0) return WRESULT_OK(size_t, self->pending);
+    /* Flush first so the staging buffer never holds more than flush_size, and
+     * so a flush for a full segment array can't reset staging under offset */
+    if((self->pending + str.size > self->flush_size && self->pending > 0)
+        || self->nsegments == STREAM_WRITER_SEGMENTS) {
+        UNWRAP(stream_flush(self), return WRESULT_ERR(size_t, self->pending));
+    }
+    size_t offset = self->staging.s.size;
+    UNWRAP(dstring_append_slice(&self->staging, str), return WRESULT_ERR(size_t, self->pending));
+    return stream_queue(self, (StreamSegment){ .base = NULL, .offset = offset, .size = str.size });
+}
+
+/* @brief:  Queues str without copying it. The bytes must not change or be freed
+ *          until the writer is flushed (or closed)
+ * @param:  StreamWriter* self - reference to the writer
+ * @param:  String str - bytes to write
+ * @return: WRESULT(size_t) - bytes pending after the call */
+WRESULT(size_t) stream_write_ref(StreamWriter* self, String str) {
+    if(self == NULL || self->segments == NULL) return WRESULT_ERR(size_t, 0);
+    if(str.size == 0) return WRESULT_OK(size_t, self->pending);
+    return stream_queue(self, (StreamSegment){ .base = str.start, .offset = 0, .size = str.size });
+}
+
+/* @brief:  Flushes the writer, frees its buffers and closes the file if the
+ *          writer opened it
+ * @param:  void* writer - pointer to the StreamWriter */
+void stream_writer_close(void* writer) {
+    StreamWriter* self = writer;
+    if(self == NULL) return;
+    if(self->segments != NULL && self->nsegments > 0) stream_flush(self);
+    if(self->owns_fd && self->fd >= 0) close(self->fd);
+    free(self->segments);
+    dstring_delete(&self->staging);
+    *self = (StreamWriter){ .fd = -1 };
+}
+
+#endif
+#endif
@@ -0,0 +1,105 @@
+/*******************************************************************************
+* Name:             csl-strfixed.h                                             *
+* Description:      Fixed capacity strings stored inline, generated per size   *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   STRING_FIXED(N) is a struct holding a 32 bit length and N  *
+*                   bytes of data, with no pointer. It can live in arrays,     *
+*                   structs and hash table slots directly, so reading one      *
+*                   never chases a pointer and creating one never allocates.   *
+*                   The types are generated with the csl-templates.h GENERATE  *
+*                   machinery. Every generated type has the same field names,  *
+*                   so the generic operations are plain macros that work on    *
+*                   any size (the capacity is sizeof the data member).         *
+* Usage:            Generate the sizes you need once, at file scope:           *
+*                                                                              *
+*                   #define TEMPLATE STRING_FIXED_TEMPLATE                     *
+*                   GENERATE(16, 32)                                           *
+*                   #undef TEMPLATE                                            *
+*                                                                              *
+*                   STRING_FIXED(32) key;                                      *
+*                   key = UNWRAP(string_fixed_from(32, name), return 1);       *
+*                   string_fixed_append(&key, suffix);   // WRESULT(size_t)    *
+*                   string_hash(string_fixed_as_string(&key));                 *
+*                                                                              *
+*                   - Appending past the capacity fails with WRESULT_ERR and   *
+*                       leaves the string unchanged. Nothing is truncated.     *
+*                   - Like DString, the data is not null terminated.           *
+*                   - The result type of STRING_FIXED(N) is spelled            *
+*                       WRESULT(StringFixedN), e.g. WRESULT(StringFixed32).    *
+*******************************************************************************/
+
+#ifndef __CSL_STRFIXED_H
+#define __CSL_STRFIXED_H
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+#include "csl-templates.h"
+
+#define STRING_FIXED(N) StringFixed##N
+
+/* Template for GENERATE: defines STRING_FIXED(N), its result type and
+ * string_fixedN_from */
+#define STRING_FIXED_TEMPLATE(N)                                                \
+    static_assert((N) > 0 && (N) <= UINT32_MAX, "STRING_FIXED size must fit in 32 bits"); \
+    typedef struct {                                                            \
+        uint32_t size;                                                          \
+        char data[N];                                                           \
+    } StringFixed##N;                                                           \
+    DERIVE_WRESULT(StringFixed##N);                                             \
+    __attribute__((unused))                                                     \
+    static inline WRESULT(StringFixed##N) string_fixed##N##_from(String str) {  \
+        StringFixed##N self = {0};                                              \
+        if(str.size > (N)) return WRESULT_ERR(StringFixed##N, self);            \
+        if(str.size != 0) memcpy(self.data, str.start, str.size);               \
+        self.size = (uint32_t)str.size;                                         \
+        return WRESULT_OK(StringFixed##N, self);                                \
+    }
+
+/* @brief:  Copies a slice into a new STRING_FIXED(N)
+ * @param:  N - capacity (must have been generated)
+ * @param:  String str - bytes to copy
+ * @return: WRESULT(StringFixedN) - error if str is longer than N */
+#define string_fixed_from(N, str) string_fixed##N##_from(str)
+
+/* @brief:  Views a fixed string as a String slice, so every String function
+ *          works on it. The slice points into the fixed string itself
+ * @param:  self - pointer to any STRING_FIXED(N)
+ * @return: String - slice of the current contents */
+#define string_fixed_as_string(self) \
+    ((String){ .start = (self)->data, .size = (self)->size })
+
+/* @brief:  Gets the capacity in bytes of a fixed string
+ * @param:  self - pointer to any STRING_FIXED(N)
+ * @return: size_t - N */
+#define string_fixed_capacity(self) sizeof((self)->data)
+
+/* @brief:  Appends a slice, failing instead of growing
+ * @param:  self - pointer to any STRING_FIXED(N)
+ * @param:  String str - slice to append (must not point into self)
+ * @return: WRESULT(size_t) - new size, or error (and unchanged) if it would
+ *          not fit */
+#define string_fixed_append(self, str) ({                                       \
+        typeof(self) string_fixed_self = (self);                                \
+        _string_fixed_append(string_fixed_self->data, &string_fixed_self->size, \
+            sizeof(string_fixed_self->data), (str));                            \
+    })
+
+/* @brief:  Empties a fixed string
+ * @param:  self - pointer to any STRING_FIXED(N) */
+#define string_fixed_clear(self) ((void)((self)->size = 0))
+
+__attribute__((unused))
+static inline WRESULT(size_t) _string_fixed_append(char* data, uint32_t* size, size_t capacity, String str) {
+    if(str.size > capacity - *size) return WRESULT_ERR(size_t, *size);
+    if(str.size != 0) memcpy(data + *size, str.start, str.size);
+    *size += (uint32_t)str.size;
+    return WRESULT_OK(size_t, *size);
+}
+
+#endif
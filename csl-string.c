@@ -25,13 +25,26 @@
 *                   WRESULT(type) functions see errval.h                        *
 *******************************************************************************/
 
+#ifndef __CSL_STRING_C
+#define __CSL_STRING_C
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "csl-errval.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define STRING_X86
+#endif
+
 #define STRING_END UINT64_MAX
 
 /* Dynamic String type: Made up of start and end pointer to string content. 
@@ -52,10 +65,14 @@ typedef struct {
 // Setup our error value checking
 DERIVE_WRESULT(char);
 DERIVE_WRESULT(DString);
-DERIVE_WRESULT(String);
+DERIVE_WRESULT_COMPACT(String);
 DERIVE_WRESULT(size_t);
 DERIVE_WRESULT(bool);
 
+/* Unicode scalar value */
+typedef uint32_t Codepoint;
+DERIVE_WRESULT(Codepoint, STRING_UTF8_END, STRING_UTF8_INVALID);
+
 #define STRFMT(S) (S).size, (S).start
 
 void dstring_delete(DString* self);
@@ -64,8 +81,27 @@ WRESULT(size_t) dstring_stripsuff(DString* self, unsigned long index);
 WRESULT(size_t) dstring_strippref(DString* self, unsigned long index);
 WRESULT(size_t) dstring_prepend(DString* self, const char* str);
 WRESULT(size_t) dstring_append(DString* self, const char* str);
+WRESULT(size_t) dstring_append_slice(DString* self, String str);
+WRESULT(size_t) dstring_reserve(DString* self, size_t additional);
 size_t dstring_get_size(DString self);
 WRESULT(String) dstring_get_slice(DString self, size_t lower, size_t upper);
+int string_compare(String a, String b);
+uint64_t string_hash(String self);
+uint64_t string_hash_seeded(String self, uint64_t seed);
+uint64_t string_hash_random_seed(void);
+bool string_utf8_validate(String self);
+size_t string_utf8_count(String self);
+WRESULT(Codepoint) string_utf8_next(String self, size_t* offset);
+WRESULT(String) string_map_file(const char* path);
+void string_unmap_file(void* mapping);
+void dstring_to_lower(DString* self);
+void dstring_to_upper(DString* self);
+WRESULT(DString) string_to_lower(String self);
+WRESULT(DString) string_to_upper(String self);
+void dstring_translate(DString* self, const uint8_t table[256]);
+WRESULT(DString) string_translate(String self, const uint8_t table[256]);
+WRESULT(size_t) dstring_replace_all(DString* self, String from, String to);
+WRESULT(size_t) dstring_trim(DString* self, String set);
 
 #if !defined(CSL_STRING_INTERFACE)
 
@@ -82,6 +118,18 @@ WRESULT(String) dstring_get_slice(DString self, size_t lower, size_t upper) {
     return WRESULT_OK(String, success);
 }
 
+/* @brief:  Compares two slices byte by byte (as unsigned bytes). A slice that
+ *          is a prefix of the other sorts first
+ * @param:  String a - first slice
+ * @param:  String b - second slice
+ * @return: int - negative, 0 or positive, like memcmp */
+int string_compare(String a, String b) {
+    size_t n = a.size < b.size ? a.size : b.size;
+    int result = n == 0 ? 0 : memcmp(a.start, b.start, n);
+    if(result != 0) return result;
+    return (a.size > b.size) - (a.size < b.size);
+}
+
 /* @brief:  Gets the current length of the dynamic string
  * @param:  String to get size of
  * @return: WRESULT(size_t) - on success returns the size */
@@ -94,15 +142,45 @@ size_t dstring_get_size(DString self) {
  * @param:  const char* str - string literal to append
  * @return: WRESULT(size_t)  - new size of string */
 WRESULT(size_t) dstring_append(DString* self, const char* str) {
-    size_t str_len = strlen(str);
+    if(self == NULL || str == NULL) return WRESULT_ERR(size_t, 0);
+    return dstring_append_slice(self, (String){ .start = (char*)str, .size = strlen(str) });
+}
+
+/* @brief:  Appends a string slice (does not need to be null terminated)
+ * @param:  dstring* self - reference to the dynamic string
+ * @param:  String str - slice to append (must not point into self)
+ * @return: WRESULT(size_t)  - new size of string */
+WRESULT(size_t) dstring_append_slice(DString* self, String str) {
     if(self == NULL) return WRESULT_ERR(size_t, 0);
-        // Make temporary variables on stack to store old values
-        size_t current_size = self->s.size;
-        self->s.start = (char*)realloc(self->s.start, current_size + str_len);
-        // Copy the new string to the end
-        memcpy(&self->s.start[current_size], str, str_len);
-        self->s.size += str_len;
-        return WRESULT_OK(size_t, (size_t)(self->s.size));
+#ifdef DSTRING_VALIDATE_UTF8
+    if(!string_utf8_validate(str)) return WRESULT_ERR(size_t, self->s.size);
+#endif
+    UNWRAP(dstring_reserve(self, str.size), return WRESULT_ERR(size_t, self->s.size));
+    // Copy the new string to the end
+    if(str.size != 0) memcpy(&self->s.start[self->s.size], str.start, str.size);
+    self->s.size += str.size;
+    return WRESULT_OK(size_t, self->s.size);
+}
+
+/* @brief:  Makes sure there is space for at least `additional` more bytes after
+ *          the end of the string, growing the allocation geometrically. Bytes can
+ *          then be written directly at s.start + s.size
+ * @param:  dstring* self - reference to the dynamic string
+ * @param:  size_t additional - number of bytes that will be added
+ * @return: WRESULT(size_t) - the capacity after reserving */
+WRESULT(size_t) dstring_reserve(DString* self, size_t additional) {
+    if(self == NULL || self->s.size > SIZE_MAX - additional) return WRESULT_ERR(size_t, 0);
+    size_t needed = self->s.size + additional;
+    if(needed <= self->capacity && self->s.start != NULL) return WRESULT_OK(size_t, self->capacity);
+    size_t new_capacity = self->capacity < 16 ? 16 : self->capacity;
+    while(new_capacity < needed) {
+        new_capacity = new_capacity > SIZE_MAX / 2 ? needed : new_capacity * 2;
+    }
+    char* start = (char*)realloc(self->s.start, new_capacity);
+    if(start == NULL) return WRESULT_ERR(size_t, self->capacity);
+    self->s.start = start;
+    self->capacity = new_capacity;
+    return WRESULT_OK(size_t, new_capacity);
 }
 
 /* @brief:  Prepends the given dynamic string to a string literal
@@ -112,6 +190,10 @@ WRESULT(size_t) dstring_append(DString* self, const char* str) {
 WRESULT(size_t) dstring_prepend(DString* self, const char* str) {
     size_t str_len = strlen(str);
     if(self == NULL) return WRESULT_ERR(size_t, 0);
+#ifdef DSTRING_VALIDATE_UTF8
+    if(!string_utf8_validate((String){ .start = (char*)str, .size = str_len }))
+        return WRESULT_ERR(size_t, self->s.size);
+#endif
     size_t current_size = self->s.size;
     size_t new_size = current_size + str_len;
     self->s.start = (char*)realloc(self->s.start, new_size);
@@ -134,7 +216,7 @@ WRESULT(size_t) dstring_strippref(DString* self, size_t n) {
         self == NULL                    ||
         n > self->s.size                ||
         self->s.size > self->capacity
-    ) WRESULT_ERR(size_t, 0);
+    ) return WRESULT_ERR(size_t, 0);
 
     size_t new_size = self->s.size - n;
     memmove(self->s.start, self->s.start + n, new_size);
@@ -159,6 +241,8 @@ WRESULT(size_t) dstring_stripsuff(DString* self, size_t n) {
     size_t new_size = self->s.size - n;
     self->s.start = (char*)realloc(self->s.start, new_size);
     if(self->s.start == NULL) return WRESULT_ERR(size_t, 0);
+    self->s.size = new_size;
+    self->capacity = new_size;
     return WRESULT_OK(size_t, new_size);
 }
 
@@ -171,12 +255,16 @@ WRESULT(DString) dstring_new(const char* str) {
     DString fail = (DString){0}; 
     if(str == NULL) return WRESULT_ERR(DString, fail);
     size_t str_length = strlen(str);
+#ifdef DSTRING_VALIDATE_UTF8
+    if(!string_utf8_validate((String){ .start = (char*)str, .size = str_length }))
+        return WRESULT_ERR(DString, fail);
+#endif
     size_t alloc_size = str_length * sizeof(char) * 1.5;
     if(str_length > UINT8_MAX || alloc_size > UINT8_MAX) return WRESULT_ERR(DString, fail);
     char* string = (char*)malloc(alloc_size); 
     if(string == NULL) return WRESULT_ERR(DString, fail);
-    // Copy the string into the allocated space 
-    strcpy(string, str);
+    // Copy the string into the allocated space (no terminator, the size is stored)
+    memcpy(string, str, str_length);
     DString final_string = {
         .s = { .size = str_length, .start = string },
         .capacity = alloc_size
@@ -191,9 +279,682 @@ void dstring_delete(DString* self) {
     free(self->s.start);
 }
 
+/********************************** HASHING ***********************************/
+
+/* Hashing is wyhash (final v4) by Wang Yi: 64-bit multiply-mix over 8 byte
+ * words with the short (<= 16 byte) keys handled branch-light, since those are
+ * the common case for String keys. Not cryptographic. */
+static const uint64_t string_hash_secret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+static inline uint64_t string_hash_mix(uint64_t a, uint64_t b) {
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t string_hash_r8(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t string_hash_r4(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+/* @brief:  Hashes the contents of a string slice with a caller supplied seed.
+ *          Use a random seed (see string_hash_random_seed) for tables keyed on
+ *          untrusted input
+ * @param:  String self - slice to hash
+ * @param:  uint64_t seed - seed to mix into the hash
+ * @return: uint64_t - 64-bit hash */
+uint64_t string_hash_seeded(String self, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)self.start;
+    size_t len = self.size;
+    const uint64_t* secret = string_hash_secret;
+    uint64_t a, b;
+    seed ^= string_hash_mix(seed ^ secret[0], secret[1]);
+    if(__builtin_expect(len <= 16, 1)) {
+        if(len >= 4) {
+            a = (string_hash_r4(p) << 32) | string_hash_r4(p + ((len >> 3) << 2));
+            b = (string_hash_r4(p + len - 4) << 32) | string_hash_r4(p + len - 4 - ((len >> 3) << 2));
+        } else if(len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if(i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = string_hash_mix(string_hash_r8(p) ^ secret[1], string_hash_r8(p + 8) ^ seed);
+                see1 = string_hash_mix(string_hash_r8(p + 16) ^ secret[2], string_hash_r8(p + 24) ^ see1);
+                see2 = string_hash_mix(string_hash_r8(p + 32) ^ secret[3], string_hash_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16) {
+            seed = string_hash_mix(string_hash_r8(p) ^ secret[1], string_hash_r8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = string_hash_r8(p + i - 16);
+        b = string_hash_r8(p + i - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    __uint128_t r = (__uint128_t)a * b;
+    a = (uint64_t)r;
+    b = (uint64_t)(r >> 64);
+    return string_hash_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/* @brief:  Hashes the contents of a string slice with the default seed
+ * @param:  String self - slice to hash
+ * @return: uint64_t - 64-bit hash */
+uint64_t string_hash(String self) {
+    return string_hash_seeded(self, 0);
+}
+
+/* @brief:  Produces a per-process seed for string_hash_seeded. Mixes the clock
+ *          with stack and code addresses (ASLR), which is enough to stop
+ *          precomputed collision sets but is NOT a source of secure randomness
+ * @return: uint64_t - seed */
+uint64_t string_hash_random_seed(void) {
+    struct timespec ts = {0};
+    timespec_get(&ts, TIME_UTC);
+    uint64_t stack_addr = (uint64_t)(uintptr_t)&ts;
+    uint64_t code_addr = (uint64_t)(uintptr_t)&string_hash_random_seed;
+    uint64_t seed = string_hash_mix((uint64_t)ts.tv_nsec ^ string_hash_secret[0], (uint64_t)ts.tv_sec ^ stack_addr);
+    return string_hash_mix(seed ^ code_addr, string_hash_secret[2]);
+}
+
+/*********************************** UTF-8 ************************************/
+
+/* Decodes one UTF-8 sequence from p (at most n bytes). Returns the length of the
+ * sequence, or 0 if it is invalid (overlong, surrogate, > U+10FFFF, truncated) */
+static inline size_t string_utf8_decode(const uint8_t* p, size_t n, Codepoint* cp) {
+    uint8_t b = p[0];
+    if(b < 0x80) {
+        *cp = b;
+        return 1;
+    }
+    if(b < 0xC2) return 0;
+    if(b < 0xE0) {
+        if(n < 2 || (p[1] & 0xC0) != 0x80) return 0;
+        *cp = ((Codepoint)(b & 0x1F) << 6) | (p[1] & 0x3F);
+        return 2;
+    }
+    if(b < 0xF0) {
+        if(
+            n < 3                           ||
+            (p[1] & 0xC0) != 0x80           ||
+            (p[2] & 0xC0) != 0x80           ||
+            (b == 0xE0 && p[1] < 0xA0)      ||  // overlong
+            (b == 0xED && p[1] > 0x9F)          // surrogate
+        ) return 0;
+        *cp = ((Codepoint)(b & 0x0F) << 12) | ((Codepoint)(p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+        return 3;
+    }
+    if(b < 0xF5) {
+        if(
+            n < 4                           ||
+            (p[1] & 0xC0) != 0x80           ||
+            (p[2] & 0xC0) != 0x80           ||
+            (p[3] & 0xC0) != 0x80           ||
+            (b == 0xF0 && p[1] < 0x90)      ||  // overlong
+            (b == 0xF4 && p[1] > 0x8F)          // > U+10FFFF
+        ) return 0;
+        *cp = ((Codepoint)(b & 0x07) << 18) | ((Codepoint)(p[1] & 0x3F) << 12) |
+              ((Codepoint)(p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+        return 4;
+    }
+    return 0;
+}
+
+/* Byte at a time validation, skipping ASCII runs 16 (SSE2) or 8 bytes at a time */
+static bool string_utf8_validate_scalar(const uint8_t* p, size_t n) {
+    size_t i = 0;
+    while(i < n) {
+#ifdef STRING_X86
+        while(i + 16 <= n && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + i))) == 0) i += 16;
+#else
+        uint64_t word;
+        while(i + 8 <= n && (memcpy(&word, p + i, 8), (word & 0x8080808080808080ull) == 0)) i += 8;
+#endif
+        if(i >= n) break;
+        if(p[i] < 0x80) {
+            i++;
+            continue;
+        }
+        Codepoint cp;
+        size_t len = string_utf8_decode(p + i, n - i, &cp);
+        if(len == 0) return false;
+        i += len;
+    }
+    return true;
+}
+
+#ifdef STRING_X86
+/* Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"
+ * (the lookup algorithm used by simdjson). Each byte is classified by the high
+ * nibble of the previous byte, the low nibble of the previous byte and the high
+ * nibble of the current byte through three 16 entry tables; ANDing the three
+ * lookups leaves a bit set only for the error classes all three agree on. The
+ * 3rd/4th byte continuation requirements are then checked separately. */
+#define UTF8_TOO_SHORT      (1 << 0)
+#define UTF8_TOO_LONG       (1 << 1)
+#define UTF8_OVERLONG_3     (1 << 2)
+#define UTF8_TOO_LARGE      (1 << 3)
+#define UTF8_SURROGATE      (1 << 4)
+#define UTF8_OVERLONG_2     (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4     (1 << 6)
+#define UTF8_TWO_CONTS      (1 << 7)
+#define UTF8_CARRY          (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+__attribute__((target("avx2")))
+static inline __m256i string_utf8_prev(__m256i input, __m256i prev_input, const int n) {
+    __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    switch(n) {
+        case 1: return _mm256_alignr_epi8(input, shifted, 16 - 1);
+        case 2: return _mm256_alignr_epi8(input, shifted, 16 - 2);
+        default: return _mm256_alignr_epi8(input, shifted, 16 - 3);
+    }
+}
+
+__attribute__((target("avx2")))
+static bool string_utf8_validate_avx2(const uint8_t* p, size_t n) {
+    const __m256i byte_1_high_tbl = _mm256_setr_epi8(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+    );
+    const __m256i byte_1_low_tbl = _mm256_setr_epi8(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+    );
+    const __m256i byte_2_high_tbl = _mm256_setr_epi8(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+    );
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    /* Any of the last three bytes starting a sequence that runs past the block */
+    const __m256i max_value = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1)
+    );
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    uint8_t tail[32];
+    for(size_t i = 0; i < n; i += 32) {
+        __m256i input;
+        if(i + 32 <= n) {
+            input = _mm256_loadu_si256((const __m256i*)(p + i));
+        } else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, p + i, n - i);
+            input = _mm256_loadu_si256((const __m256i*)tail);
+        }
+        if(_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+        } else {
+            __m256i prev1 = string_utf8_prev(input, prev_input, 1);
+            __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_tbl,
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+            __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_tbl, _mm256_and_si256(prev1, nibble));
+            __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_tbl,
+                _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+            __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+            /* Bytes 2 and 3 after a 3 or 4 byte lead must be continuations */
+            __m256i prev2 = string_utf8_prev(input, prev_input, 2);
+            __m256i prev3 = string_utf8_prev(input, prev_input, 3);
+            __m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+            __m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+            __m256i must23 = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth), _mm256_set1_epi8((char)0x80));
+            error = _mm256_or_si256(error, _mm256_xor_si256(must23, special));
+            prev_incomplete = _mm256_subs_epu8(input, max_value);
+        }
+        prev_input = input;
+    }
+    error = _mm256_or_si256(error, prev_incomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+#undef UTF8_TOO_SHORT
+#undef UTF8_TOO_LONG
+#undef UTF8_OVERLONG_3
+#undef UTF8_TOO_LARGE
+#undef UTF8_SURROGATE
+#undef UTF8_OVERLONG_2
+#undef UTF8_TOO_LARGE_1000
+#undef UTF8_OVERLONG_4
+#undef UTF8_TWO_CONTS
+#undef UTF8_CARRY
+#endif
+
+/* @brief:  Checks that a string slice is well formed UTF-8 (no overlong forms,
+ *          surrogates or code points past U+10FFFF). Uses AVX2 when the CPU
+ *          supports it
+ * @param:  String self - slice to validate
+ * @return: bool - true if valid */
+bool string_utf8_validate(String self) {
+    const uint8_t* p = (const uint8_t*)self.start;
+#ifdef STRING_X86
+    /* Short strings are not worth the setup of the vector tables */
+    if(self.size >= 64 && __builtin_cpu_supports("avx2")) return string_utf8_validate_avx2(p, self.size);
+#endif
+    return string_utf8_validate_scalar(p, self.size);
+}
+
+/* @brief:  Counts the code points in a string slice. Only meaningful for valid
+ *          UTF-8 (every byte that is not a continuation byte is counted)
+ * @param:  String self - slice to count
+ * @return: size_t - number of code points */
+size_t string_utf8_count(String self) {
+    const uint8_t* p = (const uint8_t*)self.start;
+    size_t n = self.size;
+    size_t count = 0;
+    size_t i = 0;
+#ifdef STRING_X86
+    /* Continuation bytes are 0x80-0xBF, i.e. < -64 as signed bytes */
+    const __m128i threshold = _mm_set1_epi8(-65);
+    while(i + 16 <= n) {
+        /* Accumulate at most 255 blocks per byte lane before flushing with psadbw */
+        size_t blocks = (n - i) / 16;
+        if(blocks > 255) blocks = 255;
+        __m128i acc = _mm_setzero_si128();
+        for(size_t b = 0; b < blocks; b++, i += 16) {
+            __m128i input = _mm_loadu_si128((const __m128i*)(p + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(input, threshold));
+        }
+        __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+        count += (size_t)_mm_cvtsi128_si64(sums) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+#endif
+    for(; i < n; i++) count += (p[i] & 0xC0) != 0x80;
+    return count;
+}
+
+/* @brief:  Decodes the code point starting at *offset and advances *offset past it.
+ *          On an invalid sequence *offset advances by one byte so the caller can
+ *          resynchronize
+ *          ex: `for(size_t i = 0; !(cp = string_utf8_next(s, &i)).err;)`
+ * @param:  String self - slice to decode from
+ * @param:  size_t* offset - byte offset of the sequence to decode
+ * @return: WRESULT(Codepoint) - the code point. Errors with STRING_UTF8_END at the
+ *          end of the slice, STRING_UTF8_INVALID (value U+FFFD) on bad input */
+WRESULT(Codepoint) string_utf8_next(String self, size_t* offset) {
+    if(offset == NULL || *offset >= self.size)
+        return WRESULT_ERR_CODED(Codepoint, 0, STRING_UTF8_END);
+    Codepoint cp = 0;
+    size_t len = string_utf8_decode((const uint8_t*)self.start + *offset, self.size - *offset, &cp);
+    if(len == 0) {
+        (*offset)++;
+        return WRESULT_ERR_CODED(Codepoint, 0xFFFD, STRING_UTF8_INVALID);
+    }
+    *offset += len;
+    return WRESULT_OK(Codepoint, cp);
+}
+
+/****************************** MEMORY MAPPED FILES ***************************/
+
+/* @brief:  Maps a file into memory read-only and returns its contents as a
+ *          slice. The pages are loaded on demand straight from the page cache,
+ *          nothing is copied. The kernel is told the mapping will be read
+ *          sequentially and soon (read-ahead)
+ *          - Writing through the slice will segfault
+ *          - Release with string_unmap_file, which is a valid smrtptr_unique
+ *              destructor:
+ *          ex: `String file = UNWRAP(string_map_file("test.txt"), return 1);`
+ *              `smrtptr_unique(String) guard = smrtptr_make_unique(String, &file, string_unmap_file);`
+ * @param:  const char* path - path of the file to map
+ * @return: WRESULT(String) - the file contents (empty slice for an empty file) */
+WRESULT(String) string_map_file(const char* path) {
+    String fail = (String){0};
+    if(path == NULL) return WRESULT_ERR(String, fail);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return WRESULT_ERR(String, fail);
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return WRESULT_ERR(String, fail);
+    }
+    /* mmap rejects a length of 0 */
+    if(st.st_size == 0) {
+        close(fd);
+        return WRESULT_OK(String, fail);
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping holds its own reference to the file
+    close(fd);
+    if(map == MAP_FAILED) return WRESULT_ERR(String, fail);
+    /* Hints only, failure is harmless */
+    madvise(map, size, MADV_SEQUENTIAL);
+    madvise(map, size, MADV_WILLNEED);
+    String mapping = { .start = map, .size = size };
+    return WRESULT_OK(String, mapping);
+}
+
+/* @brief:  Unmaps a slice returned by string_map_file and empties it. Takes a
+ *          void* so it can be used as a smrtptr/cleanup destructor
+ * @param:  void* mapping - pointer to the String holding the mapping */
+void string_unmap_file(void* mapping) {
+    String* self = mapping;
+    if(self == NULL) return;
+    if(self->start != NULL && self->size != 0) munmap(self->start, self->size);
+    *self = (String){0};
+}
+
+/******************************** TRANSFORMS **********************************/
+
+/* Flips the case of every byte in [first, first + 25] (first is 'A' to lower
+ * case, 'a' to upper case). Bytes are in range when (byte - first) as an
+ * unsigned byte is at most 25, which is min_epu8(x, 25) == x */
+#ifdef STRING_X86
+__attribute__((target("avx2")))
+static size_t string_case_avx2(uint8_t* dst, const uint8_t* src, size_t n, uint8_t first) {
+    const __m256i base = _mm256_set1_epi8((char)first);
+    const __m256i span = _mm256_set1_epi8(25);
+    const __m256i flip = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i x = _mm256_sub_epi8(v, base);
+        __m256i in = _mm256_cmpeq_epi8(_mm256_min_epu8(x, span), x);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, _mm256_and_si256(in, flip)));
+    }
+    return i;
+}
+
+static size_t string_case_sse2(uint8_t* dst, const uint8_t* src, size_t n, uint8_t first) {
+    const __m128i base = _mm_set1_epi8((char)first);
+    const __m128i span = _mm_set1_epi8(25);
+    const __m128i flip = _mm_set1_epi8(0x20);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i x = _mm_sub_epi8(v, base);
+        __m128i in = _mm_cmpeq_epi8(_mm_min_epu8(x, span), x);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, _mm_and_si128(in, flip)));
+    }
+    return i;
+}
+#endif
+
+static void string_case(uint8_t* dst, const uint8_t* src, size_t n, uint8_t first) {
+    size_t i = 0;
+#ifdef STRING_X86
+    if(n >= 64 && __builtin_cpu_supports("avx2")) i = string_case_avx2(dst, src, n, first);
+    i += string_case_sse2(dst + i, src + i, n - i, first);
+#endif
+    for(; i < n; i++) dst[i] = src[i] ^ (((uint8_t)(src[i] - first) <= 25) << 5);
+}
+
+/* @brief:  Converts the ASCII letters of the string to lower case in place
+ *          (other bytes, including UTF-8 sequences, are left alone)
+ * @param:  DString* self - reference to the dynamic string */
+void dstring_to_lower(DString* self) {
+    string_case((uint8_t*)self->s.start, (const uint8_t*)self->s.start, self->s.size, 'A');
+}
+
+/* @brief:  Converts the ASCII letters of the string to upper case in place
+ * @param:  DString* self - reference to the dynamic string */
+void dstring_to_upper(DString* self) {
+    string_case((uint8_t*)self->s.start, (const uint8_t*)self->s.start, self->s.size, 'a');
+}
+
+/* Allocates a DString with room for exactly size bytes (at least 16) */
+static bool string_copy_buffer(DString* out, size_t size) {
+    *out = (DString){0};
+    return !dstring_reserve(out, size).err;
+}
+
+/* @brief:  Copies a slice with its ASCII letters converted to lower case
+ * @param:  String self - slice to convert
+ * @return: WRESULT(DString) - the converted copy */
+WRESULT(DString) string_to_lower(String self) {
+    DString out;
+    if(!string_copy_buffer(&out, self.size)) return WRESULT_ERR(DString, out);
+    string_case((uint8_t*)out.s.start, (const uint8_t*)self.start, self.size, 'A');
+    out.s.size = self.size;
+    return WRESULT_OK(DString, out);
+}
+
+/* @brief:  Copies a slice with its ASCII letters converted to upper case
+ * @param:  String self - slice to convert
+ * @return: WRESULT(DString) - the converted copy */
+WRESULT(DString) string_to_upper(String self) {
+    DString out;
+    if(!string_copy_buffer(&out, self.size)) return WRESULT_ERR(DString, out);
+    string_case((uint8_t*)out.s.start, (const uint8_t*)self.start, self.size, 'a');
+    out.s.size = self.size;
+    return WRESULT_OK(DString, out);
+}
+
+/* Maps every byte through table. The AVX2 kernel splits the table into 16
+ * rows of 16 (one per high nibble) and looks up the low nibble in every row
+ * with vpshufb, keeping the lanes whose high nibble selects that row */
+#ifdef STRING_X86
+__attribute__((target("avx2")))
+static size_t string_translate_avx2(uint8_t* dst, const uint8_t* src, size_t n, const uint8_t table[256]) {
+    __m256i rows[16];
+    for(int r = 0; r < 16; r++) {
+        rows[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(table + r * 16)));
+    }
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i lo = _mm256_and_si256(v, nibble);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+        __m256i out = _mm256_setzero_si256();
+        for(int r = 0; r < 16; r++) {
+            __m256i select = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8((char)r));
+            out = _mm256_or_si256(out, _mm256_and_si256(_mm256_shuffle_epi8(rows[r], lo), select));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), out);
+    }
+    return i;
+}
+#endif
+
+static void string_translate_bytes(uint8_t* dst, const uint8_t* src, size_t n, const uint8_t table[256]) {
+    size_t i = 0;
+#ifdef STRING_X86
+    if(n >= 64 && __builtin_cpu_supports("avx2")) i = string_translate_avx2(dst, src, n, table);
+#endif
+    for(; i < n; i++) dst[i] = table[src[i]];
+}
+
+/* @brief:  Replaces every byte b of the string with table[b], in place
+ * @param:  DString* self - reference to the dynamic string
+ * @param:  const uint8_t table[256] - replacement for each byte value */
+void dstring_translate(DString* self, const uint8_t table[256]) {
+    string_translate_bytes((uint8_t*)self->s.start, (const uint8_t*)self->s.start, self->s.size, table);
+}
+
+/* @brief:  Copies a slice with every byte b replaced by table[b]
+ * @param:  String self - slice to translate
+ * @param:  const uint8_t table[256] - replacement for each byte value
+ * @return: WRESULT(DString) - the translated copy */
+WRESULT(DString) string_translate(String self, const uint8_t table[256]) {
+    DString out;
+    if(!string_copy_buffer(&out, self.size)) return WRESULT_ERR(DString, out);
+    string_translate_bytes((uint8_t*)out.s.start, (const uint8_t*)self.start, self.size, table);
+    out.s.size = self.size;
+    return WRESULT_OK(DString, out);
+}
+
+/* Offset of the first occurrence of needle in hay at or after from, SIZE_MAX
+ * if there is none. Candidates are positions where both the first and the
+ * last byte of the needle match, found 16 at a time, then checked with memcmp */
+static size_t string_search(String hay, size_t from, String needle) {
+    const uint8_t* h = (const uint8_t*)hay.start;
+    const uint8_t* nd = (const uint8_t*)needle.start;
+    const size_t k = needle.size;
+    if(k == 0 || hay.size < k || from > hay.size - k) return SIZE_MAX;
+    if(k == 1) {
+        const uint8_t* hit = memchr(h + from, nd[0], hay.size - from);
+        return hit == NULL ? SIZE_MAX : (size_t)(hit - h);
+    }
+    const size_t last = hay.size - k;   // last valid start
+    size_t i = from;
+#ifdef STRING_X86
+    const __m128i first_byte = _mm_set1_epi8((char)nd[0]);
+    const __m128i last_byte = _mm_set1_epi8((char)nd[k - 1]);
+    for(; i + 16 <= last + 1; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(h + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(h + i + k - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(a, first_byte),
+            _mm_cmpeq_epi8(b, last_byte)
+        ));
+        while(mask != 0) {
+            size_t at = i + __builtin_ctz(mask);
+            if(memcmp(h + at + 1, nd + 1, k - 2) == 0) return at;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for(; i <= last; i++) {
+        if(h[i] == nd[0] && h[i + k - 1] == nd[k - 1] && memcmp(h + i + 1, nd + 1, k - 2) == 0) return i;
+    }
+    return SIZE_MAX;
+}
+
+/* @brief:  Replaces every (non overlapping, left to right) occurrence of from
+ *          with to. The occurrences are counted first, so the result is built
+ *          in place when it does not grow, and with a single allocation of the
+ *          exact size when it does
+ * @param:  DString* self - reference to the dynamic string
+ * @param:  String from - bytes to replace (must not be empty)
+ * @param:  String to - replacement (may be empty, must not point into self)
+ * @return: WRESULT(size_t) - new size of string */
+WRESULT(size_t) dstring_replace_all(DString* self, String from, String to) {
+    if(self == NULL) return WRESULT_ERR(size_t, 0);
+    if(from.size == 0) return WRESULT_ERR(size_t, self->s.size);
+    size_t count = 0;
+    for(size_t at = string_search(self->s, 0, from); at != SIZE_MAX; at = string_search(self->s, at + from.size, from)) {
+        count++;
+    }
+    if(count == 0) return WRESULT_OK(size_t, self->s.size);
+    if(to.size > from.size && count > (SIZE_MAX - self->s.size) / (to.size - from.size)) {
+        return WRESULT_ERR(size_t, self->s.size);
+    }
+    size_t new_size = self->s.size - count * from.size + count * to.size;
+
+    char* src = self->s.start;
+    char* dst = src;
+    if(to.size > from.size) {
+        dst = malloc(new_size);
+        if(dst == NULL) return WRESULT_ERR(size_t, self->s.size);
+    }
+    /* When shrinking in place the write cursor never passes the read cursor */
+    size_t read = 0, write = 0;
+    for(size_t at = string_search(self->s, 0, from); at != SIZE_MAX; at = string_search(self->s, read, from)) {
+        memmove(dst + write, src + read, at - read);
+        write += at - read;
+        if(to.size != 0) memcpy(dst + write, to.start, to.size);
+        write += to.size;
+        read = at + from.size;
+    }
+    memmove(dst + write, src + read, self->s.size - read);
+    if(dst != src) {
+        free(src);
+        self->s.start = dst;
+        self->capacity = new_size;
+    }
+    self->s.size = new_size;
+    return WRESULT_OK(size_t, new_size);
+}
+
+/* @brief:  Removes every leading and trailing byte that appears in set
+ *          ex: `dstring_trim(&line, (String){ .start = " \t\r\n", .size = 4 })`
+ * @param:  DString* self - reference to the dynamic string
+ * @param:  String set - the bytes to strip
+ * @return: WRESULT(size_t) - new size of string */
+WRESULT(size_t) dstring_trim(DString* self, String set) {
+    if(self == NULL) return WRESULT_ERR(size_t, 0);
+    bool strip[256] = {0};
+    for(size_t i = 0; i < set.size; i++) strip[(uint8_t)set.start[i]] = true;
+    const uint8_t* p = (const uint8_t*)self->s.start;
+    size_t begin = 0, end = self->s.size;
+    while(begin < end && strip[p[begin]]) begin++;
+    while(end > begin && strip[p[end - 1]]) end--;
+    if(begin != 0) memmove(self->s.start, self->s.start + begin, end - begin);
+    self->s.size = end - begin;
+    return WRESULT_OK(size_t, self->s.size);
+}
+
 #else
 
 #if defined(STRING_USE_VTABLE)
 #endif
 
 #endif
+#endif
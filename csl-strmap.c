@@ -0,0 +1,247 @@
+/*******************************************************************************
+* Name:             csl-strmap.c                                               *
+* Description:      String keyed open-addressing hash map                      *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   Linear probing over three parallel arrays: the hashes,     *
+*                   the keys and the values. The full 64-bit hash of every     *
+*                   key is stored, so probing only touches the key bytes       *
+*                   (memcmp) when the hashes already match, and growing the    *
+*                   table never rehashes a key. A stored hash of 0 marks an    *
+*                   empty slot. Removal uses backward shifting, so there are   *
+*                   no tombstones.                                             *
+* Usage:            Values are stored by copy and are any fixed size type.     *
+*                   Pass the value type to the macros:                         *
+*                                                                              *
+*                   StrMap map = UNWRAP(strmap_new(int, 16), return 1);        *
+*                   strmap_insert(int, &map, key, 10);                         *
+*                   int* value = strmap_get(int, &map, key);                   *
+*                   strmap_delete(&map);                                       *
+*                                                                              *
+*                   - Keys are copied in on insert, so the map owns them.      *
+*                   - Lookups take a String slice and never allocate.          *
+*                   - Pointers returned by strmap_get are invalidated by the   *
+*                       next insert or remove.                                 *
+*******************************************************************************/
+
+#ifndef __CSL_STRMAP_C
+#define __CSL_STRMAP_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+
+typedef struct {
+    uint64_t* hashes;
+    String* keys;
+    uint8_t* values;
+    size_t value_size;
+    size_t size;
+    size_t mask;        // capacity - 1 (capacity is always a power of 2)
+    uint64_t seed;
+} StrMap;
+
+DERIVE_WRESULT(StrMap);
+
+WRESULT(StrMap) _strmap_new(size_t value_size, size_t capacity);
+WRESULT(size_t) _strmap_insert(StrMap* self, String key, const void* value, size_t value_size);
+void* _strmap_get(const StrMap* self, String key);
+bool strmap_remove(StrMap* self, String key);
+bool strmap_next(const StrMap* self, size_t* iter, String* key, void** value);
+void strmap_delete(StrMap* self);
+
+#define strmap_new(T, capacity) _strmap_new(sizeof(T), capacity)
+#define strmap_insert(T, map, key, value) _strmap_insert(map, key, &(T){ value }, sizeof(T))
+#define strmap_get(T, map, key) ((T*)_strmap_get(map, key))
+
+#if !defined(CSL_STRMAP_INTERFACE)
+
+/* Maximum load is 3/4 */
+#define STRMAP_FULL(size, mask) ((size) + 1 > ((mask) + 1) / 4 * 3)
+
+static inline uint64_t strmap_hash(const StrMap* self, String key) {
+    uint64_t hash = string_hash_seeded(key, self->seed);
+    return hash == 0 ? 1 : hash;
+}
+
+/* @brief:  Allocates the slot arrays for a map
+ * @param:  size_t value_size - size in bytes of the stored value type
+ * @param:  size_t capacity - number of slots, rounded up to a power of 2
+ * @return: WRESULT(StrMap) - the new (empty) map */
+WRESULT(StrMap) _strmap_new(size_t value_size, size_t capacity) {
+    StrMap map = { .value_size = value_size, .seed = string_hash_random_seed() };
+    size_t slots = 8;
+    while(slots < capacity) slots <<= 1;
+    map.hashes = calloc(slots, sizeof(uint64_t));
+    map.keys = malloc(slots * sizeof(String));
+    map.values = malloc(slots * (value_size ? value_size : 1));
+    if(map.hashes == NULL || map.keys == NULL || map.values == NULL) {
+        strmap_delete(&map);
+        return WRESULT_ERR(StrMap, map);
+    }
+    map.mask = slots - 1;
+    return WRESULT_OK(StrMap, map);
+}
+
+/* Doubles the number of slots. Stored hashes are reused, keys are not rehashed */
+static bool strmap_grow(StrMap* self) {
+    size_t slots = (self->mask + 1) * 2;
+    size_t vsize = self->value_size;
+    uint64_t* hashes = calloc(slots, sizeof(uint64_t));
+    String* keys = malloc(slots * sizeof(String));
+    uint8_t* values = malloc(slots * (vsize ? vsize : 1));
+    if(hashes == NULL || keys == NULL || values == NULL) {
+        free(hashes);
+        free(keys);
+        free(values);
+        return false;
+    }
+    for(size_t i = 0; i <= self->mask; i++) {
+        uint64_t hash = self->hashes[i];
+        if(hash == 0) continue;
+        size_t j = hash & (slots - 1);
+        while(hashes[j] != 0) j = (j + 1) & (slots - 1);
+        hashes[j] = hash;
+        keys[j] = self->keys[i];
+        memcpy(values + j * vsize, self->values + i * vsize, vsize);
+    }
+    free(self->hashes);
+    free(self->keys);
+    free(self->values);
+    self->hashes = hashes;
+    self->keys = keys;
+    self->values = values;
+    self->mask = slots - 1;
+    return true;
+}
+
+/* Returns the slot holding key, or the empty slot where it would be inserted */
+static inline size_t strmap_probe(const StrMap* self, String key, uint64_t hash) {
+    size_t i = hash & self->mask;
+    for(;;) {
+        uint64_t h = self->hashes[i];
+        if(h == 0) return i;
+        if(
+            h == hash                           &&
+            self->keys[i].size == key.size      &&
+            memcmp(self->keys[i].start, key.start, key.size) == 0
+        ) return i;
+        i = (i + 1) & self->mask;
+    }
+}
+
+/* @brief:  Inserts a copy of value under key, replacing any existing value
+ * @param:  StrMap* self - reference to the map
+ * @param:  String key - key to insert (the bytes are copied)
+ * @param:  const void* value - pointer to the value to copy in
+ * @param:  size_t value_size - must match the size the map was created with
+ * @return: WRESULT(size_t) - number of entries in the map */
+WRESULT(size_t) _strmap_insert(StrMap* self, String key, const void* value, size_t value_size) {
+    if(
+        self == NULL                    ||
+        self->hashes == NULL            ||
+        value_size != self->value_size
+    ) return WRESULT_ERR(size_t, 0);
+    uint64_t hash = strmap_hash(self, key);
+    size_t i = strmap_probe(self, key, hash);
+    if(self->hashes[i] == 0) {
+        if(STRMAP_FULL(self->size, self->mask)) {
+            if(!strmap_grow(self)) return WRESULT_ERR(size_t, self->size);
+            i = strmap_probe(self, key, hash);
+        }
+        char* bytes = malloc(key.size ? key.size : 1);
+        if(bytes == NULL) return WRESULT_ERR(size_t, self->size);
+        memcpy(bytes, key.start, key.size);
+        self->hashes[i] = hash;
+        self->keys[i] = (String){ .start = bytes, .size = key.size };
+        self->size++;
+    }
+    memcpy(self->values + i * value_size, value, value_size);
+    return WRESULT_OK(size_t, self->size);
+}
+
+/* @brief:  Looks up the value stored under key
+ * @param:  const StrMap* self - reference to the map
+ * @param:  String key - slice to look up (does not need to be null terminated)
+ * @return: void* - pointer to the stored value, NULL if key is not present */
+void* _strmap_get(const StrMap* self, String key) {
+    if(self == NULL || self->hashes == NULL) return NULL;
+    size_t i = strmap_probe(self, key, strmap_hash(self, key));
+    if(self->hashes[i] == 0) return NULL;
+    return self->values + i * self->value_size;
+}
+
+/* @brief:  Removes key and its value from the map
+ * @param:  StrMap* self - reference to the map
+ * @param:  String key - key to remove
+ * @return: bool - true if the key was present */
+bool strmap_remove(StrMap* self, String key) {
+    if(self == NULL || self->hashes == NULL) return false;
+    size_t i = strmap_probe(self, key, strmap_hash(self, key));
+    if(self->hashes[i] == 0) return false;
+    free(self->keys[i].start);
+    /* Shift back any following entries that would no longer be reachable
+     * across the hole */
+    size_t hole = i;
+    size_t j = i;
+    for(;;) {
+        j = (j + 1) & self->mask;
+        uint64_t h = self->hashes[j];
+        if(h == 0) break;
+        size_t home = h & self->mask;
+        /* Entry at j may move to the hole if its home slot is not in (hole, j] */
+        if(((j - home) & self->mask) >= ((j - hole) & self->mask)) {
+            self->hashes[hole] = h;
+            self->keys[hole] = self->keys[j];
+            memcpy(self->values + hole * self->value_size, self->values + j * self->value_size, self->value_size);
+            hole = j;
+        }
+    }
+    self->hashes[hole] = 0;
+    self->size--;
+    return true;
+}
+
+/* @brief:  Iterates the entries of the map in slot order
+ *          ex: `for(size_t it = 0; strmap_next(&map, &it, &key, &value);)`
+ * @param:  const StrMap* self - reference to the map
+ * @param:  size_t* iter - iterator state, start at 0
+ * @param:  String* key - set to the key of the next entry
+ * @param:  void** value - set to a pointer to the value of the next entry
+ * @return: bool - false once there are no more entries */
+bool strmap_next(const StrMap* self, size_t* iter, String* key, void** value) {
+    if(self == NULL || self->hashes == NULL) return false;
+    for(size_t i = *iter; i <= self->mask; i++) {
+        if(self->hashes[i] == 0) continue;
+        if(key != NULL) *key = self->keys[i];
+        if(value != NULL) *value = self->values + i * self->value_size;
+        *iter = i + 1;
+        return true;
+    }
+    *iter = self->mask + 1;
+    return false;
+}
+
+/* @brief:  Frees the keys and slot arrays of the map
+ * @param:  StrMap* self - map to delete */
+void strmap_delete(StrMap* self) {
+    if(self->hashes != NULL) {
+        for(size_t i = 0; i <= self->mask; i++) {
+            if(self->hashes[i] != 0) free(self->keys[i].start);
+        }
+    }
+    free(self->hashes);
+    free(self->keys);
+    free(self->values);
+    *self = (StrMap){0};
+}
+
+#undef STRMAP_FULL
+
+#endif
+#endif
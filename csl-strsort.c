@@ -0,0 +1,316 @@
+/*******************************************************************************
+* Name:             csl-strsort.c                                              *
+* Description:      Sorting arrays of String slices                            *
+* By:               Nigel Sinclair                                             *
+* Github:           https://github.com/sincngraeme/                            *
+* Implementation:   string_sort is a multikey quicksort that caches 7 bytes    *
+*                   of every string (plus a length tag) in a parallel array of *
+*                   64-bit keys. Partitioning compares the cached keys only,   *
+*                   so the string bytes are read once per 7 bytes of depth     *
+*                   instead of once per comparison, and a shared prefix is     *
+*                   never compared twice. Strings whose keys tie are           *
+*                   partitioned again on the next 7 bytes.                     *
+*                   string_sort_stable is an MSD radix sort: one pass reads    *
+*                   the byte at the current depth of every string into a       *
+*                   cache, a counting pass and a scatter then work from that   *
+*                   cache. Both switch to insertion sort below 16 strings.     *
+*                   string_sort_parallel splits the input into buckets by      *
+*                   first byte and sorts the buckets on a pool of threads,     *
+*                   largest bucket first.                                      *
+* Usage:            String* keys = ...;                                        *
+*                   string_sort(keys, n);            // order of equal keys   *
+*                                                    // is unspecified        *
+*                   string_sort_stable(keys, n);     // equal keys keep order *
+*                   string_sort_parallel(keys, n, 0);// 0 = one per CPU       *
+*                                                                              *
+*                   - The order is the one from string_compare: unsigned       *
+*                       bytes, and a prefix sorts before the longer string.    *
+*                   - All three return false (leaving the array unchanged)     *
+*                       only if their scratch memory can not be allocated.     *
+*******************************************************************************/
+
+#ifndef __CSL_STRSORT_C
+#define __CSL_STRSORT_C
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifndef CSL_STRING_INTERFACE
+#define CSL_STRING_INTERFACE
+#endif
+#include "csl-string.c"
+
+bool string_sort(String* arr, size_t n);
+bool string_sort_stable(String* arr, size_t n);
+bool string_sort_parallel(String* arr, size_t n, size_t nthreads);
+
+#if !defined(CSL_STRSORT_INTERFACE)
+
+/* Below this many strings, insertion sort */
+#define STRSORT_INSERTION 16
+/* Below this many strings, string_sort_parallel does not start threads */
+#define STRSORT_PARALLEL_MIN (1 << 16)
+
+/* Compares two strings that are known to be equal in their first depth bytes */
+static inline int strsort_compare_from(String a, String b, size_t depth) {
+    return string_compare(
+        (String){ .start = a.start + depth, .size = a.size - depth },
+        (String){ .start = b.start + depth, .size = b.size - depth }
+    );
+}
+
+/* Stable: an element only moves past strictly greater ones */
+static void strsort_insertion(String* arr, size_t n, size_t depth) {
+    for(size_t i = 1; i < n; i++) {
+        String s = arr[i];
+        size_t j = i;
+        while(j > 0 && strsort_compare_from(arr[j - 1], s, depth) > 0) {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = s;
+    }
+}
+
+/* Bytes [depth, depth + 7) big endian in the top 56 bits (zero padded), and
+ * min(remaining length, 8) in the low byte. Comparing keys as integers then
+ * orders strings correctly even when they contain zero bytes: a string that
+ * ends inside the 7 bytes gets a smaller tag than a longer one with the same
+ * bytes, and two keys tagged 8 can only be told apart further on */
+static inline uint64_t strsort_key(String s, size_t depth) {
+    const uint8_t* p = (const uint8_t*)s.start + depth;
+    size_t rem = s.size - depth;
+    if(rem >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        return (__builtin_bswap64(word) & ~(uint64_t)0xFF) | 8;
+    }
+    uint64_t key = 0;
+    for(size_t i = 0; i < rem && i < 7; i++) key |= (uint64_t)p[i] << (56 - 8 * i);
+    return key | rem;
+}
+
+static inline uint64_t strsort_median3(uint64_t a, uint64_t b, uint64_t c) {
+    if(a < b) return b < c ? b : (a < c ? c : a);
+    return a < c ? a : (b < c ? c : b);
+}
+
+/* Multikey quicksort over arr, where keys[i] caches strsort_key(arr[i], depth)
+ * unless fill is set */
+static void strsort_mkqs(String* arr, uint64_t* keys, size_t n, size_t depth, bool fill) {
+    while(n >= STRSORT_INSERTION) {
+        if(fill) {
+            for(size_t i = 0; i < n; i++) keys[i] = strsort_key(arr[i], depth);
+            fill = false;
+        }
+        uint64_t pivot = strsort_median3(keys[0], keys[n / 2], keys[n - 1]);
+        /* Three way partition: [0, lt) < pivot, [lt, gt) == pivot, [gt, n) > pivot */
+        size_t lt = 0, i = 0, gt = n;
+        while(i < gt) {
+            uint64_t k = keys[i];
+            if(k < pivot) {
+                String s = arr[lt]; arr[lt] = arr[i]; arr[i] = s;
+                keys[i] = keys[lt]; keys[lt] = k;
+                lt++;
+                i++;
+            } else if(k > pivot) {
+                gt--;
+                String s = arr[gt]; arr[gt] = arr[i]; arr[i] = s;
+                keys[i] = keys[gt]; keys[gt] = k;
+            } else {
+                i++;
+            }
+        }
+        strsort_mkqs(arr, keys, lt, depth, false);
+        /* Equal keys with a tag below 8 are equal strings */
+        if((pivot & 0xFF) == 8) strsort_mkqs(arr + lt, keys + lt, gt - lt, depth + 7, true);
+        arr += gt;
+        keys += gt;
+        n -= gt;
+    }
+    strsort_insertion(arr, n, depth);
+}
+
+/* @brief:  Sorts an array of slices in place. The order of slices with equal
+ *          contents is unspecified
+ * @param:  String* arr - array to sort
+ * @param:  size_t n - number of slices
+ * @return: bool - false if the key cache could not be allocated (arr unchanged) */
+bool string_sort(String* arr, size_t n) {
+    if(n < STRSORT_INSERTION) {
+        strsort_insertion(arr, n, 0);
+        return true;
+    }
+    uint64_t* keys = malloc(n * sizeof(uint64_t));
+    if(keys == NULL) return false;
+    strsort_mkqs(arr, keys, n, 0, true);
+    free(keys);
+    return true;
+}
+
+/* MSD radix sort. cache holds the bucket of each string at depth: 0 if the
+ * string ends there, 1 + byte otherwise. Ended strings go first, keeping their
+ * order, and every pass is stable */
+static void strsort_radix(String* arr, String* tmp, uint16_t* cache, size_t n, size_t depth) {
+    size_t count[257];
+    for(;;) {
+        if(n < STRSORT_INSERTION) {
+            strsort_insertion(arr, n, depth);
+            return;
+        }
+        memset(count, 0, sizeof(count));
+        for(size_t i = 0; i < n; i++) {
+            uint16_t c = arr[i].size > depth ? 1 + (uint8_t)arr[i].start[depth] : 0;
+            cache[i] = c;
+            count[c]++;
+        }
+        /* Everything in one bucket: nothing to move, skip the whole common
+         * prefix instead of going one byte deeper at a time */
+        if(count[cache[0]] == n) {
+            if(cache[0] == 0) return;
+            size_t common = arr[0].size - depth;
+            for(size_t i = 1; i < n && common > 1; i++) {
+                size_t limit = arr[i].size - depth < common ? arr[i].size - depth : common;
+                size_t j = 1;
+                while(j < limit && arr[0].start[depth + j] == arr[i].start[depth + j]) j++;
+                common = j;
+            }
+            depth += common;
+            continue;
+        }
+        size_t start[257];
+        size_t sum = 0;
+        for(int c = 0; c < 257; c++) {
+            start[c] = sum;
+            sum += count[c];
+        }
+        size_t next[257];
+        memcpy(next, start, sizeof(next));
+        for(size_t i = 0; i < n; i++) tmp[next[cache[i]]++] = arr[i];
+        memcpy(arr, tmp, n * sizeof(String));
+        for(int c = 1; c < 257; c++) {
+            if(count[c] > 1) strsort_radix(arr + start[c], tmp, cache, count[c], depth + 1);
+        }
+        return;
+    }
+}
+
+/* @brief:  Sorts an array of slices in place, keeping slices with equal
+ *          contents in their original order
+ * @param:  String* arr - array to sort
+ * @param:  size_t n - number of slices
+ * @return: bool - false if the scratch buffers could not be allocated (arr
+ *          unchanged) */
+bool string_sort_stable(String* arr, size_t n) {
+    if(n < STRSORT_INSERTION) {
+        strsort_insertion(arr, n, 0);
+        return true;
+    }
+    String* tmp = malloc(n * sizeof(String));
+    uint16_t* cache = malloc(n * sizeof(uint16_t));
+    if(tmp == NULL || cache == NULL) {
+        free(tmp);
+        free(cache);
+        return false;
+    }
+    strsort_radix(arr, tmp, cache, n, 0);
+    free(tmp);
+    free(cache);
+    return true;
+}
+
+typedef struct {
+    String* arr;
+    uint64_t* keys;
+    size_t start[257];
+    size_t count[257];
+    uint16_t order[256];    // buckets 1..256, largest first
+    atomic_size_t next;
+} StrsortJobs;
+
+static void* strsort_worker(void* arg) {
+    StrsortJobs* jobs = arg;
+    for(;;) {
+        size_t j = atomic_fetch_add_explicit(&jobs->next, 1, memory_order_relaxed);
+        if(j >= 256) return NULL;
+        uint16_t c = jobs->order[j];
+        if(jobs->count[c] < 2) return NULL;
+        /* Every string in bucket c shares its first byte */
+        strsort_mkqs(jobs->arr + jobs->start[c], jobs->keys + jobs->start[c], jobs->count[c], 1, true);
+    }
+}
+
+/* @brief:  Sorts an array of slices in place using several threads. Small
+ *          inputs are sorted on the calling thread. The order of slices with
+ *          equal contents is unspecified
+ * @param:  String* arr - array to sort
+ * @param:  size_t n - number of slices
+ * @param:  size_t nthreads - number of threads to use, 0 for one per CPU
+ * @return: bool - false if the scratch buffers could not be allocated (arr
+ *          unchanged) */
+bool string_sort_parallel(String* arr, size_t n, size_t nthreads) {
+    if(nthreads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = cpus > 0 ? (size_t)cpus : 1;
+    }
+    if(n < STRSORT_PARALLEL_MIN || nthreads == 1) return string_sort(arr, n);
+
+    StrsortJobs* jobs = calloc(1, sizeof(StrsortJobs));
+    uint64_t* keys = malloc(n * sizeof(uint64_t));
+    String* tmp = malloc(n * sizeof(String));
+    if(jobs == NULL || keys == NULL || tmp == NULL) {
+        free(jobs);
+        free(keys);
+        free(tmp);
+        return false;
+    }
+    /* Bucket by first byte (bucket 0 holds the empty strings) */
+    for(size_t i = 0; i < n; i++) jobs->count[arr[i].size ? 1 + (uint8_t)arr[i].start[0] : 0]++;
+    size_t sum = 0;
+    for(int c = 0; c < 257; c++) {
+        jobs->start[c] = sum;
+        sum += jobs->count[c];
+    }
+    size_t next[257];
+    memcpy(next, jobs->start, sizeof(next));
+    for(size_t i = 0; i < n; i++) tmp[next[arr[i].size ? 1 + (uint8_t)arr[i].start[0] : 0]++] = arr[i];
+    memcpy(arr, tmp, n * sizeof(String));
+    free(tmp);
+
+    for(int c = 0; c < 256; c++) jobs->order[c] = (uint16_t)(c + 1);
+    for(int i = 1; i < 256; i++) {
+        uint16_t c = jobs->order[i];
+        int j = i;
+        while(j > 0 && jobs->count[jobs->order[j - 1]] < jobs->count[c]) {
+            jobs->order[j] = jobs->order[j - 1];
+            j--;
+        }
+        jobs->order[j] = c;
+    }
+    jobs->arr = arr;
+    jobs->keys = keys;
+    atomic_init(&jobs->next, 0);
+
+    if(nthreads > 256) nthreads = 256;
+    pthread_t threads[256];
+    size_t started = 0;
+    for(; started + 1 < nthreads; started++) {
+        if(pthread_create(&threads[started], NULL, strsort_worker, jobs) != 0) break;
+    }
+    /* The calling thread works too (and finishes alone if no thread started) */
+    strsort_worker(jobs);
+    for(size_t t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    free(keys);
+    free(jobs);
+    return true;
+}
+
+#undef STRSORT_INSERTION
+#undef STRSORT_PARALLEL_MIN
+
+#endif
+#endif
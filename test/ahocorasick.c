@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define CSL_STRING_INTERFACE
+#define CSL_AHOCORASICK_INTERFACE
+#include "../csl-ahocorasick.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_basic();
+void test_streaming();
+void test_stop();
+void test_against_naive();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_basic();
+    test_streaming();
+    test_stop();
+    test_against_naive();
+
+    return 0;
+}
+
+typedef struct {
+    size_t count;
+    size_t pattern[64];
+    size_t start[64];
+    uint64_t checksum;
+} Matches;
+
+static bool collect(void* ctx, size_t pattern, size_t start, size_t end) {
+    Matches* m = ctx;
+    (void)end;
+    if(m->count < 64) {
+        m->pattern[m->count] = pattern;
+        m->start[m->count] = start;
+    }
+    m->count++;
+    m->checksum += (pattern + 1) * 1000003 ^ start * 31 ^ end;
+    return true;
+}
+
+static bool has(const Matches* m, size_t pattern, size_t start) {
+    for(size_t i = 0; i < m->count && i < 64; i++) {
+        if(m->pattern[i] == pattern && m->start[i] == start) return true;
+    }
+    return false;
+}
+
+void test_basic() {
+    String patterns[] = { S("he"), S("she"), S("his"), S("hers") };
+    AhoCorasick ac = UNWRAP(ahocorasick_new(patterns, 4), {
+        CSL_TEST_ASSERT(false, "Failed to compile the patterns.");
+        return;
+    });
+    Matches m = {0};
+    size_t n = ahocorasick_find(&ac, S("ushers"), collect, &m);
+    CSL_TEST_ASSERT(n == 3 && m.count == 3, "Wrong number of matches.");
+    CSL_TEST_ASSERT(has(&m, 1, 1) && has(&m, 0, 2) && has(&m, 3, 2), "Overlapping matches missed.");
+    m = (Matches){0};
+    CSL_TEST_ASSERT(ahocorasick_find(&ac, S("nothing to see"), collect, &m) == 0, "Matched text without patterns.");
+    ahocorasick_delete(&ac);
+
+    String empty[] = { S("a"), S("") };
+    CSL_TEST_ASSERT(ahocorasick_new(empty, 2).err, "Empty pattern accepted.");
+    String dup[] = { S("ab"), S("ab") };
+    ac = UNWRAP(ahocorasick_new(dup, 2), return);
+    m = (Matches){0};
+    ahocorasick_find(&ac, S("xxab"), collect, &m);
+    CSL_TEST_ASSERT(m.count == 2 && has(&m, 0, 2) && has(&m, 1, 2), "Duplicate patterns not both reported.");
+    ahocorasick_delete(&ac);
+}
+
+void test_streaming() {
+    String patterns[] = { S("General Kenobi"), S("Kenobi"), S("There") };
+    AhoCorasick ac = UNWRAP(ahocorasick_new(patterns, 3), return);
+    const char text[] = "Hello There! ... General Kenobi!";
+    Matches whole = {0}, parts = {0};
+    ahocorasick_find(&ac, S(text), collect, &whole);
+    AhoCorasickState state = {0};
+    for(size_t i = 0; i < sizeof(text) - 1; i += 5) {
+        size_t len = sizeof(text) - 1 - i < 5 ? sizeof(text) - 1 - i : 5;
+        ahocorasick_feed(&ac, &state, (String){ .start = (char*)text + i, .size = len }, collect, &parts);
+    }
+    CSL_TEST_ASSERT(whole.count == 3 && has(&whole, 0, 17) && has(&whole, 1, 25), "Whole text matched incorrectly.");
+    CSL_TEST_ASSERT(parts.count == whole.count && parts.checksum == whole.checksum, "Chunked scan differs from a whole scan.");
+    CSL_TEST_ASSERT(state.offset == sizeof(text) - 1, "Stream offset is wrong.");
+    ahocorasick_delete(&ac);
+}
+
+static bool first_only(void* ctx, size_t pattern, size_t start, size_t end) {
+    (void)pattern; (void)end;
+    *(size_t*)ctx = start;
+    return false;
+}
+
+void test_stop() {
+    String patterns[] = { S("a") };
+    AhoCorasick ac = UNWRAP(ahocorasick_new(patterns, 1), return);
+    size_t where = 0;
+    AhoCorasickState state = {0};
+    size_t n = ahocorasick_feed(&ac, &state, S("xxaxa"), first_only, &where);
+    CSL_TEST_ASSERT(n == 1 && where == 2 && state.offset == 3, "Scan did not stop at the first match.");
+    ahocorasick_delete(&ac);
+}
+
+static uint64_t rng = 0x123456789ull;
+static uint64_t next() {
+    rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+    return rng;
+}
+
+/* Random patterns over small alphabets (lots of overlap), compared against a
+ * memcmp at every position. The wide alphabet exercises the SIMD prefilter */
+void test_against_naive() {
+    bool all = true;
+    for(int round = 0; round < 40; round++) {
+        int alphabet = round % 2 ? 3 : 200;
+        size_t npatterns = 1 + next() % 50;
+        String patterns[50];
+        char storage[50][8];
+        for(size_t p = 0; p < npatterns; p++) {
+            size_t len = 1 + next() % (round % 2 ? 4 : 3);
+            for(size_t i = 0; i < len; i++) storage[p][i] = (char)(32 + next() % alphabet);
+            patterns[p] = (String){ .start = storage[p], .size = len };
+        }
+        char text[4000];
+        for(size_t i = 0; i < sizeof(text); i++) text[i] = (char)(32 + next() % alphabet);
+        AhoCorasick ac = UNWRAP(ahocorasick_new(patterns, npatterns), { all = false; continue; });
+        Matches m = {0};
+        ahocorasick_find(&ac, (String){ .start = text, .size = sizeof(text) }, collect, &m);
+        Matches expected = {0};
+        for(size_t end = 1; end <= sizeof(text); end++) {
+            for(size_t p = 0; p < npatterns; p++) {
+                size_t len = patterns[p].size;
+                if(len <= end && memcmp(text + end - len, patterns[p].start, len) == 0) {
+                    collect(&expected, p, end - len, end);
+                }
+            }
+        }
+        all &= m.count == expected.count && m.checksum == expected.checksum;
+        ahocorasick_delete(&ac);
+    }
+    CSL_TEST_ASSERT(all, "Matches differ from a naive search.");
+}
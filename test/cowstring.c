@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#define CSL_STRING_INTERFACE
+#define CSL_COWSTRING_INTERFACE
+#include "../csl-cowstring.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_copy_shares();
+void test_mutation_unshares();
+void test_strip_reuse();
+void test_threads();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_copy_shares();
+    test_mutation_unshares();
+    test_strip_reuse();
+    test_threads();
+
+    return 0;
+}
+
+static bool equals(CowString str, String expected) {
+    return str.s.size == expected.size && memcmp(str.s.start, expected.start, expected.size) == 0;
+}
+
+void test_copy_shares() {
+    CowString a = UNWRAP(cowstring_new(S("Hello There")), {
+        CSL_TEST_ASSERT(false, "Failed to create a string.");
+        return;
+    });
+    CSL_TEST_ASSERT(!cowstring_is_shared(&a), "New string is shared.");
+    CowString b = cowstring_copy(&a);
+    CSL_TEST_ASSERT(b.s.start == a.s.start, "Copy duplicated the bytes.");
+    CSL_TEST_ASSERT(cowstring_is_shared(&a) && cowstring_is_shared(&b), "Copy is not shared.");
+    cowstring_delete(&a);
+    CSL_TEST_ASSERT(!cowstring_is_shared(&b) && equals(b, S("Hello There")), "Delete released the shared bytes.");
+    cowstring_delete(&b);
+}
+
+void test_mutation_unshares() {
+    CowString a = UNWRAP(cowstring_new(S("General")), return);
+    CowString b = cowstring_copy(&a);
+    CowString c = cowstring_copy(&a);
+    cowstring_append(&b, S(" Kenobi"));
+    cowstring_prepend(&c, S("Hello "));
+    CSL_TEST_ASSERT(equals(a, S("General")), "Mutating a copy changed the original.");
+    CSL_TEST_ASSERT(equals(b, S("General Kenobi")) && equals(c, S("Hello General")), "Mutations produced the wrong text.");
+    CSL_TEST_ASSERT(b.block != a.block && c.block != a.block, "Mutated copies still share the block.");
+    CSL_TEST_ASSERT(!cowstring_is_shared(&a), "Original still counts the mutated copies.");
+
+    /* Unique strings grow in place */
+    char* before = a.s.start;
+    cowstring_append(&a, S("!"));
+    CSL_TEST_ASSERT(a.s.start == before && equals(a, S("General!")), "Unique append copied.");
+
+    cowstring_delete(&a);
+    cowstring_delete(&b);
+    cowstring_delete(&c);
+    CSL_TEST_ASSERT(a.block == NULL, "Delete did not clear the handle.");
+}
+
+void test_strip_reuse() {
+    CowString a = UNWRAP(cowstring_new(S("xxHello Therexx")), return);
+    CowString b = cowstring_copy(&a);
+    cowstring_strippref(&b, 2);
+    cowstring_stripsuff(&b, 2);
+    CSL_TEST_ASSERT(b.block == a.block && equals(b, S("Hello There")), "Strip copied or produced the wrong view.");
+    CSL_TEST_ASSERT(equals(a, S("xxHello Therexx")), "Strip changed the other handle.");
+    CSL_TEST_ASSERT(cowstring_strippref(&b, 100).err, "Over-long strip accepted.");
+    cowstring_delete(&a);
+
+    /* Now unique: prepend fits into the stripped prefix */
+    char* before = b.s.start;
+    cowstring_prepend(&b, S(">>"));
+    CSL_TEST_ASSERT(b.s.start == before - 2 && equals(b, S(">>Hello There")), "Prepend did not reuse the stripped prefix.");
+    cowstring_delete(&b);
+
+    CowString empty = UNWRAP(cowstring_new(S("")), return);
+    cowstring_append(&empty, S("abc"));
+    CSL_TEST_ASSERT(equals(empty, S("abc")), "Append to an empty string failed.");
+    cowstring_delete(&empty);
+}
+
+#define THREADS 8
+
+static void* consumer(void* arg) {
+    CowString* mine = arg;
+    for(int i = 0; i < 1000; i++) {
+        CowString copy = cowstring_copy(mine);
+        if(i % 100 == 0) cowstring_append(&copy, S("x"));
+        cowstring_delete(&copy);
+    }
+    cowstring_delete(mine);
+    return NULL;
+}
+
+void test_threads() {
+    CowString payload = UNWRAP(cowstring_new(S("payload")), return);
+    pthread_t threads[THREADS];
+    CowString copies[THREADS];
+    for(int i = 0; i < THREADS; i++) {
+        copies[i] = cowstring_copy(&payload);
+        pthread_create(&threads[i], NULL, consumer, &copies[i]);
+    }
+    for(int i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+    CSL_TEST_ASSERT(!cowstring_is_shared(&payload) && equals(payload, S("payload")), "Refcount is wrong after concurrent use.");
+    cowstring_delete(&payload);
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define CSL_STRING_INTERFACE
+#define CSL_CSV_INTERFACE
+#include "../csl-csv.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+#define ARENA_SIZE 4096
+
+void test_simple();
+void test_quoted();
+void test_crlf_tsv();
+void test_errors();
+void test_random();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_simple();
+    test_quoted();
+    test_crlf_tsv();
+    test_errors();
+    test_random();
+
+    return 0;
+}
+
+static bool field_is(CsvRecord rec, size_t i, String expected) {
+    return i < rec.nfields && string_compare(rec.fields[i], expected) == 0;
+}
+
+void test_simple() {
+    CsvParser csv = csv_parser_new(S("a,b,c\n1,,3\n,\nlast"), ',', NULL);
+    WRESULT(CsvRecord) rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && rec.value.nfields == 3, "First record should have 3 fields");
+    CSL_TEST_ASSERT(field_is(rec.value, 0, S("a")) && field_is(rec.value, 2, S("c")), "Fields of the first record");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && rec.value.nfields == 3 && field_is(rec.value, 1, S("")), "Empty field in the middle");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && rec.value.nfields == 2, "Record of two empty fields");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && rec.value.nfields == 1 && field_is(rec.value, 0, S("last")), "Last record without newline");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_END, "Input should be exhausted");
+    csv_parser_delete(&csv);
+
+    csv = csv_parser_new(S(""), ',', NULL);
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_END, "Empty input has no records");
+    csv_parser_delete(&csv);
+}
+
+void test_quoted() {
+    Arena arena = {
+        .strategy = SCRATCH_ALLOC,
+        .scratch = { .data = malloc(ARENA_SIZE), .size = ARENA_SIZE }
+    };
+    /* The quoted field spans the 64 byte block boundary and contains
+     * delimiters and newlines */
+    String input = S("id,text\n"
+        "1,\"this field, which is quoted,\nspans lines and crosses the first block\"\n"
+        "2,\"she said \"\"hi\"\"\"\n"
+        "3,\"\"\n");
+    CsvParser csv = csv_parser_new(input, ',', &arena);
+    WRESULT(CsvRecord) rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && field_is(rec.value, 1, S("text")), "Header record");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && rec.value.nfields == 2, "Quoted delimiters and newlines are not structural");
+    CSL_TEST_ASSERT(
+        field_is(rec.value, 1, S("this field, which is quoted,\nspans lines and crosses the first block")),
+        "Quotes are stripped"
+    );
+    CSL_TEST_ASSERT(rec.value.fields[1].start > input.start && rec.value.fields[1].start < input.start + input.size,
+        "Fields without escapes point into the input");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && field_is(rec.value, 1, S("she said \"hi\"")), "Escaped quotes are unescaped");
+    CSL_TEST_ASSERT((uint8_t*)rec.value.fields[1].start == arena.scratch.data, "Unescaped field lives in the arena");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && field_is(rec.value, 1, S("")), "Empty quoted field");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_END, "Input should be exhausted");
+    csv_parser_delete(&csv);
+    arena_delete(&arena);
+}
+
+void test_crlf_tsv() {
+    CsvParser csv = csv_parser_new(S("a\tb,c\r\n\"x\"\t\"y\"\r\n"), '\t', NULL);
+    WRESULT(CsvRecord) rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && rec.value.nfields == 2, "Tab separated record");
+    CSL_TEST_ASSERT(field_is(rec.value, 1, S("b,c")), "CR is dropped and commas are not delimiters");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(!rec.err && field_is(rec.value, 0, S("x")) && field_is(rec.value, 1, S("y")), "Quoted TSV with CRLF");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_END, "Input should be exhausted");
+    csv_parser_delete(&csv);
+}
+
+void test_errors() {
+    CsvParser csv = csv_parser_new(S("a,\"never closed\nb,c\n"), ',', NULL);
+    WRESULT(CsvRecord) rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_UNTERMINATED_QUOTE, "Unterminated quote is an error");
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_END, "Parser stops after an error");
+    csv_parser_delete(&csv);
+
+    csv = csv_parser_new(S("\"a\"\"b\"\n"), ',', NULL);
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_ARENA_FULL, "Escapes need an arena");
+    csv_parser_delete(&csv);
+
+    Arena arena = {
+        .strategy = SCRATCH_ALLOC,
+        .scratch = { .data = malloc(4), .size = 4 }
+    };
+    csv = csv_parser_new(S("\"ab\"\"cd\"\n"), ',', &arena);
+    rec = csv_next(&csv);
+    CSL_TEST_ASSERT(rec.err && rec.code == CSV_ARENA_FULL, "Arena too small for the unescaped field");
+    csv_parser_delete(&csv);
+    arena_delete(&arena);
+}
+
+static uint64_t rng = 0xC5Dull;
+static uint64_t next() {
+    rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+    return rng;
+}
+
+/* Random records are generated alongside the fields they should parse to,
+ * with field lengths that land quotes and separators on every offset of the
+ * 64 byte blocks */
+void test_random() {
+    enum { RECORDS = 2000, MAX_FIELDS = 6 };
+    static const char alphabet[] = "abc,\n\"";
+    DString input = UNWRAP(dstring_new(""), return);
+    DString expected = UNWRAP(dstring_new(""), return);
+    size_t* nfields = malloc(RECORDS * sizeof(size_t));
+    size_t* lengths = malloc(RECORDS * MAX_FIELDS * sizeof(size_t));
+    for(size_t r = 0; r < RECORDS; r++) {
+        nfields[r] = 1 + next() % MAX_FIELDS;
+        for(size_t f = 0; f < nfields[r]; f++) {
+            if(f) dstring_append_slice(&input, S(","));
+            bool quoted = next() % 2;
+            size_t len = next() % 40;
+            if(quoted) dstring_append_slice(&input, S("\""));
+            size_t emitted = 0;
+            for(size_t i = 0; i < len; i++) {
+                char c = alphabet[next() % (quoted ? 6 : 3)];
+                dstring_append_slice(&expected, (String){ .start = &c, .size = 1 });
+                dstring_append_slice(&input, (String){ .start = &c, .size = 1 });
+                if(c == '"') dstring_append_slice(&input, S("\""));
+                emitted++;
+            }
+            if(quoted) dstring_append_slice(&input, S("\""));
+            lengths[r * MAX_FIELDS + f] = emitted;
+        }
+        dstring_append_slice(&input, next() % 2 ? S("\r\n") : S("\n"));
+    }
+    Arena arena = {
+        .strategy = SCRATCH_ALLOC,
+        .scratch = { .data = malloc(input.s.size), .size = input.s.size }
+    };
+    CsvParser csv = csv_parser_new(input.s, ',', &arena);
+    size_t offset = 0;
+    bool matches = true;
+    size_t r = 0;
+    for(WRESULT(CsvRecord) rec; !(rec = csv_next(&csv)).err; r++) {
+        if(r >= RECORDS || rec.value.nfields != nfields[r]) {
+            matches = false;
+            break;
+        }
+        for(size_t f = 0; f < rec.value.nfields; f++) {
+            String want = { .start = expected.s.start + offset, .size = lengths[r * MAX_FIELDS + f] };
+            matches &= string_compare(rec.value.fields[f], want) == 0;
+            offset += want.size;
+        }
+    }
+    CSL_TEST_ASSERT(matches && r == RECORDS, "Random records should round trip");
+    csv_parser_delete(&csv);
+    arena_delete(&arena);
+    free(nfields);
+    free(lengths);
+    dstring_delete(&input);
+    dstring_delete(&expected);
+}
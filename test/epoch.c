@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../csl-tests.h"
+
+#define EPOCH_IMPLEMENTATION
+#include "../csl-epoch.h"
+
+#define READERS 3
+#define UPDATES 50000
+
+void test_deferred();
+void test_reader_blocks();
+void test_orphans();
+void test_concurrent();
+
+typedef struct {
+    size_t value;
+    size_t check;       // always value * 7, to catch reads of freed nodes
+} Node;
+
+static atomic_size_t freed;
+
+static void free_node(void* ptr) {
+    Node* node = ptr;
+    node->check = 0;
+    atomic_fetch_add(&freed, 1);
+    free(node);
+}
+
+static Node* make_node(size_t value) {
+    Node* node = malloc(sizeof(Node));
+    *node = (Node){ .value = value, .check = value * 7 };
+    return node;
+}
+
+static void* run(void* (*fn)(void*), void* arg) {
+    pthread_t thread;
+    void* ret;
+    pthread_create(&thread, NULL, fn, arg);
+    pthread_join(thread, &ret);
+    return ret;
+}
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_deferred();
+    test_reader_blocks();
+    test_orphans();
+    test_concurrent();
+
+    return 0;
+}
+
+void test_deferred() {
+    atomic_store(&freed, 0);
+    epoch_retire(make_node(1), free_node);
+    CSL_TEST_ASSERT(atomic_load(&freed) == 0, "Retired memory is not freed straight away");
+    CSL_TEST_ASSERT(epoch_pending() == 1, "One pending object");
+    epoch_enter();
+    epoch_enter();
+    epoch_leave();
+    CSL_TEST_ASSERT(epoch_self->depth == 1, "Critical sections nest");
+    epoch_leave();
+    epoch_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 1, "Barrier frees it");
+    CSL_TEST_ASSERT(epoch_pending() == 0, "Nothing pending after the barrier");
+    for(size_t i = 0; i < EPOCH_RETIRE_BATCH * 4; i++) epoch_retire(make_node(i), free_node);
+    CSL_TEST_ASSERT(atomic_load(&freed) > 0, "Retiring in batches frees old bags along the way");
+    CSL_TEST_ASSERT(epoch_pending() < EPOCH_RETIRE_BATCH * 3, "At most a few bags pending");
+    epoch_barrier();
+}
+
+static atomic_int reader_state;     // 1 inside the critical section, 2 told to leave
+
+static void* hold_section(void* arg) {
+    (void)arg;
+    epoch_scope();
+    atomic_store(&reader_state, 1);
+    while(atomic_load(&reader_state) != 2) sched_yield();
+    return NULL;
+}
+
+void test_reader_blocks() {
+    atomic_store(&freed, 0);
+    atomic_store(&reader_state, 0);
+    pthread_t reader;
+    pthread_create(&reader, NULL, hold_section, NULL);
+    while(atomic_load(&reader_state) != 1) sched_yield();
+    epoch_retire(make_node(2), free_node);
+    for(size_t i = 0; i < 10; i++) epoch_collect();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 0, "Nothing freed while a reader could still see it");
+    atomic_store(&reader_state, 2);
+    pthread_join(reader, NULL);
+    epoch_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 1, "Freed once the reader left");
+}
+
+static void* retire_and_exit(void* arg) {
+    (void)arg;
+    epoch_retire(make_node(3), free_node);
+    epoch_retire(make_node(4), free_node);
+    return NULL;
+}
+
+void test_orphans() {
+    atomic_store(&freed, 0);
+    run(retire_and_exit, NULL);
+    CSL_TEST_ASSERT(atomic_load(&freed) == 0, "Exited thread's bag is not freed early");
+    CSL_TEST_ASSERT(atomic_load(&epoch_global.norphans) == 1, "Its bag was handed over");
+    epoch_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 2, "Another thread frees the orphaned bag");
+    run(retire_and_exit, NULL);
+    CSL_TEST_ASSERT(atomic_load(&freed) == 2, "A reused thread record starts empty");
+    epoch_barrier();
+}
+
+static _Atomic(Node*) shared;
+static atomic_bool writer_done;
+
+static void* reader(void* arg) {
+    (void)arg;
+    size_t bad = 0;
+    while(!atomic_load(&writer_done)) {
+        epoch_enter();
+        Node* node = atomic_load_explicit(&shared, memory_order_acquire);
+        if(node->check != node->value * 7) bad++;
+        epoch_leave();
+    }
+    return (void*)bad;
+}
+
+void test_concurrent() {
+    atomic_store(&freed, 0);
+    atomic_store(&shared, make_node(0));
+    pthread_t threads[READERS];
+    for(size_t i = 0; i < READERS; i++) pthread_create(&threads[i], NULL, reader, NULL);
+    for(size_t i = 1; i <= UPDATES; i++) {
+        Node* old = atomic_exchange_explicit(&shared, make_node(i), memory_order_acq_rel);
+        epoch_retire(old, free_node);
+    }
+    atomic_store(&writer_done, true);
+    size_t bad = 0;
+    for(size_t i = 0; i < READERS; i++) {
+        void* ret;
+        pthread_join(threads[i], &ret);
+        bad += (size_t)ret;
+    }
+    CSL_TEST_ASSERT(bad == 0, "Readers never see a freed node");
+    epoch_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == UPDATES, "Every retired node freed");
+    free(atomic_load(&shared));
+}
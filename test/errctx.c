@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#define CSL_STRING_INTERFACE
+#define CSL_ERRCTX_INTERFACE
+#include "../csl-errctx.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+typedef struct { int port; } Config;
+DERIVE_WRESULT_CTX(Config, CONFIG_NOT_FOUND);
+DERIVE_WRESULT_CTX(int);
+
+void test_chain();
+void test_arguments();
+void test_overflow();
+void test_threads();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_chain();
+    test_arguments();
+    test_overflow();
+    test_threads();
+
+    return 0;
+}
+
+static bool format_is(const ErrCtxFrame* frame, const char* expected) {
+    DString text = {0};
+    errctx_format(frame, &text);
+    bool equal = text.s.size == strlen(expected) && memcmp(text.s.start, expected, text.s.size) == 0;
+    if(!equal) printf("got: %.*s\n", (int)text.s.size, text.s.start);
+    dstring_delete(&text);
+    return equal;
+}
+
+static WRESULT(Config) find_config(String key) {
+    Config empty = {0};
+    return WRESULT_ERR_CODED_CTX(Config, empty, CONFIG_NOT_FOUND, NULL, "no key %s", key);
+}
+
+static WRESULT(int) load(int attempt) {
+    WRESULT(Config) config = find_config(S("port"));
+    if(config.err) return WRESULT_ERR_CTX(int, 0, config.ctx, "loading attempt %d of %zu", attempt, (size_t)3);
+    return WRESULT_OK(int, config.value.port);
+}
+
+void test_chain() {
+    WRESULT(int) result = load(2);
+    CSL_TEST_ASSERT(result.err && result.ctx != NULL, "Error should carry a context");
+    CSL_TEST_ASSERT(result.ctx->next != NULL && result.ctx->next->next == NULL, "Chain should have two frames");
+    CSL_TEST_ASSERT(strcmp(result.ctx->fmt, "loading attempt %d of %zu") == 0, "Frames store the raw format");
+    char expected[256];
+    snprintf(expected, sizeof(expected), "%s:%u: loading attempt 2 of 3\n%s:%u: no key port\n",
+        __FILE__, result.ctx->line, __FILE__, result.ctx->next->line);
+    CSL_TEST_ASSERT(format_is(result.ctx, expected), "Chain formats newest first");
+    WRESULT(int) ok = WRESULT_OK(int, 5);
+    CSL_TEST_ASSERT(!ok.err && ok.ctx == NULL, "Success has no context");
+    errctx_clear();
+}
+
+void test_arguments() {
+    char word[] = "word";
+    int x = 1;
+    ErrCtxFrame* frame = ERRCTX(NULL, "%hhd|%5.2f|%-6s|%x|%c|%lu|%.2s|%%|%s|%d",
+        (signed char)-3, 3.14159, word, 255u, 'z', (unsigned long)42, S("slice"), (char*)NULL, x);
+    DString text = {0};
+    errctx_format(frame, &text);
+    const char* body = memchr(text.s.start, ' ', text.s.size);
+    String got = { .start = (char*)body + 1, .size = text.s.size - (body + 1 - text.s.start) };
+    CSL_TEST_ASSERT(
+        string_compare(got, S("-3| 3.14|word  |ff|z|42|sl|%|(null)|1\n")) == 0,
+        "Arguments are formatted with the original specifiers"
+    );
+    dstring_delete(&text);
+    frame = ERRCTX(NULL, "plain");
+    CSL_TEST_ASSERT(frame->nargs == 0 && strcmp(frame->fmt, "plain") == 0, "No arguments");
+    frame = ERRCTX(NULL, "%d and %d", 1);
+    CSL_TEST_ASSERT(frame->nargs == 1, "Only the given arguments are stored");
+    text = (DString){0};
+    errctx_format(frame, &text);
+    CSL_TEST_ASSERT(text.s.size > 16 && memcmp(text.s.start + text.s.size - 16, "1 and (missing)\n", 16) == 0,
+        "Missing arguments are marked");
+    dstring_delete(&text);
+    errctx_clear();
+}
+
+void test_overflow() {
+    ErrCtxFrame* chain = NULL;
+    size_t frames = 0;
+    for(size_t i = 0; i < 10000; i++) {
+        ErrCtxFrame* next = ERRCTX(chain, "frame %zu", i);
+        if(next == chain) break;
+        chain = next;
+        frames++;
+    }
+    CSL_TEST_ASSERT(frames > 100 && frames < 10000, "Arena fills up and frames get dropped");
+    CSL_TEST_ASSERT(chain != NULL && chain->args[0].u == frames - 1, "Chain is still intact");
+    errctx_clear();
+    CSL_TEST_ASSERT(ERRCTX(NULL, "again") != NULL, "Clearing makes room again");
+    errctx_clear();
+}
+
+static void* worker(void* arg) {
+    ErrCtxFrame* frame = ERRCTX(NULL, "thread %d", *(int*)arg);
+    DString text = {0};
+    errctx_format(frame, &text);
+    static const char suffix[] = "thread 7\n";
+    bool ok = text.s.size > sizeof(suffix) - 1 &&
+        memcmp(text.s.start + text.s.size - (sizeof(suffix) - 1), suffix, sizeof(suffix) - 1) == 0;
+    dstring_delete(&text);
+    return ok ? frame : NULL;
+}
+
+void test_threads() {
+    ErrCtxFrame* main_frame = ERRCTX(NULL, "main");
+    pthread_t thread;
+    int id = 7;
+    pthread_create(&thread, NULL, worker, &id);
+    void* frame = NULL;
+    pthread_join(thread, &frame);
+    CSL_TEST_ASSERT(frame != NULL && frame != main_frame, "Each thread records into its own arena");
+    errctx_clear();
+}
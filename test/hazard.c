@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../csl-tests.h"
+
+#define HAZARD_IMPLEMENTATION
+#include "../csl-hazard.h"
+
+#define THREADS 4
+#define OPS 20000
+
+void test_protect();
+void test_amortized();
+void test_orphans();
+void test_stack();
+
+typedef struct Node {
+    size_t value;
+    size_t check;       // always value * 7, to catch reads of freed nodes
+    struct Node* next;
+} Node;
+
+static atomic_size_t freed;
+
+static void free_node(void* ptr) {
+    Node* node = ptr;
+    node->check = 0;
+    atomic_fetch_add(&freed, 1);
+    free(node);
+}
+
+static Node* make_node(size_t value) {
+    Node* node = malloc(sizeof(Node));
+    *node = (Node){ .value = value, .check = value * 7 };
+    return node;
+}
+
+static void* run(void* (*fn)(void*), void* arg) {
+    pthread_t thread;
+    void* ret;
+    pthread_create(&thread, NULL, fn, arg);
+    pthread_join(thread, &ret);
+    return ret;
+}
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_protect();
+    test_amortized();
+    test_orphans();
+    test_stack();
+
+    return 0;
+}
+
+static _Atomic(Node*) shared;
+static atomic_int reader_state;     // 1 holding the hazard, 2 told to clear it
+
+static void* hold_hazard(void* arg) {
+    Node** seen = arg;
+    *seen = hazard_protect(0, &shared);
+    atomic_store(&reader_state, 1);
+    while(atomic_load(&reader_state) != 2) sched_yield();
+    hazard_clear(0);
+    return NULL;
+}
+
+void test_protect() {
+    atomic_store(&freed, 0);
+    atomic_store(&reader_state, 0);
+    atomic_store(&shared, make_node(1));
+    Node* seen = NULL;
+    pthread_t reader;
+    pthread_create(&reader, NULL, hold_hazard, &seen);
+    while(atomic_load(&reader_state) != 1) sched_yield();
+    CSL_TEST_ASSERT(seen == atomic_load(&shared), "Protect returns the current pointer");
+    Node* old = atomic_exchange(&shared, make_node(2));
+    hazard_retire(old, free_node);
+    CSL_TEST_ASSERT(hazard_pending() == 1, "One pending object");
+    for(size_t i = 0; i < 10; i++) hazard_scan();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 0, "Nothing freed while another thread protects it");
+    CSL_TEST_ASSERT(seen->check == 7, "Protected node still readable");
+    atomic_store(&reader_state, 2);
+    pthread_join(reader, NULL);
+    hazard_scan();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 1, "Freed once the hazard is cleared");
+    hazard_retire(atomic_exchange(&shared, NULL), free_node);
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 2, "Barrier frees the rest");
+    CSL_TEST_ASSERT(hazard_protect(1, &shared) == NULL, "Protecting NULL returns NULL");
+    hazard_clear(1);
+}
+
+void test_amortized() {
+    atomic_store(&freed, 0);
+    size_t most = 0;
+    for(size_t i = 0; i < HAZARD_SCAN_MIN * 10; i++) {
+        hazard_retire(make_node(i), free_node);
+        if(hazard_pending() > most) most = hazard_pending();
+    }
+    CSL_TEST_ASSERT(atomic_load(&freed) > HAZARD_SCAN_MIN * 8, "Retiring scans along the way");
+    CSL_TEST_ASSERT(most <= HAZARD_SCAN_MIN, "Pending objects stay bounded by the scan threshold");
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == HAZARD_SCAN_MIN * 10, "Everything freed");
+}
+
+static void* retire_and_exit(void* arg) {
+    Node* node = arg;
+    hazard_retire(node, free_node);
+    return NULL;
+}
+
+void test_orphans() {
+    atomic_store(&freed, 0);
+    /* Hold a hazard on the node so the exiting thread can't free it */
+    Node* node = make_node(3);
+    hazard_set(0, node);
+    run(retire_and_exit, node);
+    CSL_TEST_ASSERT(atomic_load(&freed) == 0, "Exited thread doesn't free a protected node");
+    CSL_TEST_ASSERT(atomic_load(&hazard_global.norphans) == 1, "It was handed over");
+    hazard_scan();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 0, "Still protected after being taken over");
+    hazard_clear(0);
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == 1, "Freed by another thread once unprotected");
+    CSL_TEST_ASSERT(atomic_load(&hazard_global.norphans) == 0, "No orphans left");
+}
+
+/* Treiber stack: pop reads head->next, which is only safe while head is protected */
+static _Atomic(Node*) stack;
+
+static void push(Node* node) {
+    Node* head = atomic_load_explicit(&stack, memory_order_relaxed);
+    do {
+        node->next = head;
+    } while(!atomic_compare_exchange_weak_explicit(&stack, &head, node, memory_order_release, memory_order_relaxed));
+}
+
+static Node* pop() {
+    for(;;) {
+        Node* head = hazard_protect(0, &stack);
+        if(head == NULL) return NULL;
+        Node* next = head->next;
+        if(atomic_compare_exchange_strong_explicit(&stack, &head, next, memory_order_acquire, memory_order_relaxed)) {
+            hazard_clear(0);
+            return head;
+        }
+    }
+}
+
+static void* churn(void* arg) {
+    size_t id = (size_t)arg;
+    size_t bad = 0;
+    for(size_t i = 0; i < OPS; i++) {
+        push(make_node(id * OPS + i));
+        Node* node = pop();
+        if(node == NULL) continue;
+        if(node->check != node->value * 7) bad++;
+        hazard_retire(node, free_node);
+    }
+    return (void*)bad;
+}
+
+void test_stack() {
+    atomic_store(&freed, 0);
+    pthread_t threads[THREADS];
+    for(size_t i = 0; i < THREADS; i++) pthread_create(&threads[i], NULL, churn, (void*)i);
+    size_t bad = 0;
+    for(size_t i = 0; i < THREADS; i++) {
+        void* ret;
+        pthread_join(threads[i], &ret);
+        bad += (size_t)ret;
+    }
+    CSL_TEST_ASSERT(bad == 0, "Pops never see a freed node");
+    size_t left = 0;
+    for(Node* node = pop(); node != NULL; node = pop()) {
+        hazard_retire(node, free_node);
+        left++;
+    }
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&freed) == THREADS * OPS, "Every node freed exactly once");
+    CSL_TEST_ASSERT(left == 0, "Every push was matched by a pop");
+}
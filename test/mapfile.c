@@ -0,0 +1,48 @@
+#include <stdio.h>
+#define CSL_STRING_INTERFACE
+#include "../csl-string.c"
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_UNIQUE_TYPE_LIST \
+    SMRTPTR_DERIVE_UNIQUE(String)
+#include "../csl-smrtptrs.h"
+
+void test_map_file();
+void test_map_missing();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_map_file();
+    test_map_missing();
+
+    return 0;
+}
+
+void test_map_file() {
+    /* Read the file the old way to compare against */
+    FILE* fp = fopen("test.txt", "rb");
+    if(!CSL_TEST_ASSERT(fp != NULL, "Failed to open test.txt (run from the repository root).")) return;
+    char buf[1 << 16];
+    size_t nread = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+
+    String file = UNWRAP(string_map_file("test.txt"), {
+        CSL_TEST_ASSERT(false, "Failed to map test.txt.");
+        return;
+    });
+    String* seen = NULL;
+    {
+        smrtptr_unique(String) guard = smrtptr_make_unique(String, &file, string_unmap_file);
+        seen = guard.ptr;
+        CSL_TEST_ASSERT(file.size == nread, "Mapping has the wrong size.");
+        CSL_TEST_ASSERT(memcmp(file.start, buf, nread) == 0, "Mapping differs from the file contents.");
+    }
+    CSL_TEST_ASSERT(seen == &file && file.start == NULL && file.size == 0, "Mapping was not released at scope exit.");
+}
+
+void test_map_missing() {
+    CSL_TEST_ASSERT(string_map_file("this/file/does/not/exist").err, "Mapped a file that does not exist.");
+    CSL_TEST_ASSERT(string_map_file(".").err, "Mapped a directory.");
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define CSL_STRING_INTERFACE
+#define CSL_ROPE_INTERFACE
+#include "../csl-rope.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_new_flatten();
+void test_insert_remove();
+void test_index_slice();
+void test_against_dstring();
+void test_chunk_merging();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_new_flatten();
+    test_insert_remove();
+    test_index_slice();
+    test_against_dstring();
+    test_chunk_merging();
+
+    return 0;
+}
+
+static bool rope_equals(const Rope* rope, const char* expected, size_t size) {
+    DString flat = UNWRAP(rope_flatten(rope), return false);
+    bool ok = flat.s.size == size && memcmp(flat.s.start, expected, size) == 0;
+    free(flat.s.start);
+    return ok;
+}
+
+static size_t rope_chunks(const Rope* rope) {
+    size_t chunks = 0;
+    String chunk;
+    for(size_t it = 0; rope_next(rope, &it, &chunk);) chunks++;
+    return chunks;
+}
+
+void test_new_flatten() {
+    Rope rope = UNWRAP(rope_new(S("")), {
+        CSL_TEST_ASSERT(false, "Failed to create an empty rope.");
+        return;
+    });
+    CSL_TEST_ASSERT(rope_size(&rope) == 0, "Empty rope is not empty.");
+    rope_delete(&rope);
+
+    size_t size = ROPE_CHUNK_SIZE * 5 + 17;
+    char* text = malloc(size);
+    for(size_t i = 0; i < size; i++) text[i] = 'a' + i % 26;
+    rope = UNWRAP(rope_new((String){ .start = text, .size = size }), return);
+    CSL_TEST_ASSERT(rope_size(&rope) == size, "Rope size is wrong.");
+    CSL_TEST_ASSERT(rope_equals(&rope, text, size), "Flattened rope differs from its source.");
+
+    size_t chunks = 0, total = 0;
+    String chunk;
+    for(size_t it = 0; rope_next(&rope, &it, &chunk);) {
+        CSL_TEST_ASSERT(chunk.size > 0 && chunk.size <= ROPE_CHUNK_SIZE, "Chunk has a bad size.");
+        total += chunk.size;
+        chunks++;
+    }
+    CSL_TEST_ASSERT(chunks == 6 && total == size, "Iteration does not cover the rope.");
+    rope_delete(&rope);
+    free(text);
+}
+
+void test_insert_remove() {
+    Rope rope = UNWRAP(rope_new(S("Hello World")), return);
+    rope_insert(&rope, 5, S(","));
+    rope_insert(&rope, rope_size(&rope), S("!"));
+    rope_insert(&rope, 0, S(">> "));
+    CSL_TEST_ASSERT(rope_equals(&rope, ">> Hello, World!", 16), "Insert produced the wrong text.");
+    rope_remove(&rope, 0, 3);
+    rope_remove(&rope, 5, 6);
+    CSL_TEST_ASSERT(rope_equals(&rope, "Hello World!", 12), "Remove produced the wrong text.");
+    CSL_TEST_ASSERT(rope_insert(&rope, 13, S("x")).err, "Insert past the end accepted.");
+    CSL_TEST_ASSERT(rope_remove(&rope, 4, 13).err, "Remove past the end accepted.");
+    rope_remove(&rope, 0, rope_size(&rope));
+    CSL_TEST_ASSERT(rope_size(&rope) == 0 && rope.root == NULL, "Removing everything leaves chunks behind.");
+    rope_delete(&rope);
+}
+
+void test_index_slice() {
+    char text[3000];
+    for(size_t i = 0; i < sizeof(text); i++) text[i] = '0' + i % 10;
+    Rope rope = UNWRAP(rope_new((String){ .start = text, .size = sizeof(text) }), return);
+    bool all = true;
+    for(size_t i = 0; i < sizeof(text); i += 7) all &= UNWRAP(rope_index(&rope, i), return) == text[i];
+    CSL_TEST_ASSERT(all, "Index returned the wrong byte.");
+    CSL_TEST_ASSERT(rope_index(&rope, sizeof(text)).err, "Index past the end accepted.");
+    DString slice = UNWRAP(rope_slice(&rope, 1000, 2100), return);
+    CSL_TEST_ASSERT(slice.s.size == 1100 && memcmp(slice.s.start, text + 1000, 1100) == 0, "Slice across chunks is wrong.");
+    free(slice.s.start);
+    rope_delete(&rope);
+}
+
+/* Random edits mirrored on a plain buffer */
+void test_against_dstring() {
+    size_t cap = 1 << 20;
+    char* ref = malloc(cap);
+    size_t size = 0;
+    char insert[3000];
+    for(size_t i = 0; i < sizeof(insert); i++) insert[i] = 'A' + i % 26;
+    Rope rope = UNWRAP(rope_new(S("")), return);
+    uint64_t state = 12345;
+    bool all = true;
+    for(int i = 0; i < 20000; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        size_t at = size ? state % (size + 1) : 0;
+        if(state % 3 != 0 || size == 0) {
+            size_t n = (state >> 20) % (state % 50 == 0 ? sizeof(insert) : 40);
+            if(size + n > cap) continue;
+            memmove(ref + at + n, ref + at, size - at);
+            memcpy(ref + at, insert, n);
+            size += n;
+            all &= !rope_insert(&rope, at, (String){ .start = insert, .size = n }).err;
+        } else {
+            size_t n = (state >> 20) % 60;
+            if(at + n > size) n = size - at;
+            memmove(ref + at, ref + at + n, size - at - n);
+            size -= n;
+            all &= !rope_remove(&rope, at, at + n).err;
+        }
+        all &= rope_size(&rope) == size;
+    }
+    CSL_TEST_ASSERT(all, "Edit failed or size drifted.");
+    CSL_TEST_ASSERT(rope_equals(&rope, ref, size), "Rope differs from the reference after random edits.");
+    rope_delete(&rope);
+    free(ref);
+}
+
+void test_chunk_merging() {
+    size_t nchunks = 64;
+    size_t size = ROPE_CHUNK_SIZE * nchunks;
+    char* text = malloc(size);
+    for(size_t i = 0; i < size; i++) text[i] = 'a' + i % 26;
+    Rope rope = UNWRAP(rope_new((String){ .start = text, .size = size }), return);
+    /* Shrink every chunk in place, from the back so earlier offsets hold */
+    for(size_t i = nchunks; i > 0; i--) rope_remove(&rope, (i - 1) * ROPE_CHUNK_SIZE + 8, i * ROPE_CHUNK_SIZE);
+    CSL_TEST_ASSERT(rope_size(&rope) == nchunks * 8, "In place removes left the wrong size.");
+    CSL_TEST_ASSERT(rope_chunks(&rope) == 1, "Chunks shrunk in place were not joined.");
+    char kept[64 * 8];
+    for(size_t i = 0; i < nchunks; i++) memcpy(kept + i * 8, text + i * ROPE_CHUNK_SIZE, 8);
+    CSL_TEST_ASSERT(rope_equals(&rope, kept, nchunks * 8), "Joined chunks hold the wrong bytes.");
+    rope_delete(&rope);
+
+    /* Cut across every chunk boundary, leaving a sliver of each middle chunk */
+    rope = UNWRAP(rope_new((String){ .start = text, .size = size }), return);
+    for(size_t i = nchunks - 1; i > 0; i--) rope_remove(&rope, i * ROPE_CHUNK_SIZE - 500, i * ROPE_CHUNK_SIZE + 500);
+    size_t left = rope_size(&rope);
+    CSL_TEST_ASSERT(rope_chunks(&rope) <= 2 * left / ROPE_CHUNK_SIZE + 1, "Slivers left by removes were not joined.");
+    rope_delete(&rope);
+
+    /* Single byte inserts into full chunks split them */
+    rope = UNWRAP(rope_new((String){ .start = text, .size = size }), return);
+    for(size_t i = nchunks; i > 0; i--) rope_insert(&rope, (i - 1) * ROPE_CHUNK_SIZE + 1, S("x"));
+    CSL_TEST_ASSERT(rope_chunks(&rope) <= 2 * nchunks + 1, "Inserted bytes were left in chunks of their own.");
+    rope_delete(&rope);
+    free(text);
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include "../csl-slotmap.h"
+#include "../csl-tests.h"
+
+typedef struct {
+    int id;
+    double x;
+} Entity;
+
+#define TEMPLATE SLOTMAP_TEMPLATE
+GENERATE(Entity, int)
+#undef TEMPLATE
+
+#define MANY 10000
+
+void test_insert_get();
+void test_stale();
+void test_swap_remove();
+void test_iterate();
+void test_clear();
+void test_generation_wrap();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_insert_get();
+    test_stale();
+    test_swap_remove();
+    test_iterate();
+    test_clear();
+    test_generation_wrap();
+
+    return 0;
+}
+
+void test_insert_get() {
+    SLOTMAP(Entity) entities = {0};
+    SlotMapHandle a = UNWRAP(slotmap_insert(&entities, ((Entity){ .id = 1, .x = 1.5 })), return);
+    SlotMapHandle b = UNWRAP(slotmap_insert(&entities, ((Entity){ .id = 2, .x = 2.5 })), return);
+    CSL_TEST_ASSERT(slotmap_size(&entities) == 2, "Two values");
+    CSL_TEST_ASSERT(slotmap_get(&entities, a)->id == 1, "Handle finds its value");
+    CSL_TEST_ASSERT(slotmap_get(&entities, b)->x == 2.5, "Second handle finds its value");
+    slotmap_get(&entities, a)->x = 9;
+    CSL_TEST_ASSERT(entities.values[0].x == 9, "Get returns a pointer into the dense array");
+    CSL_TEST_ASSERT(slotmap_get(&entities, (SlotMapHandle){0}) == NULL, "Zeroed handle is never valid");
+    CSL_TEST_ASSERT(!slotmap_contains(&entities, ((SlotMapHandle){ .index = 7, .generation = 1 })),
+        "Out of range handle is stale");
+    slotmap_free(&entities);
+    CSL_TEST_ASSERT(slotmap_size(&entities) == 0 && entities.values == NULL, "Free leaves an empty map");
+}
+
+void test_stale() {
+    SLOTMAP(int) numbers = {0};
+    SlotMapHandle a = UNWRAP(slotmap_insert(&numbers, 10), return);
+    CSL_TEST_ASSERT(slotmap_erase(&numbers, a), "Erase removes a live value");
+    CSL_TEST_ASSERT(slotmap_get(&numbers, a) == NULL, "Handle is stale after erase");
+    CSL_TEST_ASSERT(!slotmap_erase(&numbers, a), "Erasing twice fails");
+    SlotMapHandle b = UNWRAP(slotmap_insert(&numbers, 20), return);
+    CSL_TEST_ASSERT(b.index == a.index, "Freed slot is reused");
+    CSL_TEST_ASSERT(b.generation != a.generation, "With a new generation");
+    CSL_TEST_ASSERT(slotmap_get(&numbers, a) == NULL, "Old handle doesn't see the new value");
+    CSL_TEST_ASSERT(*slotmap_get(&numbers, b) == 20, "New handle does");
+    SlotMapHandle forged = { .index = b.index, .generation = b.generation + 1 };
+    CSL_TEST_ASSERT(slotmap_get(&numbers, forged) == NULL, "Generation of a free slot never matches");
+    slotmap_free(&numbers);
+}
+
+void test_swap_remove() {
+    SLOTMAP(int) numbers = {0};
+    SlotMapHandle handles[MANY];
+    for(int i = 0; i < MANY; i++) handles[i] = UNWRAP(slotmap_insert(&numbers, i), return);
+    CSL_TEST_ASSERT(slotmap_size(&numbers) == MANY, "Grows past the first allocation");
+    SlotMapHandle last = handles[MANY - 1];
+    CSL_TEST_ASSERT(slotmap_erase(&numbers, handles[0]), "Erase the first value");
+    CSL_TEST_ASSERT(numbers.values[0] == MANY - 1, "Last value moved into the hole");
+    CSL_TEST_ASSERT(*slotmap_get(&numbers, last) == MANY - 1, "Moved value's handle still finds it");
+    /* Erase every even value */
+    for(int i = 2; i < MANY; i += 2) slotmap_erase(&numbers, handles[i]);
+    CSL_TEST_ASSERT(slotmap_size(&numbers) == MANY / 2, "Half left");
+    bool ok = true;
+    for(int i = 1; i < MANY; i += 2) {
+        int* value = slotmap_get(&numbers, handles[i]);
+        if(value == NULL || *value != i) ok = false;
+    }
+    for(int i = 0; i < MANY; i += 2) {
+        if(slotmap_contains(&numbers, handles[i])) ok = false;
+    }
+    CSL_TEST_ASSERT(ok, "Every surviving handle finds its value and every erased one is stale");
+    slotmap_free(&numbers);
+}
+
+void test_iterate() {
+    SLOTMAP(Entity) entities = {0};
+    SlotMapHandle handles[8];
+    for(int i = 0; i < 8; i++) handles[i] = UNWRAP(slotmap_insert(&entities, ((Entity){ .id = i })), return);
+    slotmap_erase(&entities, handles[3]);
+    slotmap_erase(&entities, handles[5]);
+    int sum = 0;
+    size_t visited = 0;
+    slotmap_foreach(it, &entities) {
+        sum += it->id;
+        visited++;
+    }
+    CSL_TEST_ASSERT(visited == 6, "Foreach visits exactly the live values");
+    CSL_TEST_ASSERT(sum == 0 + 1 + 2 + 4 + 6 + 7, "No erased value is visited");
+    bool ok = true;
+    slotmap_foreach(it, &entities) {
+        SlotMapHandle handle = slotmap_handle_at(&entities, it - entities.values);
+        if(slotmap_get(&entities, handle) != it) ok = false;
+    }
+    CSL_TEST_ASSERT(ok, "Handle at a dense position refers back to it");
+    slotmap_free(&entities);
+    size_t empty = 0;
+    slotmap_foreach(it, &entities) empty++;
+    CSL_TEST_ASSERT(empty == 0, "Empty map loops zero times");
+}
+
+void test_clear() {
+    SLOTMAP(int) numbers = {0};
+    SlotMapHandle a = UNWRAP(slotmap_insert(&numbers, 1), return);
+    SlotMapHandle b = UNWRAP(slotmap_insert(&numbers, 2), return);
+    int* values = numbers.values;
+    slotmap_clear(&numbers);
+    CSL_TEST_ASSERT(slotmap_size(&numbers) == 0, "Clear empties the map");
+    CSL_TEST_ASSERT(!slotmap_contains(&numbers, a) && !slotmap_contains(&numbers, b), "Every handle is stale");
+    SlotMapHandle c = UNWRAP(slotmap_insert(&numbers, 3), return);
+    CSL_TEST_ASSERT(numbers.values == values && *slotmap_get(&numbers, c) == 3, "Memory is kept and reused");
+    slotmap_free(&numbers);
+}
+
+void test_generation_wrap() {
+    SLOTMAP(int) numbers = {0};
+    SlotMapHandle a = UNWRAP(slotmap_insert(&numbers, 1), return);
+    /* Pretend the slot has been reused ~4 billion times */
+    numbers.index.slots[a.index].generation = UINT32_MAX;
+    a.generation = UINT32_MAX;
+    CSL_TEST_ASSERT(slotmap_erase(&numbers, a), "Erase at the last generation");
+    SlotMapHandle b = UNWRAP(slotmap_insert(&numbers, 2), return);
+    CSL_TEST_ASSERT(b.index != a.index, "Wrapped slot is retired instead of reused");
+    CSL_TEST_ASSERT(!slotmap_contains(&numbers, ((SlotMapHandle){ .index = a.index, .generation = 1 })),
+        "Retired slot matches no handle");
+    slotmap_free(&numbers);
+}
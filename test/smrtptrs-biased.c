@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_BIASED_REFCOUNT
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+
+#include "../csl-smrtptrs.h"
+
+#define WORKERS 4
+#define ROUNDS 100000
+
+void test_owner();
+void test_handoff();
+void test_dropped_elsewhere();
+void test_owner_exit();
+void test_weak();
+void test_revived();
+void test_stress();
+
+static atomic_int destroyed;
+
+static void count_free(void* ptr) {
+    atomic_fetch_add(&destroyed, 1);
+    free(ptr);
+}
+
+/* The typed pointers have const members, so the tests that pass pointers between
+ * threads use the generic layout and drop them by hand */
+static _generic_atomic_shared_ptr make_int(int value) {
+    _generic_atomic_shared_ptr ptr = _smrtptr_make_strong_atomic(malloc(sizeof(int)), count_free).generic;
+    *(int*)ptr.ptr = value;
+    return ptr;
+}
+
+static _generic_atomic_shared_ptr copy_int(_generic_atomic_shared_ptr ptr) {
+    return _smrtptr_copy_strong_atomic(
+        (union smrtptr_strong_atomic_types)ptr, SMRTPTR_STRONG_ATOMIC
+    ).SMRTPTR_STRONG_ATOMIC_FIELD.generic;
+}
+
+static void* run(void* (*fn)(void*), void* arg) {
+    pthread_t thread;
+    void* ret;
+    pthread_create(&thread, NULL, fn, arg);
+    pthread_join(thread, &ret);
+    return ret;
+}
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_owner();
+    test_handoff();
+    test_dropped_elsewhere();
+    test_owner_exit();
+    test_weak();
+    test_revived();
+    test_stress();
+
+    return 0;
+}
+
+void test_owner() {
+    atomic_store(&destroyed, 0);
+    {
+        smrtptr_strong_atomic(int) a = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), count_free);
+        smrtptr_strong_atomic(int) b = smrtptr_copy_strong_atomic(int, a, SMRTPTR_STRONG_ATOMIC);
+        smrtptr_strong_atomic(int) c = smrtptr_copy_strong_atomic(int, b, SMRTPTR_STRONG_ATOMIC);
+        CSL_TEST_ASSERT(a.ctrl->nbiased == 3, "Owner copies only touch the biased count");
+        CSL_TEST_ASSERT(atomic_load(&a.ctrl->nshared) == 0, "Shared count untouched by the owner");
+    }
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed once the owner drops the last copy");
+}
+
+/* The worker copies and drops a pointer the owner copied for it, so its count goes negative */
+static void* drop_twice(void* arg) {
+    _generic_atomic_shared_ptr* given = arg;
+    _generic_atomic_shared_ptr extra = copy_int(*given);
+    smrtptr_free_strong_atomic(&extra);
+    smrtptr_free_strong_atomic(given);
+    return NULL;
+}
+
+void test_handoff() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr a = make_int(1);
+    _generic_atomic_shared_ptr b = copy_int(a);
+    atomic_shared_ptr_ctrlblk* ctrl = a.ctrl;
+    run(drop_twice, &b);
+    intptr_t shared = atomic_load(&ctrl->nshared);
+    CSL_TEST_ASSERT(SMRTPTR_BRC_COUNT(shared) == -1, "Other thread's count is negative");
+    CSL_TEST_ASSERT(shared & SMRTPTR_BRC_QUEUED, "Object was queued for the owner");
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Still alive while the owner holds a copy");
+    smrtptr_free_strong_atomic(&a);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Owner's drop merges and destroys");
+}
+
+void test_dropped_elsewhere() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr a = make_int(2);
+    _generic_atomic_shared_ptr b = copy_int(a);
+    smrtptr_free_strong_atomic(&a);
+    CSL_TEST_ASSERT(b.ctrl->nbiased == 1, "Owner count still includes the given copy");
+    _generic_atomic_shared_ptr* given = &b;
+    run(drop_twice, given);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Last drop on another thread waits for the owner");
+    smrtptr_merge_biased();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Merging the queue destroys it");
+}
+
+static _generic_atomic_shared_ptr orphan;
+
+static void* make_and_exit(void* arg) {
+    (void)arg;
+    orphan = make_int(3);
+    return orphan.ctrl;
+}
+
+void test_owner_exit() {
+    atomic_store(&destroyed, 0);
+    atomic_shared_ptr_ctrlblk* ctrl = run(make_and_exit, NULL);
+    CSL_TEST_ASSERT(ctrl->nbiased == 1, "Exited owner left its count biased");
+    _generic_atomic_shared_ptr copy = copy_int(orphan);
+    CSL_TEST_ASSERT(*(int*)copy.ptr == 3, "Object outlives its owner thread");
+    smrtptr_free_strong_atomic(&copy);
+    smrtptr_free_strong_atomic(&orphan);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Merged and destroyed by the last non-owner drop");
+}
+
+static void* lock_weak(void* arg) {
+    smrtptr_strong_atomic(int) locked = {0};
+    if(!smrtptr_lock_weak_atomic(&locked, arg)) return NULL;
+    return (void*)(intptr_t)*locked.ptr;
+}
+
+void test_weak() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr a = make_int(42);
+    _generic_atomic_shared_ptr weak = _smrtptr_copy_strong_atomic(
+        (union smrtptr_strong_atomic_types)a, SMRTPTR_WEAK_ATOMIC
+    ).SMRTPTR_WEAK_ATOMIC_FIELD.generic;
+    CSL_TEST_ASSERT((intptr_t)run(lock_weak, &weak) == 42, "Another thread locks a live object");
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Lock and drop from another thread keeps it alive");
+    smrtptr_free_strong_atomic(&a);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed after the owner's last drop");
+    atomic_shared_ptr_ctrlblk* ctrl = weak.ctrl;
+    CSL_TEST_ASSERT(run(lock_weak, &weak) == NULL, "Locking a dead object fails");
+    weak.ctrl = ctrl;
+    smrtptr_free_weak_atomic(&weak);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed exactly once");
+}
+
+static void* drop_given(void* arg) {
+    smrtptr_free_strong_atomic(arg);
+    return NULL;
+}
+
+/* Locks the weak pointer and hands the reference back instead of dropping it */
+static void* lock_and_keep(void* arg) {
+    _generic_atomic_shared_ptr* locked = malloc(sizeof(_generic_atomic_shared_ptr));
+    if(!_smrtptr_lock_weak_atomic((union smrtptr_strong_atomic_types*)locked, arg)) {
+        free(locked);
+        return NULL;
+    }
+    return locked;
+}
+
+void test_revived() {
+    atomic_store(&destroyed, 0);
+    size_t nobody_refs = atomic_load(&smrtptr_brc_nobody.refs);
+    _generic_atomic_shared_ptr a = make_int(5);
+    _generic_atomic_shared_ptr given = copy_int(a);
+    _generic_atomic_shared_ptr weak = _smrtptr_copy_strong_atomic(
+        (union smrtptr_strong_atomic_types)a, SMRTPTR_WEAK_ATOMIC
+    ).SMRTPTR_WEAK_ATOMIC_FIELD.generic;
+    atomic_shared_ptr_ctrlblk* ctrl = a.ctrl;
+    smrtptr_free_strong_atomic(&a);
+    /* Another thread drops the owner's copy: queued with a count of -1 */
+    run(drop_given, &given);
+    CSL_TEST_ASSERT(atomic_load(&ctrl->nshared) & SMRTPTR_BRC_QUEUED, "Object is queued for the owner");
+    /* A third thread revives it through the weak pointer, bringing the count back to 0 */
+    _generic_atomic_shared_ptr* locked = run(lock_and_keep, &weak);
+    CSL_TEST_ASSERT(locked != NULL && *(int*)locked->ptr == 5, "Queued object can still be locked");
+    CSL_TEST_ASSERT(ctrl->nbiased == 1, "Owner count untouched by the lock");
+    /* The owner's count hits 0 while the object is still on its queue */
+    smrtptr_free_strong_atomic(locked);
+    free(locked);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed exactly once by the owner's last drop");
+    CSL_TEST_ASSERT(atomic_load(&smrtptr_brc_nobody.refs) == nobody_refs, "Owner references balanced");
+    smrtptr_free_weak_atomic(&weak);
+}
+
+static void* hammer(void* arg) {
+    _generic_atomic_shared_ptr* mine = arg;
+    for(size_t i = 0; i < ROUNDS; i++) {
+        _generic_atomic_shared_ptr copy = copy_int(*mine);
+        if(*(int*)copy.ptr != 7) abort();
+        smrtptr_free_strong_atomic(&copy);
+    }
+    smrtptr_free_strong_atomic(mine);
+    return NULL;
+}
+
+void test_stress() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr owner = make_int(7);
+    _generic_atomic_shared_ptr given[WORKERS];
+    pthread_t threads[WORKERS];
+    for(size_t i = 0; i < WORKERS; i++) {
+        given[i] = copy_int(owner);
+        pthread_create(&threads[i], NULL, hammer, &given[i]);
+    }
+    for(size_t i = 0; i < ROUNDS; i++) {
+        _generic_atomic_shared_ptr copy = copy_int(owner);
+        smrtptr_free_strong_atomic(&copy);
+    }
+    for(size_t i = 0; i < WORKERS; i++) pthread_join(threads[i], NULL);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Alive while the owner holds it");
+    smrtptr_free_strong_atomic(&owner);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed exactly once after mixed copies and drops");
+}
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_DEFERRED_DESTROY
+
+typedef struct {
+    size_t id;
+    void* child;        // a strong atomic pointer dropped by the finalizer, or NULL
+} Graph;
+
+#define SHARED_PTR_TYPE_LIST \
+    SHARED_PTR_DERIVE(int)
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int) \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(Graph)
+
+#include "../csl-smrtptrs.h"
+
+#define WORKERS 3
+#define DROPS 20000
+
+void test_deferred();
+void test_weak();
+void test_order();
+void test_cascade();
+void test_thread_exit();
+void test_reclaimer();
+
+static atomic_size_t destroyed;
+static _Atomic(pthread_t) destroyed_on;
+
+static void count_free(void* ptr) {
+    atomic_fetch_add(&destroyed, 1);
+    atomic_store(&destroyed_on, pthread_self());
+    free(ptr);
+}
+
+static size_t order[4];
+static size_t norder;
+
+static void record_order(void* ptr) {
+    order[norder++] = *(size_t*)ptr;
+}
+
+static void finalize_graph(void* ptr) {
+    Graph* graph = ptr;
+    if(graph->child != NULL) {
+        _generic_atomic_shared_ptr* child = graph->child;
+        smrtptr_free_strong_atomic(child);
+        free(child);
+    }
+    atomic_fetch_add(&destroyed, 1);
+}
+
+/* The typed pointers have const members, so the tests that pass pointers between
+ * threads use the generic layout and drop them by hand */
+static _generic_atomic_shared_ptr make_int(int value) {
+    _generic_atomic_shared_ptr ptr = _smrtptr_make_strong_atomic(malloc(sizeof(int)), count_free).generic;
+    *(int*)ptr.ptr = value;
+    return ptr;
+}
+
+static void* run(void* (*fn)(void*), void* arg) {
+    pthread_t thread;
+    void* ret;
+    pthread_create(&thread, NULL, fn, arg);
+    pthread_join(thread, &ret);
+    return ret;
+}
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_deferred();
+    test_weak();
+    test_order();
+    test_cascade();
+    test_thread_exit();
+    test_reclaimer();
+
+    return 0;
+}
+
+void test_deferred() {
+    atomic_store(&destroyed, 0);
+    {
+        smrtptr_strong(int) local = smrtptr_make_strong(int, malloc(sizeof(int)), count_free);
+        *local.ptr = 1;
+    }
+    {
+        smrtptr_strong_atomic(int) shared = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), count_free);
+        *shared.ptr = 2;
+    }
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Dropping the last reference only queues the object");
+    CSL_TEST_ASSERT(atomic_load(&smrtptr_defer_self->queue) != NULL, "Queued on the dropping thread");
+    CSL_TEST_ASSERT(smrtptr_drain() == 2, "Drain destroys both");
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 2, "Destructors ran");
+    CSL_TEST_ASSERT(smrtptr_drain() == 0, "Nothing left to drain");
+}
+
+void test_weak() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr a = make_int(3);
+    _generic_atomic_shared_ptr weak = _smrtptr_copy_strong_atomic(
+        (union smrtptr_strong_atomic_types)a, SMRTPTR_WEAK_ATOMIC
+    ).SMRTPTR_WEAK_ATOMIC_FIELD.generic;
+    smrtptr_free_strong_atomic(&a);
+    atomic_shared_ptr_ctrlblk* ctrl = weak.ctrl;
+    {
+        smrtptr_strong_atomic(int) locked = {0};
+        CSL_TEST_ASSERT(!smrtptr_lock_weak_atomic(&locked, &weak), "Queued object is already dead to weak pointers");
+        smrtptr_errno = SMRTPTR_NOERR;
+    }
+    smrtptr_errno = SMRTPTR_NOERR;
+    weak.ctrl = ctrl;
+    smrtptr_free_weak_atomic(&weak);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Dropping the weak pointer doesn't free it while queued");
+    CSL_TEST_ASSERT(smrtptr_drain() == 1, "Still drained");
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed once");
+
+    /* Non-atomic counts can't be shared with the reclaimer, so this one is destroyed inline */
+    {
+        smrtptr_weak(int) local_weak;
+        {
+            smrtptr_strong(int) local = smrtptr_make_strong(int, malloc(sizeof(int)), count_free);
+            local_weak = smrtptr_copy_strong(int, local, SMRTPTR_WEAK);
+        }
+        CSL_TEST_ASSERT(atomic_load(&destroyed) == 2, "smrtptr_strong with weak pointers is destroyed inline");
+    }
+    CSL_TEST_ASSERT(smrtptr_drain() == 0, "And not queued");
+}
+
+void test_order() {
+    norder = 0;
+    for(size_t i = 0; i < 4; i++) {
+        _generic_atomic_shared_ptr ptr = _smrtptr_new_strong_atomic(sizeof(size_t), record_order).generic;
+        *(size_t*)ptr.ptr = i;
+        smrtptr_free_strong_atomic(&ptr);
+    }
+    smrtptr_drain();
+    CSL_TEST_ASSERT(norder == 4 && order[0] == 0 && order[1] == 1 && order[2] == 2 && order[3] == 3,
+        "Destroyed in the order they were dropped");
+}
+
+void test_cascade() {
+    atomic_store(&destroyed, 0);
+    /* A chain of 3 graphs, each holding the only reference to the next */
+    _generic_atomic_shared_ptr* next = NULL;
+    for(size_t i = 0; i < 3; i++) {
+        _generic_atomic_shared_ptr node = _smrtptr_new_strong_atomic(sizeof(Graph), finalize_graph).generic;
+        *(Graph*)node.ptr = (Graph){ .id = i, .child = next };
+        next = malloc(sizeof(_generic_atomic_shared_ptr));
+        *next = node;
+    }
+    smrtptr_free_strong_atomic(next);
+    free(next);
+    CSL_TEST_ASSERT(smrtptr_drain() == 3, "Objects dropped by destructors are drained in the same call");
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 3, "Whole chain destroyed");
+}
+
+static void* drop_and_exit(void* arg) {
+    _generic_atomic_shared_ptr* ptr = arg;
+    smrtptr_free_strong_atomic(ptr);
+    return NULL;
+}
+
+void test_thread_exit() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr a = make_int(4);
+    run(drop_and_exit, &a);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Exited thread's queue is kept");
+    CSL_TEST_ASSERT(smrtptr_drain() == 1, "And drained from another thread");
+    _generic_atomic_shared_ptr b = make_int(5);
+    run(drop_and_exit, &b);
+    CSL_TEST_ASSERT(smrtptr_drain() == 1, "A reused queue works the same");
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 2, "Both destroyed");
+}
+
+static void* drop_many(void* arg) {
+    (void)arg;
+    for(size_t i = 0; i < DROPS; i++) {
+        _generic_atomic_shared_ptr ptr = make_int((int)i);
+        smrtptr_free_strong_atomic(&ptr);
+    }
+    return NULL;
+}
+
+void test_reclaimer() {
+    atomic_store(&destroyed, 0);
+    CSL_TEST_ASSERT(smrtptr_start_reclaimer(), "Reclaimer started");
+    CSL_TEST_ASSERT(smrtptr_start_reclaimer(), "Starting it twice is fine");
+    pthread_t threads[WORKERS];
+    for(size_t i = 0; i < WORKERS; i++) pthread_create(&threads[i], NULL, drop_many, NULL);
+    for(size_t i = 0; i < WORKERS; i++) pthread_join(threads[i], NULL);
+    smrtptr_stop_reclaimer();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == WORKERS * DROPS, "Everything destroyed by the time it stops");
+    bool elsewhere = true;
+    for(size_t i = 0; i < WORKERS; i++) {
+        if(pthread_equal(atomic_load(&destroyed_on), threads[i])) elsewhere = false;
+    }
+    CSL_TEST_ASSERT(elsewhere && !pthread_equal(atomic_load(&destroyed_on), pthread_self()),
+        "Destructors ran on the reclaimer thread");
+    smrtptr_stop_reclaimer();
+}
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_HAZARD
+
+typedef struct {
+    size_t value;
+    size_t check;       // always value * 5, to catch reads of destroyed objects
+} Payload;
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(Payload)
+
+#include "../csl-smrtptrs.h"
+
+#define LOCKERS 3
+#define ROUNDS 2000
+
+void test_deferred();
+void test_lock();
+void test_protect();
+void test_stress();
+
+static atomic_size_t destroyed;
+
+static void finalize_payload(void* ptr) {
+    Payload* payload = ptr;
+    payload->check = 0;
+    atomic_fetch_add(&destroyed, 1);
+}
+
+/* The typed pointers have const members, so the tests that pass pointers between
+ * threads use the generic layout and drop them by hand */
+static _generic_atomic_shared_ptr make_payload(size_t value) {
+    _generic_atomic_shared_ptr ptr = _smrtptr_new_strong_atomic(sizeof(Payload), finalize_payload).generic;
+    *(Payload*)ptr.ptr = (Payload){ .value = value, .check = value * 5 };
+    return ptr;
+}
+
+static _generic_atomic_shared_ptr weak_of(_generic_atomic_shared_ptr ptr) {
+    return _smrtptr_copy_strong_atomic(
+        (union smrtptr_strong_atomic_types)ptr, SMRTPTR_WEAK_ATOMIC
+    ).SMRTPTR_WEAK_ATOMIC_FIELD.generic;
+}
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_deferred();
+    test_lock();
+    test_protect();
+    test_stress();
+
+    return 0;
+}
+
+void test_deferred() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr a = make_payload(1);
+    atomic_shared_ptr_ctrlblk* ctrl = a.ctrl;
+    smrtptr_free_strong_atomic(&a);
+    CSL_TEST_ASSERT(atomic_load(&ctrl->nstrong) == SMRTPTR_STRONG_DEAD, "Last drop marks the count dead");
+    CSL_TEST_ASSERT(hazard_pending() == 1, "Destruction retired instead of run");
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed once scanned");
+}
+
+void test_lock() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr a = make_payload(2);
+    _generic_atomic_shared_ptr weak = weak_of(a);
+    {
+        smrtptr_strong_atomic(Payload) locked = {0};
+        CSL_TEST_ASSERT(smrtptr_lock_weak_atomic(&locked, &weak), "Locks a live object");
+        CSL_TEST_ASSERT(locked.ptr->value == 2, "Locked pointer reaches the object");
+        CSL_TEST_ASSERT(atomic_load(&a.ctrl->nstrong) == 2, "Lock adds one strong reference");
+    }
+    smrtptr_free_strong_atomic(&a);
+    atomic_shared_ptr_ctrlblk* ctrl = weak.ctrl;
+    {
+        smrtptr_strong_atomic(Payload) locked = {0};
+        CSL_TEST_ASSERT(!smrtptr_lock_weak_atomic(&locked, &weak), "Locking a dead object fails");
+        smrtptr_errno = SMRTPTR_NOERR;
+    }
+    smrtptr_errno = SMRTPTR_NOERR;
+    CSL_TEST_ASSERT(atomic_load(&ctrl->nstrong) & SMRTPTR_STRONG_DEAD, "Failed lock leaves it dead");
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed exactly once");
+    weak.ctrl = ctrl;
+    smrtptr_free_weak_atomic(&weak);
+
+    /* A lock between the last decrement and the DEAD flag revives the object */
+    a = make_payload(3);
+    weak = weak_of(a);
+    atomic_store(&a.ctrl->nstrong, 0);
+    CSL_TEST_ASSERT(smrtptr_strong_atomic_try_inc(a.ctrl), "Lock at a count of 0 without DEAD succeeds");
+    smrtptr_strong_atomic_dec(a.ctrl, a.ptr);
+    CSL_TEST_ASSERT(atomic_load(&a.ctrl->nstrong) == SMRTPTR_STRONG_DEAD, "The revived reference kills it");
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 2, "Destroyed once");
+    smrtptr_free_weak_atomic(&weak);
+}
+
+void test_protect() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr weak;
+    Payload* borrowed;
+    {
+        smrtptr_strong_atomic(Payload) a = smrtptr_new_strong_atomic(Payload, finalize_payload);
+        a.ptr->value = 4;
+        a.ptr->check = 20;
+        weak = weak_of((_generic_atomic_shared_ptr){ .ptr = a.ptr, .ctrl = a.ctrl });
+        borrowed = smrtptr_protect_weak_atomic(Payload, 0, &weak);
+        CSL_TEST_ASSERT(borrowed == a.ptr, "Protect borrows the object");
+        CSL_TEST_ASSERT(atomic_load(&a.ctrl->nstrong) == 1, "Without touching the strong count");
+    }
+    hazard_scan();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Not destroyed while borrowed");
+    CSL_TEST_ASSERT(borrowed->check == 20, "Borrowed object still readable");
+    CSL_TEST_ASSERT(smrtptr_protect_weak_atomic(Payload, 1, &weak) == NULL, "Protecting a dead object fails");
+    hazard_clear(0);
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Destroyed once the hazard is cleared");
+    smrtptr_free_weak_atomic(&weak);
+}
+
+/* Lockers race the main thread dropping the last strong reference */
+static _generic_atomic_shared_ptr round_weak;
+static atomic_size_t round_started;
+static atomic_size_t round_done;
+
+static void* locker(void* arg) {
+    size_t id = (size_t)arg;
+    size_t bad = 0;
+    for(size_t round = 1; round <= ROUNDS; round++) {
+        while(atomic_load(&round_started) < round) sched_yield();
+        _generic_atomic_shared_ptr weak = round_weak;
+        for(size_t i = 0; i < 8; i++) {
+            if(id % 2) {
+                Payload* payload = smrtptr_protect_weak_atomic(Payload, 0, &weak);
+                if(payload != NULL && payload->check != payload->value * 5) bad++;
+                hazard_clear(0);
+            }
+            else {
+                _generic_atomic_shared_ptr locked = {0};
+                if(!smrtptr_lock_weak_atomic(&locked, &weak)) break;
+                Payload* payload = locked.ptr;
+                if(payload->check != payload->value * 5) bad++;
+                smrtptr_free_strong_atomic(&locked);
+            }
+        }
+        atomic_fetch_add(&round_done, 1);
+    }
+    return (void*)bad;
+}
+
+void test_stress() {
+    atomic_store(&destroyed, 0);
+    pthread_t threads[LOCKERS];
+    for(size_t i = 0; i < LOCKERS; i++) pthread_create(&threads[i], NULL, locker, (void*)i);
+    for(size_t round = 1; round <= ROUNDS; round++) {
+        _generic_atomic_shared_ptr a = make_payload(round);
+        round_weak = weak_of(a);
+        atomic_store(&round_started, round);
+        smrtptr_free_strong_atomic(&a);
+        while(atomic_load(&round_done) < round * LOCKERS) sched_yield();
+        smrtptr_free_weak_atomic(&round_weak);
+    }
+    size_t bad = 0;
+    for(size_t i = 0; i < LOCKERS; i++) {
+        void* ret;
+        pthread_join(threads[i], &ret);
+        bad += (size_t)ret;
+    }
+    CSL_TEST_ASSERT(bad == 0, "Locked and borrowed objects are never destroyed under a reader");
+    hazard_barrier();
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == ROUNDS, "Every object destroyed exactly once");
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_PADDED_CTRLBLK
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+
+#include "../csl-smrtptrs.h"
+
+void test_layout();
+void test_lifetime();
+
+static int destroyed;
+
+static void count_free(void* ptr) {
+    destroyed++;
+    free(ptr);
+}
+
+static void count_finalize(void* ptr) {
+    (void)ptr;
+    destroyed++;
+}
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_layout();
+    test_lifetime();
+
+    return 0;
+}
+
+void test_layout() {
+    CSL_TEST_ASSERT(_Alignof(atomic_shared_ptr_ctrlblk) == SMRTPTR_CACHE_LINE, "Control block is line aligned");
+    CSL_TEST_ASSERT(
+        offsetof(atomic_shared_ptr_ctrlblk, nweak) - offsetof(atomic_shared_ptr_ctrlblk, nstrong) == SMRTPTR_CACHE_LINE,
+        "Strong and weak counts are on separate lines"
+    );
+    smrtptr_strong_atomic(int) a = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), free);
+    smrtptr_strong_atomic(int) b = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), free);
+    CSL_TEST_ASSERT((uintptr_t)a.ctrl % SMRTPTR_CACHE_LINE == 0, "Allocated control block is line aligned");
+    CSL_TEST_ASSERT(
+        (char*)b.ctrl - (char*)a.ctrl >= (ptrdiff_t)sizeof(atomic_shared_ptr_ctrlblk) ||
+        (char*)a.ctrl - (char*)b.ctrl >= (ptrdiff_t)sizeof(atomic_shared_ptr_ctrlblk),
+        "Neighbouring control blocks don't share lines"
+    );
+    smrtptr_strong_atomic(int) c = smrtptr_new_strong_atomic(int, NULL);
+    CSL_TEST_ASSERT((uintptr_t)c.ctrl % SMRTPTR_CACHE_LINE == 0, "Inline object block is line aligned");
+    CSL_TEST_ASSERT((char*)c.ptr - (char*)c.ctrl == (ptrdiff_t)sizeof(atomic_shared_ptr_ctrlblk),
+        "Inline object follows the control block");
+}
+
+void test_lifetime() {
+    destroyed = 0;
+    {
+        smrtptr_strong_atomic(int) a = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), count_free);
+        smrtptr_weak_atomic(int) weak = smrtptr_copy_strong_atomic(int, a, SMRTPTR_WEAK_ATOMIC);
+        {
+            smrtptr_strong_atomic(int) b = smrtptr_copy_strong_atomic(int, a, SMRTPTR_STRONG_ATOMIC);
+            *b.ptr = 5;
+            CSL_TEST_ASSERT(*a.ptr == 5, "Copies share the object");
+            CSL_TEST_ASSERT(atomic_load(&a.ctrl->nstrong) == 2, "Strong count");
+            CSL_TEST_ASSERT(atomic_load(&a.ctrl->nweak) == 2, "Weak count");
+        }
+        CSL_TEST_ASSERT(atomic_load(&a.ctrl->nstrong) == 1, "Copy dropped");
+        smrtptr_strong_atomic(int) n = smrtptr_new_strong_atomic(int, count_finalize);
+    }
+    CSL_TEST_ASSERT(destroyed == 2, "Both objects destroyed once");
+}
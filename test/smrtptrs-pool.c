@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_POOL_CTRLBLK
+
+#define SHARED_PTR_TYPE_LIST \
+    SHARED_PTR_DERIVE(int)
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+
+#include "../csl-smrtptrs.h"
+
+#define HANDOFFS 20000
+
+void test_reuse();
+void test_new_strong();
+void test_cross_thread();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_reuse();
+    test_new_strong();
+    test_cross_thread();
+
+    return 0;
+}
+
+void test_reuse() {
+    void* first = NULL;
+    {
+        smrtptr_strong(int) a = smrtptr_make_strong(int, malloc(sizeof(int)), free);
+        CSL_TEST_ASSERT(a.ctrl->pooled, "Control block should come from the pool");
+        first = a.ctrl;
+    }
+    smrtptr_strong(int) b = smrtptr_make_strong(int, malloc(sizeof(int)), free);
+    CSL_TEST_ASSERT((void*)b.ctrl == first, "Freed block is reused first");
+    smrtptr_pool_stats stats = smrtptr_pool_get_stats();
+    CSL_TEST_ASSERT(stats.slabs == 1 && stats.in_use == 1, "One slab, one block in use");
+    {
+        smrtptr_strong_atomic(int) c = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), free);
+        smrtptr_weak_atomic(int) w = smrtptr_copy_strong_atomic(int, c, SMRTPTR_WEAK_ATOMIC);
+        CSL_TEST_ASSERT(c.ctrl->pooled, "Atomic control blocks are pooled too");
+        CSL_TEST_ASSERT(smrtptr_pool_get_stats().in_use == 2, "Two blocks in use");
+    }
+    CSL_TEST_ASSERT(smrtptr_pool_get_stats().in_use == 1, "Block returned once the weak pointer is gone");
+}
+
+typedef struct {
+    char bytes[256];
+} Large;
+
+void test_new_strong() {
+    smrtptr_strong(int) small = smrtptr_new_strong(int, NULL);
+    CSL_TEST_ASSERT(small.ctrl->pooled && *small.ptr == 0, "Small inline objects fit in a pool block");
+    union smrtptr_strong_types large = _smrtptr_new_strong(sizeof(Large), NULL);
+    CSL_TEST_ASSERT(large.generic.ctrl != NULL && !large.generic.ctrl->pooled, "Large objects fall back to malloc");
+    smrtptr_free_strong(&large);
+}
+
+/* The producer makes pointers and the consumer drops them, so every block is
+ * freed on a different thread than the one that allocated it */
+static _generic_atomic_shared_ptr slots[HANDOFFS];
+static atomic_int state[HANDOFFS];    // 0 empty, 1 ready, 2 dropped
+
+static void* producer(void* arg) {
+    (void)arg;
+    for(size_t i = 0; i < HANDOFFS; i++) {
+        /* Keep the number of pointers in flight bounded */
+        while(i >= 512 && atomic_load_explicit(&state[i - 512], memory_order_acquire) != 2);
+        slots[i] = _smrtptr_make_strong_atomic(malloc(sizeof(int)), free).generic;
+        *(int*)slots[i].ptr = (int)i;
+        atomic_store_explicit(&state[i], 1, memory_order_release);
+    }
+    return NULL;
+}
+
+static void* consumer(void* arg) {
+    size_t* bad = arg;
+    for(size_t i = 0; i < HANDOFFS; i++) {
+        while(atomic_load_explicit(&state[i], memory_order_acquire) != 1);
+        if(*(int*)slots[i].ptr != (int)i) (*bad)++;
+        smrtptr_free_strong_atomic(&slots[i]);
+        atomic_store_explicit(&state[i], 2, memory_order_release);
+    }
+    return NULL;
+}
+
+void test_cross_thread() {
+    smrtptr_pool_stats before = smrtptr_pool_get_stats();
+    size_t bad = 0;
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, producer, NULL);
+    pthread_create(&threads[1], NULL, consumer, &bad);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    smrtptr_pool_stats after = smrtptr_pool_get_stats();
+    CSL_TEST_ASSERT(bad == 0, "Objects arrive intact");
+    CSL_TEST_ASSERT(after.threads == before.threads, "Exited threads leave the registry");
+    CSL_TEST_ASSERT(after.in_use == before.in_use, "Every block was returned");
+    CSL_TEST_ASSERT(after.slabs - before.slabs < HANDOFFS / SMRTPTR_POOL_SLAB_BLOCKS / 2,
+        "Blocks freed on the consumer flow back to the producer in batches");
+    CSL_TEST_ASSERT(after.central > 0, "Exited threads hand their lists to the central list");
+}
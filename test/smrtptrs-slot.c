@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+
+typedef struct {
+    size_t version;
+    size_t check;       // always version * 3, to catch torn or freed snapshots
+} Snapshot;
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(Snapshot)
+
+#include "../csl-smrtptrs.h"
+
+#define READERS 3
+#define VERSIONS 20000
+
+void test_basic();
+void test_compare_exchange();
+void test_concurrent();
+
+static atomic_size_t destroyed;
+
+static void finalize_snapshot(void* ptr) {
+    Snapshot* snapshot = ptr;
+    snapshot->check = 0;
+    atomic_fetch_add(&destroyed, 1);
+}
+
+static _generic_atomic_shared_ptr make_snapshot(size_t version) {
+    _generic_atomic_shared_ptr ptr = _smrtptr_new_strong_atomic(sizeof(Snapshot), finalize_snapshot).generic;
+    *(Snapshot*)ptr.ptr = (Snapshot){ .version = version, .check = version * 3 };
+    return ptr;
+}
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_basic();
+    test_compare_exchange();
+    test_concurrent();
+
+    return 0;
+}
+
+void test_basic() {
+    atomic_store(&destroyed, 0);
+    smrtptr_atomic_slot slot = SMRTPTR_SLOT_INIT;
+    {
+        smrtptr_strong_atomic(Snapshot) empty = smrtptr_slot_load(Snapshot, &slot);
+        CSL_TEST_ASSERT(empty.ctrl == NULL, "Empty slot loads an empty pointer");
+        smrtptr_errno = SMRTPTR_NOERR;
+    }
+    smrtptr_errno = SMRTPTR_NOERR;
+    {
+        smrtptr_strong_atomic(Snapshot) first = smrtptr_new_strong_atomic(Snapshot, finalize_snapshot);
+        first.ptr->version = 1;
+        smrtptr_slot_store(&slot, first);
+        CSL_TEST_ASSERT(atomic_load(&first.ctrl->nstrong) == 2, "Slot holds its own reference");
+    }
+    {
+        smrtptr_strong_atomic(Snapshot) loaded = smrtptr_slot_load(Snapshot, &slot);
+        CSL_TEST_ASSERT(loaded.ptr->version == 1, "Load returns the stored pointer");
+        CSL_TEST_ASSERT(atomic_load(&loaded.ctrl->nstrong) == 2, "Load takes a strong reference");
+        CSL_TEST_ASSERT(atomic_load(&slot.word) >> SMRTPTR_SLOT_SHIFT == 0, "External count given back");
+        smrtptr_strong_atomic(Snapshot) second = smrtptr_new_strong_atomic(Snapshot, finalize_snapshot);
+        second.ptr->version = 2;
+        smrtptr_strong_atomic(Snapshot) old = smrtptr_slot_exchange(Snapshot, &slot, second);
+        CSL_TEST_ASSERT(old.ptr == loaded.ptr, "Exchange returns the previous pointer");
+        CSL_TEST_ASSERT(atomic_load(&destroyed) == 0, "Old snapshot alive while referenced");
+    }
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 1, "Old snapshot destroyed with its last reference");
+    smrtptr_slot_reset(&slot);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 2, "Reset drops the slot's reference");
+}
+
+void test_compare_exchange() {
+    atomic_store(&destroyed, 0);
+    smrtptr_atomic_slot slot = SMRTPTR_SLOT_INIT;
+    _generic_atomic_shared_ptr a = make_snapshot(1);
+    _generic_atomic_shared_ptr b = make_snapshot(2);
+    _generic_atomic_shared_ptr c = make_snapshot(3);
+    _smrtptr_slot_store(&slot, a);
+    {
+        smrtptr_strong_atomic(Snapshot) expected = smrtptr_slot_load(Snapshot, &slot);
+        CSL_TEST_ASSERT(smrtptr_slot_compare_exchange(&slot, &expected, b), "Swaps when unchanged");
+        CSL_TEST_ASSERT(!smrtptr_slot_compare_exchange(&slot, &expected, c), "Fails after a change");
+        CSL_TEST_ASSERT(expected.ptr->version == 2, "Expected updated to the current pointer");
+        CSL_TEST_ASSERT(atomic_load(&c.ctrl->nstrong) == 1, "Failed swap keeps no reference to desired");
+        CSL_TEST_ASSERT(smrtptr_slot_compare_exchange(&slot, &expected, c), "Swaps with the updated expected");
+    }
+    smrtptr_free_strong_atomic(&a);
+    smrtptr_free_strong_atomic(&b);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 2, "Replaced snapshots destroyed");
+    smrtptr_free_strong_atomic(&c);
+    smrtptr_slot_reset(&slot);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == 3, "Every snapshot destroyed exactly once");
+}
+
+static smrtptr_atomic_slot shared_slot = SMRTPTR_SLOT_INIT;
+static atomic_bool writer_done;
+
+static void* reader(void* arg) {
+    (void)arg;
+    size_t bad = 0;
+    size_t last = 0;
+    while(!atomic_load(&writer_done)) {
+        _generic_atomic_shared_ptr loaded = _smrtptr_slot_load(&shared_slot);
+        Snapshot* snapshot = loaded.ptr;
+        if(snapshot->check != snapshot->version * 3 || snapshot->version < last) bad++;
+        last = snapshot->version;
+        smrtptr_free_strong_atomic(&loaded);
+    }
+    return (void*)bad;
+}
+
+void test_concurrent() {
+    atomic_store(&destroyed, 0);
+    _generic_atomic_shared_ptr first = make_snapshot(0);
+    _smrtptr_slot_store(&shared_slot, first);
+    smrtptr_free_strong_atomic(&first);
+    pthread_t threads[READERS];
+    for(size_t i = 0; i < READERS; i++) pthread_create(&threads[i], NULL, reader, NULL);
+    for(size_t v = 1; v <= VERSIONS; v++) {
+        _generic_atomic_shared_ptr next = make_snapshot(v);
+        _smrtptr_slot_store(&shared_slot, next);
+        smrtptr_free_strong_atomic(&next);
+    }
+    atomic_store(&writer_done, true);
+    size_t bad = 0;
+    for(size_t i = 0; i < READERS; i++) {
+        void* ret;
+        pthread_join(threads[i], &ret);
+        bad += (size_t)ret;
+    }
+    CSL_TEST_ASSERT(bad == 0, "Readers never see a torn, freed or older snapshot");
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == VERSIONS, "Every replaced snapshot destroyed");
+    smrtptr_slot_reset(&shared_slot);
+    CSL_TEST_ASSERT(atomic_load(&destroyed) == VERSIONS + 1, "Last snapshot destroyed on reset");
+}
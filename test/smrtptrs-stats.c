@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "../csl-tests.h"
+
+#define SMRTPTR_IMPLEMENTATION
+#define SMRTPTR_STATS
+
+typedef struct {
+    char bytes[32];
+} Buffer;
+
+#define SHARED_PTR_TYPE_LIST \
+    SHARED_PTR_DERIVE(int) \
+    SHARED_PTR_DERIVE(Buffer)
+
+#define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+
+#include "../csl-smrtptrs.h"
+
+#define WORKERS 4
+#define COPIES 10000
+
+void test_live_peak();
+void test_copies_locks();
+void test_untyped();
+void test_destructors();
+void test_threads();
+void test_total();
+void test_errno();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_live_peak();
+    test_copies_locks();
+    test_untyped();
+    test_destructors();
+    test_threads();
+    test_total();
+    test_errno();
+
+    return 0;
+}
+
+void test_live_peak() {
+    {
+        smrtptr_strong(int) a = smrtptr_make_strong(int, malloc(sizeof(int)), free);
+        smrtptr_strong(int) b = smrtptr_new_strong(int, NULL);
+        smrtptr_stats stats = smrtptr_get_stats(SMRTPTR_STATS_STRONG_int);
+        CSL_TEST_ASSERT(stats.created == 2 && stats.live == 2, "Both makes are counted as int");
+        CSL_TEST_ASSERT(smrtptr_get_stats(SMRTPTR_STATS_STRONG_Buffer).created == 0, "Not as another type");
+    }
+    smrtptr_stats stats = smrtptr_get_stats(SMRTPTR_STATS_STRONG_int);
+    CSL_TEST_ASSERT(stats.live == 0 && stats.freed == 2, "Both freed at the end of the scope");
+    CSL_TEST_ASSERT(stats.peak == 2, "Peak remembers the high water mark");
+    {
+        smrtptr_strong(int) c = smrtptr_make_strong(int, malloc(sizeof(int)), free);
+    }
+    CSL_TEST_ASSERT(smrtptr_get_stats(SMRTPTR_STATS_STRONG_int).peak == 2, "A lower count doesn't move the peak");
+
+    smrtptr_weak(Buffer) weak;
+    {
+        smrtptr_strong(Buffer) buffer = smrtptr_new_strong(Buffer, NULL);
+        weak = smrtptr_copy_strong(Buffer, buffer, SMRTPTR_WEAK);
+    }
+    CSL_TEST_ASSERT(smrtptr_get_stats(SMRTPTR_STATS_STRONG_Buffer).live == 1,
+        "A control block held by a weak pointer is still live");
+}
+
+void test_copies_locks() {
+    _generic_atomic_shared_ptr dead;
+    {
+        smrtptr_strong_atomic(int) a = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), free);
+        smrtptr_weak_atomic(int) weak = smrtptr_copy_strong_atomic(int, a, SMRTPTR_WEAK_ATOMIC);
+        {
+            smrtptr_strong_atomic(int) b = smrtptr_copy_strong_atomic(int, a, SMRTPTR_STRONG_ATOMIC);
+            smrtptr_strong_atomic(int) c = smrtptr_copy_weak_atomic(int, weak, SMRTPTR_STRONG_ATOMIC);
+        }
+        smrtptr_stats stats = smrtptr_get_stats(SMRTPTR_STATS_ATOMIC_int);
+        CSL_TEST_ASSERT(stats.created == 1 && stats.copies == 3, "Weak and strong copies counted");
+        {
+            smrtptr_strong_atomic(int) locked = {0};
+            CSL_TEST_ASSERT(smrtptr_lock_weak_atomic(&locked, &weak), "Lock a live pointer");
+        }
+        CSL_TEST_ASSERT(smrtptr_get_stats(SMRTPTR_STATS_ATOMIC_int).locks == 1, "Successful lock counted");
+        dead = _smrtptr_copy_strong_atomic(
+            (union smrtptr_strong_atomic_types)a, SMRTPTR_WEAK_ATOMIC
+        ).SMRTPTR_WEAK_ATOMIC_FIELD.generic;
+    }
+    atomic_shared_ptr_ctrlblk* ctrl = dead.ctrl;
+    {
+        smrtptr_strong_atomic(int) locked = {0};
+        CSL_TEST_ASSERT(!smrtptr_lock_weak_atomic(&locked, &dead), "Lock a dead pointer");
+    }
+    dead.ctrl = ctrl;
+    smrtptr_free_weak_atomic(&dead);
+    smrtptr_stats stats = smrtptr_get_stats(SMRTPTR_STATS_ATOMIC_int);
+    CSL_TEST_ASSERT(stats.locks == 1 && stats.failed_locks == 1, "Failed lock counted apart");
+    CSL_TEST_ASSERT(stats.copies == 4, "Locks aren't copies");
+    smrtptr_errno = SMRTPTR_NOERR;
+
+    smrtptr_strong(int) d = smrtptr_new_strong(int, NULL);
+    smrtptr_weak(int) w = smrtptr_copy_strong(int, d, SMRTPTR_WEAK);
+    smrtptr_strong(int) e = {0};
+    CSL_TEST_ASSERT(smrtptr_lock_weak(&e, w), "Lock a non-atomic weak pointer");
+    stats = smrtptr_get_stats(SMRTPTR_STATS_STRONG_int);
+    CSL_TEST_ASSERT(stats.copies == 1 && stats.locks == 1, "Non-atomic copies and locks counted");
+}
+
+void test_untyped() {
+    _generic_atomic_shared_ptr ptr = _smrtptr_new_strong_atomic(sizeof(int), NULL).generic;
+    CSL_TEST_ASSERT(smrtptr_get_stats(SMRTPTR_STATS_UNTYPED).live == 1, "Generic make counts as untyped");
+    smrtptr_free_strong_atomic(&ptr);
+    /* A typed make that fails must not leave its tag behind for the next make */
+    {
+        smrtptr_strong_atomic(int) failed = smrtptr_make_strong_atomic(int, NULL, free);
+        CSL_TEST_ASSERT(failed.ctrl == NULL, "Make of NULL fails");
+        smrtptr_errno = SMRTPTR_NOERR;
+    }
+    size_t before = smrtptr_get_stats(SMRTPTR_STATS_ATOMIC_int).created;
+    ptr = _smrtptr_new_strong_atomic(sizeof(int), NULL).generic;
+    smrtptr_free_strong_atomic(&ptr);
+    CSL_TEST_ASSERT(smrtptr_get_stats(SMRTPTR_STATS_ATOMIC_int).created == before, "Tag isn't left over");
+    smrtptr_stats stats = smrtptr_get_stats(SMRTPTR_STATS_UNTYPED);
+    CSL_TEST_ASSERT(stats.created == 2 && stats.live == 0, "Both untyped");
+}
+
+static void slow_free(void* ptr) {
+    struct timespec ts = { .tv_nsec = 2000000 };
+    nanosleep(&ts, NULL);
+    free(ptr);
+}
+
+void test_destructors() {
+    smrtptr_stats before = smrtptr_get_stats(SMRTPTR_STATS_STRONG_Buffer);
+    {
+        smrtptr_strong(Buffer) a = smrtptr_make_strong(Buffer, malloc(sizeof(Buffer)), slow_free);
+        smrtptr_strong(Buffer) b = smrtptr_new_strong(Buffer, NULL);
+    }
+    smrtptr_stats stats = smrtptr_get_stats(SMRTPTR_STATS_STRONG_Buffer);
+    CSL_TEST_ASSERT(stats.destructor_calls == before.destructor_calls + 1, "NULL destructors aren't counted");
+    CSL_TEST_ASSERT(stats.destructor_ns - before.destructor_ns >= 2000000, "Time in the destructor is counted");
+}
+
+static void* copy_many(void* arg) {
+    _generic_atomic_shared_ptr* shared = arg;
+    for(size_t i = 0; i < COPIES; i++) {
+        _generic_atomic_shared_ptr copy = _smrtptr_copy_strong_atomic(
+            (union smrtptr_strong_atomic_types)*shared, SMRTPTR_STRONG_ATOMIC
+        ).SMRTPTR_STRONG_ATOMIC_FIELD.generic;
+        smrtptr_free_strong_atomic(&copy);
+    }
+    return NULL;
+}
+
+void test_threads() {
+    size_t before = smrtptr_get_stats(SMRTPTR_STATS_ATOMIC_int).copies;
+    _generic_atomic_shared_ptr shared;
+    {
+        smrtptr_strong_atomic(int) made = smrtptr_make_strong_atomic(int, malloc(sizeof(int)), free);
+        shared = _smrtptr_copy_strong_atomic(
+            (union smrtptr_strong_atomic_types)made, SMRTPTR_STRONG_ATOMIC
+        ).SMRTPTR_STRONG_ATOMIC_FIELD.generic;
+    }
+    pthread_t threads[WORKERS];
+    for(size_t i = 0; i < WORKERS; i++) pthread_create(&threads[i], NULL, copy_many, &shared);
+    for(size_t i = 0; i < WORKERS; i++) pthread_join(threads[i], NULL);
+    smrtptr_free_strong_atomic(&shared);
+    smrtptr_stats stats = smrtptr_get_stats(SMRTPTR_STATS_ATOMIC_int);
+    CSL_TEST_ASSERT(stats.copies == before + 1 + WORKERS * COPIES, "Shards of exited threads are merged");
+    CSL_TEST_ASSERT(stats.live == 0, "Freed");
+}
+
+void test_total() {
+    smrtptr_stats total = smrtptr_get_stats_total();
+    size_t created = 0, copies = 0;
+    for(size_t type = 0; type < SMRTPTR_STATS_NTYPES; type++) {
+        smrtptr_stats stats = smrtptr_get_stats(type);
+        created += stats.created;
+        copies += stats.copies;
+    }
+    CSL_TEST_ASSERT(total.created == created && total.copies == copies, "Total is the sum of every type");
+    CSL_TEST_ASSERT(total.live == total.created - total.freed, "Total live matches made - freed");
+    CSL_TEST_ASSERT(total.peak >= smrtptr_get_stats(SMRTPTR_STATS_STRONG_int).peak, "Total peak covers each type");
+    CSL_TEST_ASSERT(strcmp(smrtptr_stats_names[SMRTPTR_STATS_ATOMIC_int], "atomic int") == 0, "Type names");
+    smrtptr_print_stats(stdout);
+}
+
+static void* flag_error(void* arg) {
+    (void)arg;
+    union smrtptr_strong_atomic_types failed = _smrtptr_make_strong_atomic(NULL, free);
+    (void)failed;
+    return (void*)(uintptr_t)smrtptr_errno;
+}
+
+void test_errno() {
+    smrtptr_errno = SMRTPTR_NOERR;
+    pthread_t thread;
+    void* error;
+    pthread_create(&thread, NULL, flag_error, NULL);
+    pthread_join(thread, &error);
+    CSL_TEST_ASSERT((uintptr_t)error == SMRTPTR_MAKE_RECIEVED_NULL, "Error flagged on the other thread");
+    CSL_TEST_ASSERT(smrtptr_errno == SMRTPTR_NOERR, "smrtptr_errno is per thread");
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
 
 #define SMRTPTR_IMPLEMENTATION
 
@@ -8,11 +9,18 @@
     SMRTPTR_DERIVE_UNIQUE(int) \
     SMRTPTR_DERIVE_UNIQUE(FILE)
 
+typedef struct {
+    int* data;
+    double weight;
+} Buffer;
+
 #define SHARED_PTR_TYPE_LIST \
-    SHARED_PTR_DERIVE(int)
+    SHARED_PTR_DERIVE(int) \
+    SHARED_PTR_DERIVE(Buffer)
 
 #define SMRTPTR_SHARED_ATOMIC_TYPE_LIST \
-    SMRTPTR_DERIVE_SHARED_ATOMIC(int)
+    SMRTPTR_DERIVE_SHARED_ATOMIC(int) \
+    SMRTPTR_DERIVE_SHARED_ATOMIC(Buffer)
 
 #define SMRTPTR_RELAY_TYPE_LIST \
     SMRTPTR_DERIVE_RELAY(int)
@@ -27,6 +35,14 @@ void close_file(void* void_fp) {
 
 #include "../csl-smrtptrs.h"
 
+/* Releases what a Buffer owns, the Buffer itself lives in the control block */
+static int buffers_finalized = 0;
+void finalize_buffer(void* void_buffer) {
+    Buffer* buffer = void_buffer;
+    free(buffer->data);
+    buffers_finalized++;
+}
+
 int main() {
     {
         smrtptr_unique(int) ptr1 = smrtptr_make_unique(int, malloc(sizeof(int)), free);
@@ -90,6 +106,44 @@ int main() {
             printf("ptr7: %d\n", deref_smrtptr(ptr7));
         }
     }
+    {
+        // Object and control block in one allocation
+        smrtptr_weak(Buffer) weak = {0};
+        {
+            smrtptr_strong(Buffer) buf = smrtptr_new_strong(Buffer, finalize_buffer);
+            if(smrtptr_errno) return smrtptr_errno;
+            assert(buf.ptr->data == NULL && buf.ptr->weight == 0.0);
+            assert((char*)buf.ptr == (char*)buf.ctrl + SMRTPTR_INLINE_OFFSET(shared_ptr_ctrlblk));
+            assert((uintptr_t)buf.ptr % _Alignof(max_align_t) == 0);
+            buf.ptr->data = malloc(4 * sizeof(int));
+            buf.ptr->data[0] = 42;
+            weak = smrtptr_copy_strong(Buffer, buf, SMRTPTR_WEAK);
+            smrtptr_strong(Buffer) copy = smrtptr_copy_strong(Buffer, buf, SMRTPTR_STRONG);
+            printf("buf: %d\n", copy.ptr->data[0]);
+        }
+        /* Finalized with the last strong pointer, memory kept for the weak one */
+        assert(buffers_finalized == 1);
+        Buffer_smrtptr_strong dead = {0}; /* No cleanup, the lock is expected to fail */
+        assert(!smrtptr_lock_weak(&dead, weak));
+        smrtptr_strong(int) plain = smrtptr_new_strong(int, NULL);
+        if(smrtptr_errno) return smrtptr_errno;
+        assert(deref_smrtptr(plain) == 0);
+    }
+    {
+        // Atomic object and control block in one allocation
+        smrtptr_strong_atomic(Buffer) buf = smrtptr_new_strong_atomic(Buffer, finalize_buffer);
+        if(smrtptr_errno) return smrtptr_errno;
+        assert((char*)buf.ptr == (char*)buf.ctrl + SMRTPTR_INLINE_OFFSET(atomic_shared_ptr_ctrlblk));
+        buf.ptr->data = malloc(sizeof(int));
+        {
+            smrtptr_weak_atomic(Buffer) weak = smrtptr_copy_strong_atomic(Buffer, buf, SMRTPTR_WEAK_ATOMIC);
+            smrtptr_strong_atomic(Buffer) locked = {0};
+            assert(smrtptr_lock_weak_atomic(&locked, &weak));
+            assert(locked.ptr == buf.ptr);
+        }
+        assert(buffers_finalized == 1);
+    }
+    assert(buffers_finalized == 2);
     {
         // File IO
         smrtptr_unique(FILE) fp = smrtptr_make_unique(FILE, fopen("test.txt", "a"), close_file);
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#define CSL_STRING_INTERFACE
+#define CSL_STREAM_INTERFACE
+#include "../csl-stream.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+#define TEST_FILE "/tmp/csl-stream-test.txt"
+#define NLINES 2000
+
+void test_write_read();
+void test_long_record();
+void test_read_until();
+void test_full_segments();
+void test_partial_flush();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_write_read();
+    test_long_record();
+    test_read_until();
+    test_full_segments();
+    test_partial_flush();
+
+    remove(TEST_FILE);
+    return 0;
+}
+
+/* Line i is "line <i> " followed by i % 97 '.' characters */
+static size_t make_line(char* buf, size_t i) {
+    size_t len = (size_t)sprintf(buf, "line %zu ", i);
+    memset(buf + len, '.', i % 97);
+    return len + i % 97;
+}
+
+void test_write_read() {
+    StreamWriter out = UNWRAP(stream_writer_open(TEST_FILE, 4096), {
+        CSL_TEST_ASSERT(false, "Failed to open writer.");
+        return;
+    });
+    char buf[256];
+    for(size_t i = 0; i < NLINES; i++) {
+        stream_write(&out, (String){ .start = buf, .size = make_line(buf, i) });
+        /* Alternate between unix and windows line endings */
+        stream_write_ref(&out, i % 2 ? S("\r\n") : S("\n"));
+    }
+    stream_writer_close(&out);
+
+    /* Smallest block size so most lines straddle a refill */
+    StreamReader in = UNWRAP(stream_reader_open(TEST_FILE, 1), {
+        CSL_TEST_ASSERT(false, "Failed to open reader.");
+        return;
+    });
+    size_t nlines = 0;
+    bool matches = true;
+    WRESULT(String) line;
+    while(!(line = stream_read_line(&in)).err) {
+        size_t len = make_line(buf, nlines++);
+        if(line.value.size != len || memcmp(line.value.start, buf, len) != 0) matches = false;
+    }
+    CSL_TEST_ASSERT(in.eof && in.error == 0, "Reader stopped before the end of the file.");
+    CSL_TEST_ASSERT(nlines == NLINES, "Wrong number of lines read back.");
+    CSL_TEST_ASSERT(matches, "Line contents differ from what was written.");
+    stream_reader_close(&in);
+}
+
+void test_long_record() {
+    /* One record bigger than the reader's whole buffer, no trailing newline */
+    size_t size = 5 * 4096 + 123;
+    char* big = malloc(size);
+    for(size_t i = 0; i < size; i++) big[i] = 'a' + i % 26;
+    StreamWriter out = UNWRAP(stream_writer_open(TEST_FILE, 0), return);
+    stream_write(&out, S("short\n"));
+    stream_write_ref(&out, (String){ .start = big, .size = size });
+    stream_writer_close(&out);
+
+    StreamReader in = UNWRAP(stream_reader_open(TEST_FILE, 4096), return);
+    String first = UNWRAP(stream_read_line(&in), return);
+    CSL_TEST_ASSERT(first.size == 5 && memcmp(first.start, "short", 5) == 0, "Failed to read the first line.");
+    String second = UNWRAP(stream_read_line(&in), {
+        CSL_TEST_ASSERT(false, "Failed to read the long record.");
+        stream_reader_close(&in);
+        free(big);
+        return;
+    });
+    CSL_TEST_ASSERT(second.size == size && memcmp(second.start, big, size) == 0, "Long record was corrupted.");
+    CSL_TEST_ASSERT(stream_read_line(&in).err, "Read past the end of the file.");
+    stream_reader_close(&in);
+    free(big);
+}
+
+void test_read_until() {
+    StreamWriter out = UNWRAP(stream_writer_open(TEST_FILE, 0), return);
+    stream_write(&out, S("a,bb,,ccc"));
+    stream_writer_close(&out);
+    StreamReader in = UNWRAP(stream_reader_open(TEST_FILE, 0), return);
+    size_t sizes[4] = {0};
+    size_t n = 0;
+    WRESULT(String) field;
+    while(!(field = stream_read_until(&in, ',')).err && n < 4) sizes[n++] = field.value.size;
+    CSL_TEST_ASSERT(n == 4 && sizes[0] == 1 && sizes[1] == 2 && sizes[2] == 0 && sizes[3] == 3, "Split on the wrong delimiters.");
+    stream_reader_close(&in);
+    CSL_TEST_ASSERT(stream_reader_open("this/file/does/not/exist", 0).err, "Opened a file that does not exist.");
+}
+
+void test_full_segments() {
+    StreamWriter out = UNWRAP(stream_writer_open(TEST_FILE, 0), return);
+    stream_write(&out, S("0123456789"));
+    for(size_t i = 0; i < STREAM_WRITER_SEGMENTS - 1; i++) stream_write_ref(&out, S("r"));
+    /* Fills the last segment, so the next copy has to flush before it is staged */
+    stream_write(&out, S("BBBBB"));
+    stream_write(&out, S("CCCCCCCCCCCCCCCCCCCC"));
+    stream_writer_close(&out);
+
+    StreamReader in = UNWRAP(stream_reader_open(TEST_FILE, 0), return);
+    String all = UNWRAP(stream_read_until(&in, '\n'), {
+        CSL_TEST_ASSERT(false, "Failed to read the file back.");
+        stream_reader_close(&in);
+        return;
+    });
+    size_t size = 10 + STREAM_WRITER_SEGMENTS - 1 + 25;
+    CSL_TEST_ASSERT(all.size == size, "Wrong number of bytes written.");
+    CSL_TEST_ASSERT(all.size == size && memcmp(all.start + size - 25, "BBBBBCCCCCCCCCCCCCCCCCCCC", 25) == 0,
+        "Copy staged before a flush was overwritten.");
+    stream_reader_close(&in);
+}
+
+void test_partial_flush() {
+    /* A non-blocking pipe takes what fits and then fails with EAGAIN */
+    int fds[2];
+    if(pipe(fds) != 0) return;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    size_t size = 4 * 65536;
+    char* big = malloc(size);
+    char* back = malloc(size);
+    for(size_t i = 0; i < size; i++) big[i] = 'a' + i % 26;
+    StreamWriter out = UNWRAP(stream_writer_from_fd(fds[1], size + 1), return);
+    for(size_t i = 0; i < 4; i++) stream_write_ref(&out, (String){ .start = big + i * 65536, .size = 65536 });
+
+    size_t total = 0;
+    bool failed = false;
+    for(size_t tries = 0; out.nsegments > 0 && tries < 64; tries++) {
+        if(stream_flush(&out).err) failed = true;
+        ssize_t n;
+        while(total < size && (n = read(fds[0], back + total, size - total)) > 0) total += (size_t)n;
+    }
+    stream_writer_close(&out);
+    close(fds[0]);
+    close(fds[1]);
+    CSL_TEST_ASSERT(failed, "Pipe never filled up.");
+    CSL_TEST_ASSERT(total == size && memcmp(back, big, size) == 0, "Flush after a failed write repeated bytes.");
+    free(big);
+    free(back);
+}
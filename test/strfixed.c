@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <string.h>
+#define CSL_STRING_INTERFACE
+#include "../csl-strfixed.h"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+#define TEMPLATE STRING_FIXED_TEMPLATE
+GENERATE(8, 32)
+#undef TEMPLATE
+
+/* Fixed strings can be members with no indirection */
+typedef struct {
+    STRING_FIXED(32) name;
+    int value;
+} Entry;
+
+void test_from();
+void test_append();
+void test_inline();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_from();
+    test_append();
+    test_inline();
+
+    return 0;
+}
+
+void test_from() {
+    WRESULT(StringFixed8) small = string_fixed_from(8, S("12345678"));
+    CSL_TEST_ASSERT(!small.err && small.value.size == 8, "Exactly full should fit");
+    CSL_TEST_ASSERT(string_compare(string_fixed_as_string(&small.value), S("12345678")) == 0, "Contents should be copied");
+    small = string_fixed_from(8, S("123456789"));
+    CSL_TEST_ASSERT(small.err, "One byte too many should fail");
+    STRING_FIXED(32) empty = UNWRAP(string_fixed_from(32, S("")), return);
+    CSL_TEST_ASSERT(empty.size == 0 && string_fixed_capacity(&empty) == 32, "Empty string of capacity 32");
+}
+
+void test_append() {
+    STRING_FIXED(8) s = UNWRAP(string_fixed_from(8, S("abc")), return);
+    WRESULT(size_t) size = string_fixed_append(&s, S("defg"));
+    CSL_TEST_ASSERT(!size.err && size.value == 7, "Append within capacity");
+    size = string_fixed_append(&s, S("hi"));
+    CSL_TEST_ASSERT(size.err && size.value == 7, "Overflowing append should fail");
+    CSL_TEST_ASSERT(string_compare(string_fixed_as_string(&s), S("abcdefg")) == 0, "Failed append leaves the string unchanged");
+    size = string_fixed_append(&s, S("h"));
+    CSL_TEST_ASSERT(!size.err && s.size == 8, "Append up to exactly full");
+    string_fixed_clear(&s);
+    CSL_TEST_ASSERT(s.size == 0, "Clear empties the string");
+}
+
+void test_inline() {
+    CSL_TEST_ASSERT(sizeof(STRING_FIXED(32)) == sizeof(uint32_t) + 32, "Length and bytes are stored inline");
+    Entry entries[4];
+    const char* names[] = { "alpha", "beta", "gamma", "delta" };
+    for(int i = 0; i < 4; i++) {
+        entries[i].name = UNWRAP(string_fixed_from(32, ((String){ .start = (char*)names[i], .size = strlen(names[i]) })), return);
+        entries[i].value = i;
+    }
+    Entry copy = entries[2];
+    entries[2].name.data[0] = 'G';
+    CSL_TEST_ASSERT(string_compare(string_fixed_as_string(&copy.name), S("gamma")) == 0, "Copies are independent values");
+    CSL_TEST_ASSERT(
+        string_hash(string_fixed_as_string(&entries[1].name)) == string_hash(S("beta")),
+        "String functions work on the slice"
+    );
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#define CSL_STRING_INTERFACE
+#define CSL_STRMAP_INTERFACE
+#include "../csl-strmap.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_hash();
+void test_insert_get();
+void test_grow();
+void test_remove();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_hash();
+    test_insert_get();
+    test_grow();
+    test_remove();
+
+    return 0;
+}
+
+void test_hash() {
+    char buf[] = "xxGeneral Kenobi";
+    String a = S("General Kenobi");
+    String b = { .start = buf + 2, .size = 14 };
+    CSL_TEST_ASSERT(string_hash(a) == string_hash(b), "Hash depends on more than the slice contents.");
+    CSL_TEST_ASSERT(string_hash(a) != string_hash(S("General Kenob")), "Prefix collides.");
+    CSL_TEST_ASSERT(string_hash_seeded(a, 1) != string_hash_seeded(a, 2), "Seed is ignored.");
+    CSL_TEST_ASSERT(string_hash(S("")) == string_hash((String){0}), "Empty slices hash differently.");
+    /* wyhash's published test vectors (seeded with their index) */
+    CSL_TEST_ASSERT(string_hash_seeded(S(""), 0) == 0x93228a4de0eec5a2ull
+        && string_hash_seeded(S("a"), 1) == 0xc5bac3db178713c4ull
+        && string_hash_seeded(S("abc"), 2) == 0xa97f2f7b1d9b3314ull
+        && string_hash_seeded(S("message digest"), 3) == 0x786d1f1df3801df4ull
+        && string_hash_seeded(S("abcdefghijklmnopqrstuvwxyz"), 4) == 0xdca5a8138ad37c87ull
+        && string_hash_seeded(S("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789"), 5) == 0xb9e734f117cfaf70ull
+        && string_hash_seeded(S("12345678901234567890123456789012345678901234567890123456789012345678901234567890"), 6)
+            == 0x6cc5eab49a92d617ull,
+        "Doesn't match wyhash.");
+    /* Multiples of 48 leave the last 48 bytes for the tail, like wyhash */
+    const char digits[] = "123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456";
+    CSL_TEST_ASSERT(string_hash((String){ .start = (char*)digits, .size = 48 }) == 0x5415d932c2a5c457ull
+        && string_hash((String){ .start = (char*)digits, .size = 96 }) == 0x38ed13b4e05d232eull,
+        "Doesn't match wyhash on a multiple of 48 bytes.");
+}
+
+void test_insert_get() {
+    StrMap map = UNWRAP(strmap_new(int, 4), {
+        CSL_TEST_ASSERT(false, "Failed to allocate map.");
+        return;
+    });
+    char key[] = "Hello There";
+    strmap_insert(int, &map, ((String){ .start = key, .size = 5 }), 1);
+    strmap_insert(int, &map, S("There"), 2);
+    /* key bytes are owned by the map */
+    key[0] = 'J';
+    int* hello = strmap_get(int, &map, S("Hello"));
+    CSL_TEST_ASSERT(hello != NULL && *hello == 1, "Failed to find inserted key.");
+    CSL_TEST_ASSERT(strmap_get(int, &map, S("Jello")) == NULL, "Found key that was never inserted.");
+    size_t size = UNWRAP(strmap_insert(int, &map, S("Hello"), 3), return);
+    CSL_TEST_ASSERT(size == 2, "Replacing a value added an entry.");
+    CSL_TEST_ASSERT(*strmap_get(int, &map, S("Hello")) == 3, "Value was not replaced.");
+    CSL_TEST_ASSERT(strmap_insert(double, &map, S("Hello"), 3.0).err, "Accepted value of the wrong size.");
+    strmap_delete(&map);
+}
+
+void test_grow() {
+    StrMap map = UNWRAP(strmap_new(size_t, 0), return);
+    char buf[32];
+    for(size_t i = 0; i < 5000; i++) {
+        int len = snprintf(buf, sizeof(buf), "key-%zu", i);
+        strmap_insert(size_t, &map, ((String){ .start = buf, .size = len }), i);
+    }
+    CSL_TEST_ASSERT(map.size == 5000, "Lost entries while growing.");
+    bool all_found = true;
+    for(size_t i = 0; i < 5000; i++) {
+        int len = snprintf(buf, sizeof(buf), "key-%zu", i);
+        size_t* value = strmap_get(size_t, &map, ((String){ .start = buf, .size = len }));
+        if(value == NULL || *value != i) all_found = false;
+    }
+    CSL_TEST_ASSERT(all_found, "Entry missing or corrupted after growing.");
+    size_t count = 0;
+    for(size_t it = 0; strmap_next(&map, &it, NULL, NULL);) count++;
+    CSL_TEST_ASSERT(count == 5000, "Iteration did not visit every entry.");
+    strmap_delete(&map);
+}
+
+void test_remove() {
+    StrMap map = UNWRAP(strmap_new(size_t, 0), return);
+    char buf[32];
+    for(size_t i = 0; i < 1000; i++) {
+        int len = snprintf(buf, sizeof(buf), "%zu", i);
+        strmap_insert(size_t, &map, ((String){ .start = buf, .size = len }), i);
+    }
+    for(size_t i = 0; i < 1000; i += 2) {
+        int len = snprintf(buf, sizeof(buf), "%zu", i);
+        strmap_remove(&map, (String){ .start = buf, .size = len });
+    }
+    CSL_TEST_ASSERT(map.size == 500, "Wrong size after removal.");
+    bool correct = true;
+    for(size_t i = 0; i < 1000; i++) {
+        int len = snprintf(buf, sizeof(buf), "%zu", i);
+        size_t* value = strmap_get(size_t, &map, ((String){ .start = buf, .size = len }));
+        if((i % 2 == 0) != (value == NULL)) correct = false;
+        if(value != NULL && *value != i) correct = false;
+    }
+    CSL_TEST_ASSERT(correct, "Backward shift lost or resurrected an entry.");
+    CSL_TEST_ASSERT(!strmap_remove(&map, S("0")), "Removed a key twice.");
+    strmap_delete(&map);
+}
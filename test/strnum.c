@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#define CSL_STRING_INTERFACE
+#define CSL_STRNUM_INTERFACE
+#include "../csl-strnum.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_append_int();
+void test_append_f64();
+void test_f64_shortest();
+void test_parse_int();
+void test_parse_f64();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_append_int();
+    test_append_f64();
+    test_f64_shortest();
+    test_parse_int();
+    test_parse_f64();
+
+    return 0;
+}
+
+static bool formats_as(double value, const char* expected) {
+    DString str = {0};
+    UNWRAP(dstring_append_f64(&str, value), return false);
+    bool ok = str.s.size == strlen(expected) && memcmp(str.s.start, expected, str.s.size) == 0;
+    if(!ok) printf("%.17g -> %.*s (expected %s)\n", value, (int)str.s.size, str.s.start, expected);
+    free(str.s.start);
+    return ok;
+}
+
+void test_append_int() {
+    DString str = {0};
+    dstring_append_u64(&str, 0);
+    dstring_append_slice(&str, S(" "));
+    dstring_append_u64(&str, UINT64_MAX);
+    dstring_append_slice(&str, S(" "));
+    dstring_append_i64(&str, INT64_MIN);
+    dstring_append_slice(&str, S(" "));
+    dstring_append_i64(&str, -42);
+    dstring_append_slice(&str, S(" "));
+    size_t size = UNWRAP(dstring_append_i64(&str, 1000000), size = 0);
+    const char expected[] = "0 18446744073709551615 -9223372036854775808 -42 1000000";
+    CSL_TEST_ASSERT(size == sizeof(expected) - 1, "Returned size does not match the string.");
+    CSL_TEST_ASSERT(memcmp(str.s.start, expected, sizeof(expected) - 1) == 0, "Integers formatted incorrectly.");
+
+    bool all = true;
+    char buf[32];
+    for(uint64_t v = 1, i = 0; i < 64; v = v * 3 + 7, i++) {
+        str.s.size = 0;
+        dstring_append_u64(&str, v);
+        int len = snprintf(buf, sizeof(buf), "%lu", v);
+        all &= str.s.size == (size_t)len && memcmp(str.s.start, buf, len) == 0;
+    }
+    CSL_TEST_ASSERT(all, "Integers disagree with snprintf.");
+    free(str.s.start);
+}
+
+void test_append_f64() {
+    CSL_TEST_ASSERT(formats_as(0.0, "0") && formats_as(-0.0, "-0"), "Zero formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(1.0, "1") && formats_as(-42.0, "-42"), "Small integers formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(0.1, "0.1") && formats_as(0.3, "0.3"), "0.1 is not shortest.");
+    CSL_TEST_ASSERT(formats_as(0.1 + 0.2, "0.30000000000000004"), "Does not round trip 0.1 + 0.2.");
+    CSL_TEST_ASSERT(formats_as(123.456, "123.456"), "Fixed notation formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(1e20, "100000000000000000000"), "Trailing zeros formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(1e21, "1e+21") && formats_as(1.5e300, "1.5e+300"), "Scientific notation formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(0.000001, "0.000001") && formats_as(1e-7, "1e-7"), "Small numbers formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(5e-324, "5e-324") && formats_as(1.7976931348623157e308, "1.7976931348623157e+308"), "Limits formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(-0.0000012345678901234567, "-0.0000012345678901234567"), "Longest form formatted incorrectly.");
+    CSL_TEST_ASSERT(formats_as(NAN, "nan") && formats_as(-INFINITY, "-inf"), "Non finite values formatted incorrectly.");
+}
+
+/* Every output must parse back to the same bits and have no more digits than
+ * the shortest correctly rounded %.*e */
+void test_f64_shortest() {
+    DString str = {0};
+    char buf[64];
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    bool round_trips = true;
+    bool shortest = true;
+    for(int i = 0; i < 200000; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        double value;
+        memcpy(&value, &state, sizeof(value));
+        if(!isfinite(value)) continue;
+        str.s.size = 0;
+        dstring_append_f64(&str, value);
+        memcpy(buf, str.s.start, str.s.size);
+        buf[str.s.size] = '\0';
+        double back = strtod(buf, NULL);
+        round_trips &= memcmp(&back, &value, sizeof(value)) == 0;
+        int digits = 0;
+        bool leading = true;
+        for(char* c = buf; *c && *c != 'e'; c++) {
+            if(*c < '0' || *c > '9') continue;
+            if(leading && *c == '0') continue;
+            leading = false;
+            digits++;
+        }
+        /* trailing zeros of fixed notation integers are not significant */
+        for(char* c = buf + strlen(buf) - 1; !strchr(buf, '.') && !strchr(buf, 'e') && c > buf && *c == '0'; c--) digits--;
+        int p = 1;
+        for(; p < 17; p++) {
+            snprintf(buf, sizeof(buf), "%.*e", p - 1, value);
+            if(strtod(buf, NULL) == value) break;
+        }
+        shortest &= digits <= p;
+    }
+    CSL_TEST_ASSERT(round_trips, "Formatted doubles do not round trip.");
+    CSL_TEST_ASSERT(shortest, "Formatted doubles are not the shortest representation.");
+    free(str.s.start);
+}
+
+void test_parse_int() {
+    CSL_TEST_ASSERT(UNWRAP(string_parse_u64(S("18446744073709551615")), return) == UINT64_MAX, "u64 max parsed incorrectly.");
+    CSL_TEST_ASSERT(string_parse_u64(S("18446744073709551616")).code == STRNUM_U64_OVERFLOW, "u64 overflow not detected.");
+    CSL_TEST_ASSERT(string_parse_u64(S("12a")).code == STRNUM_U64_INVALID, "Trailing garbage accepted.");
+    CSL_TEST_ASSERT(string_parse_u64(S("")).err && string_parse_u64(S("-1")).err, "Invalid u64 accepted.");
+    CSL_TEST_ASSERT(UNWRAP(string_parse_i64(S("-9223372036854775808")), return) == INT64_MIN, "i64 min parsed incorrectly.");
+    CSL_TEST_ASSERT(UNWRAP(string_parse_i64(S("+17")), return) == 17, "Leading + not accepted.");
+    CSL_TEST_ASSERT(string_parse_i64(S("9223372036854775808")).code == STRNUM_I64_OVERFLOW, "i64 overflow not detected.");
+    CSL_TEST_ASSERT(string_parse_i64(S("-")).code == STRNUM_I64_INVALID, "Lone sign accepted.");
+    /* Slices of a larger buffer: no NUL terminator */
+    char buf[] = "12345";
+    CSL_TEST_ASSERT(UNWRAP(string_parse_i64((String){ .start = buf, .size = 3 }), return) == 123, "Slice bounds not respected.");
+}
+
+void test_parse_f64() {
+    CSL_TEST_ASSERT(UNWRAP(string_parse_f64(S("0.1")), return) == 0.1, "0.1 parsed incorrectly.");
+    CSL_TEST_ASSERT(UNWRAP(string_parse_f64(S("-1.5e3")), return) == -1500.0, "Exponent parsed incorrectly.");
+    CSL_TEST_ASSERT(UNWRAP(string_parse_f64(S(".5")), return) == 0.5, "Missing integer part rejected.");
+    CSL_TEST_ASSERT(UNWRAP(string_parse_f64(S("5e-324")), return) == 5e-324, "Denormal parsed incorrectly.");
+    CSL_TEST_ASSERT(UNWRAP(string_parse_f64(S("1e400")), return) == INFINITY, "Overflow does not give inf.");
+    CSL_TEST_ASSERT(UNWRAP(string_parse_f64(S("123456789012345678901234567890")), return) == 123456789012345678901234567890.0, "Long significand parsed incorrectly.");
+    CSL_TEST_ASSERT(isinf(UNWRAP(string_parse_f64(S("-Infinity")), return)), "inf not accepted.");
+    CSL_TEST_ASSERT(isnan(UNWRAP(string_parse_f64(S("NaN")), return)), "nan not accepted.");
+    CSL_TEST_ASSERT(string_parse_f64(S("1e")).err && string_parse_f64(S(".")).err && string_parse_f64(S("1.0x")).err, "Invalid double accepted.");
+    char buf[] = "2.5e10";
+    CSL_TEST_ASSERT(UNWRAP(string_parse_f64((String){ .start = buf, .size = 3 }), return) == 2.5, "Slice bounds not respected.");
+
+    /* Round trip through the formatter */
+    DString str = {0};
+    uint64_t state = 0x2545F4914F6CDD1Dull;
+    bool all = true;
+    for(int i = 0; i < 100000; i++) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        double value;
+        memcpy(&value, &state, sizeof(value));
+        if(!isfinite(value)) continue;
+        str.s.size = 0;
+        dstring_append_f64(&str, value);
+        double back = UNWRAP(string_parse_f64(str.s), { all = false; continue; });
+        all &= memcmp(&back, &value, sizeof(value)) == 0;
+    }
+    CSL_TEST_ASSERT(all, "Parse does not invert format.");
+    free(str.s.start);
+}
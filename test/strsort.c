@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define CSL_STRING_INTERFACE
+#define CSL_STRSORT_INTERFACE
+#include "../csl-strsort.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_small();
+void test_sort();
+void test_stable();
+void test_parallel();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_small();
+    test_sort();
+    test_stable();
+    test_parallel();
+
+    return 0;
+}
+
+static uint64_t rng = 0xC0FFEEull;
+static uint64_t next() {
+    rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+    return rng;
+}
+
+/* Keys from a small alphabet (including zero bytes) with long shared
+ * prefixes, so every depth and the key length tags get exercised. Every key
+ * gets its own copy of the bytes, so equal keys have distinct addresses */
+static String* make_keys(size_t n, char** storage) {
+    String* keys = malloc(n * sizeof(String));
+    *storage = malloc(n * 40);
+    static const char prefixes[][24] = { "", "https://example.com/", "aaaaaaaaaaaaaaa", "abc" };
+    for(size_t i = 0; i < n; i++) {
+        char* p = *storage + i * 40;
+        const char* prefix = prefixes[next() % 4];
+        size_t len = strlen(prefix);
+        memcpy(p, prefix, len);
+        size_t extra = next() % 12;
+        for(size_t j = 0; j < extra; j++) p[len + j] = "\0ab\xff"[next() % 4];
+        keys[i] = (String){ .start = p, .size = len + extra };
+    }
+    return keys;
+}
+
+static int compare(const void* a, const void* b) {
+    return string_compare(*(const String*)a, *(const String*)b);
+}
+
+static bool is_sorted(const String* keys, size_t n) {
+    for(size_t i = 1; i < n; i++) {
+        if(string_compare(keys[i - 1], keys[i]) > 0) return false;
+    }
+    return true;
+}
+
+static bool same_contents(const String* a, const String* b, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        if(string_compare(a[i], b[i]) != 0) return false;
+    }
+    return true;
+}
+
+void test_small() {
+    String keys[] = { S("b"), S("a\0"), S(""), S("a"), S("ab"), S("\xff"), S("a") };
+    size_t n = sizeof(keys) / sizeof(keys[0]);
+    CSL_TEST_ASSERT(string_sort(keys, n) && is_sorted(keys, n), "Small array not sorted.");
+    CSL_TEST_ASSERT(keys[0].size == 0 && keys[n - 1].start[0] == '\xff', "Empty or high bytes misplaced.");
+    CSL_TEST_ASSERT(string_compare(S("a"), S("a\0")) < 0 && string_compare(S("b"), S("a\xff")) > 0, "Compare is wrong.");
+    CSL_TEST_ASSERT(string_sort(keys, 0) && string_sort_stable(keys, 1), "Empty input rejected.");
+}
+
+void test_sort() {
+    char* storage;
+    size_t n = 50000;
+    String* keys = make_keys(n, &storage);
+    String* expected = malloc(n * sizeof(String));
+    memcpy(expected, keys, n * sizeof(String));
+    qsort(expected, n, sizeof(String), compare);
+    CSL_TEST_ASSERT(string_sort(keys, n), "Sort failed.");
+    CSL_TEST_ASSERT(is_sorted(keys, n) && same_contents(keys, expected, n), "Sort differs from qsort.");
+    free(keys);
+    free(expected);
+    free(storage);
+}
+
+void test_stable() {
+    char* storage;
+    size_t n = 50000;
+    String* keys = make_keys(n, &storage);
+    CSL_TEST_ASSERT(string_sort_stable(keys, n), "Stable sort failed.");
+    bool stable = is_sorted(keys, n);
+    /* The keys started in address order, so equal keys must still be */
+    for(size_t i = 1; i < n; i++) {
+        if(string_compare(keys[i - 1], keys[i]) == 0) stable &= keys[i - 1].start < keys[i].start;
+    }
+    CSL_TEST_ASSERT(stable, "Equal keys changed order.");
+    free(keys);
+    free(storage);
+}
+
+void test_parallel() {
+    char* storage;
+    size_t n = 300000;
+    String* keys = make_keys(n, &storage);
+    String* expected = malloc(n * sizeof(String));
+    memcpy(expected, keys, n * sizeof(String));
+    qsort(expected, n, sizeof(String), compare);
+    CSL_TEST_ASSERT(string_sort_parallel(keys, n, 4), "Parallel sort failed.");
+    CSL_TEST_ASSERT(same_contents(keys, expected, n), "Parallel sort differs from qsort.");
+    free(keys);
+    free(expected);
+    free(storage);
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define CSL_STRING_INTERFACE
+#include "../csl-string.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_case();
+void test_translate();
+void test_replace_all();
+void test_trim();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_case();
+    test_translate();
+    test_replace_all();
+    test_trim();
+
+    return 0;
+}
+
+static bool equals(String a, String b) {
+    return a.size == b.size && memcmp(a.start, b.start, a.size) == 0;
+}
+
+static DString make(String str) {
+    DString out = {0};
+    dstring_append_slice(&out, str);
+    return out;
+}
+
+void test_case() {
+    DString str = make(S("Content-Type: TEXT/html; Charset=UTF-8 [@`{] \xC3\x89t\xC3\xA9"));
+    dstring_to_lower(&str);
+    CSL_TEST_ASSERT(equals(str.s, S("content-type: text/html; charset=utf-8 [@`{] \xC3\x89t\xC3\xA9")), "Lower case is wrong.");
+    dstring_to_upper(&str);
+    CSL_TEST_ASSERT(equals(str.s, S("CONTENT-TYPE: TEXT/HTML; CHARSET=UTF-8 [@`{] \xC3\x89T\xC3\xA9")), "Upper case is wrong.");
+    dstring_delete(&str);
+
+    /* Every byte value at every alignment, through the vector and tail paths */
+    char all[700];
+    for(size_t i = 0; i < sizeof(all); i++) all[i] = (char)(i * 37 + 11);
+    DString lower = UNWRAP(string_to_lower((String){ .start = all, .size = sizeof(all) }), return);
+    bool ok = lower.s.size == sizeof(all);
+    for(size_t i = 0; i < sizeof(all); i++) {
+        uint8_t c = (uint8_t)all[i];
+        ok &= (uint8_t)lower.s.start[i] == (c >= 'A' && c <= 'Z' ? c + 32 : c);
+    }
+    CSL_TEST_ASSERT(ok, "Lower case changed a byte that is not an ASCII letter.");
+    dstring_delete(&lower);
+}
+
+void test_translate() {
+    uint8_t table[256];
+    for(int i = 0; i < 256; i++) table[i] = (uint8_t)(255 - i);
+    char all[1000];
+    for(size_t i = 0; i < sizeof(all); i++) all[i] = (char)(i * 13);
+    DString str = make((String){ .start = all, .size = sizeof(all) });
+    dstring_translate(&str, table);
+    bool ok = true;
+    for(size_t i = 0; i < sizeof(all); i++) ok &= (uint8_t)str.s.start[i] == 255 - (uint8_t)all[i];
+    CSL_TEST_ASSERT(ok, "In place translation is wrong.");
+    DString copy = UNWRAP(string_translate(str.s, table), return);
+    CSL_TEST_ASSERT(equals(copy.s, (String){ .start = all, .size = sizeof(all) }), "Copying translation is wrong.");
+    dstring_delete(&str);
+    dstring_delete(&copy);
+}
+
+void test_replace_all() {
+    DString str = make(S("a-b--c---d"));
+    CSL_TEST_ASSERT(UNWRAP(dstring_replace_all(&str, S("--"), S("+")), return) == 8, "Shrinking replace returned the wrong size.");
+    CSL_TEST_ASSERT(equals(str.s, S("a-b+c+-d")), "Shrinking replace is wrong.");
+    char* before = str.s.start;
+    dstring_replace_all(&str, S("-"), S(""));
+    CSL_TEST_ASSERT(equals(str.s, S("ab+c+d")) && str.s.start == before, "Deleting replace reallocated or is wrong.");
+    dstring_replace_all(&str, S("+"), S(" plus "));
+    CSL_TEST_ASSERT(equals(str.s, S("ab plus c plus d")), "Growing replace is wrong.");
+    dstring_replace_all(&str, S("not there"), S("x"));
+    CSL_TEST_ASSERT(equals(str.s, S("ab plus c plus d")), "Replace without matches changed the string.");
+    CSL_TEST_ASSERT(dstring_replace_all(&str, S(""), S("x")).err, "Empty pattern accepted.");
+    dstring_replace_all(&str, S("ab plus c plus d"), S("whole"));
+    CSL_TEST_ASSERT(equals(str.s, S("whole")), "Replacing the whole string failed.");
+    dstring_delete(&str);
+
+    /* Long input: matches found by the vector search, against a plain loop */
+    char text[5000];
+    for(size_t i = 0; i < sizeof(text); i++) text[i] = "abcab"[i * 7 % 5];
+    str = make((String){ .start = text, .size = sizeof(text) });
+    dstring_replace_all(&str, S("cab"), S("[X]!"));
+    char expected[8000];
+    size_t n = 0;
+    for(size_t i = 0; i < sizeof(text);) {
+        if(i + 3 <= sizeof(text) && memcmp(text + i, "cab", 3) == 0) {
+            memcpy(expected + n, "[X]!", 4);
+            n += 4;
+            i += 3;
+        } else {
+            expected[n++] = text[i++];
+        }
+    }
+    CSL_TEST_ASSERT(equals(str.s, (String){ .start = expected, .size = n }), "Long replace differs from a plain loop.");
+    dstring_delete(&str);
+}
+
+void test_trim() {
+    DString str = make(S(" \t\r\nHello There\r\n"));
+    CSL_TEST_ASSERT(UNWRAP(dstring_trim(&str, S(" \t\r\n")), return) == 11, "Trim returned the wrong size.");
+    CSL_TEST_ASSERT(equals(str.s, S("Hello There")), "Trim is wrong.");
+    dstring_trim(&str, S("Helo"));
+    CSL_TEST_ASSERT(equals(str.s, S(" Ther")), "Trim with a custom set is wrong.");
+    dstring_trim(&str, S(" Tehr"));
+    CSL_TEST_ASSERT(str.s.size == 0, "Trimming everything left bytes behind.");
+    dstring_delete(&str);
+}
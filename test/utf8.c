@@ -0,0 +1,117 @@
+#include <stdio.h>
+#define CSL_STRING_INTERFACE
+#include "../csl-string.c"
+#include "../csl-tests.h"
+
+#define S(lit) ((String){ .start = (char*)(lit), .size = sizeof(lit) - 1 })
+
+void test_validate();
+void test_count();
+void test_next();
+void test_validate_fuzz();
+
+int main() {
+    CSL_TEST_INIT;
+
+    test_validate();
+    test_count();
+    test_next();
+    test_validate_fuzz();
+
+    return 0;
+}
+
+/* Reference validator: decode by the table in the Unicode standard (3-7) */
+static bool reference_validate(const uint8_t* p, size_t n) {
+    for(size_t i = 0; i < n;) {
+        uint8_t b = p[i];
+        size_t len;
+        uint8_t lo = 0x80, hi = 0xBF;
+        if(b <= 0x7F) len = 1;
+        else if(b >= 0xC2 && b <= 0xDF) len = 2;
+        else if(b >= 0xE0 && b <= 0xEF) {
+            len = 3;
+            if(b == 0xE0) lo = 0xA0;
+            if(b == 0xED) hi = 0x9F;
+        } else if(b >= 0xF0 && b <= 0xF4) {
+            len = 4;
+            if(b == 0xF0) lo = 0x90;
+            if(b == 0xF4) hi = 0x8F;
+        } else return false;
+        if(i + len > n) return false;
+        for(size_t k = 1; k < len; k++) {
+            uint8_t c = p[i + k];
+            if(k == 1 ? (c < lo || c > hi) : (c < 0x80 || c > 0xBF)) return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+void test_validate() {
+    CSL_TEST_ASSERT(string_utf8_validate(S("Hello There!")), "Rejected ASCII.");
+    CSL_TEST_ASSERT(string_utf8_validate(S("h\xC3\xA9llo w\xC3\xB6rld \xE2\x82\xAC \xF0\x9F\x98\x80")), "Rejected valid multibyte.");
+    CSL_TEST_ASSERT(!string_utf8_validate(S("\xC0\xAF")), "Accepted overlong 2 byte.");
+    CSL_TEST_ASSERT(!string_utf8_validate(S("\xE0\x80\xAF")), "Accepted overlong 3 byte.");
+    CSL_TEST_ASSERT(!string_utf8_validate(S("\xED\xA0\x80")), "Accepted surrogate.");
+    CSL_TEST_ASSERT(!string_utf8_validate(S("\xF4\x90\x80\x80")), "Accepted code point past U+10FFFF.");
+    CSL_TEST_ASSERT(!string_utf8_validate(S("abc\xE2\x82")), "Accepted truncated sequence.");
+    CSL_TEST_ASSERT(!string_utf8_validate(S("\x80")), "Accepted lone continuation byte.");
+    /* Long enough for the vector path, with the error at the very end */
+    char buf[200];
+    memset(buf, 'a', sizeof(buf));
+    CSL_TEST_ASSERT(string_utf8_validate((String){ .start = buf, .size = sizeof(buf) }), "Rejected long ASCII.");
+    buf[sizeof(buf) - 1] = (char)0xE2;
+    CSL_TEST_ASSERT(!string_utf8_validate((String){ .start = buf, .size = sizeof(buf) }), "Accepted truncated tail.");
+    buf[sizeof(buf) - 1] = 'a';
+    buf[63] = (char)0xF0;
+    CSL_TEST_ASSERT(!string_utf8_validate((String){ .start = buf, .size = sizeof(buf) }), "Accepted lead byte at block end.");
+}
+
+void test_count() {
+    CSL_TEST_ASSERT(string_utf8_count(S("h\xC3\xA9llo \xE2\x82\xAC\xF0\x9F\x98\x80")) == 8, "Miscounted code points.");
+    char buf[5000];
+    size_t n = 0;
+    while(n + 3 <= sizeof(buf)) {
+        memcpy(buf + n, "\xE2\x82\xAC", 3);
+        n += 3;
+    }
+    CSL_TEST_ASSERT(string_utf8_count((String){ .start = buf, .size = n }) == n / 3, "Miscounted long string.");
+}
+
+void test_next() {
+    String s = S("a\xC3\xA9\xFF\xF0\x9F\x98\x80");
+    size_t i = 0;
+    CSL_TEST_ASSERT(UNWRAP(string_utf8_next(s, &i), return) == 'a', "Failed to decode ASCII.");
+    CSL_TEST_ASSERT(UNWRAP(string_utf8_next(s, &i), return) == 0xE9, "Failed to decode 2 byte sequence.");
+    WRESULT(Codepoint) bad = string_utf8_next(s, &i);
+    CSL_TEST_ASSERT(bad.err && bad.code == STRING_UTF8_INVALID && i == 4, "Failed to skip invalid byte.");
+    CSL_TEST_ASSERT(UNWRAP(string_utf8_next(s, &i), return) == 0x1F600, "Failed to decode 4 byte sequence.");
+    WRESULT(Codepoint) end = string_utf8_next(s, &i);
+    CSL_TEST_ASSERT(end.err && end.code == STRING_UTF8_END, "Did not report the end of the string.");
+}
+
+void test_validate_fuzz() {
+    static const char* pieces[] = {
+        "a", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xED\x9F\xBF", "\xEF\xBF\xBF", "\xF4\x8F\xBF\xBF",
+        "\x80", "\xC1", "\xE0\x9F", "\xED\xA0\x80", "\xF4\x90", "\xF8", "\xFF", "\xC2"
+    };
+    uint8_t buf[300];
+    unsigned seed = 12345;
+    size_t mismatches = 0;
+    for(int round = 0; round < 20000; round++) {
+        size_t n = 0;
+        size_t target = (seed = seed * 1103515245 + 12345) % 290;
+        while(n < target) {
+            seed = seed * 1103515245 + 12345;
+            /* Mostly valid pieces so errors land in varied positions */
+            size_t pick = (seed >> 16) % 100 < 97 ? (seed >> 8) % 7 : (seed >> 8) % 15;
+            size_t len = strlen(pieces[pick]);
+            memcpy(buf + n, pieces[pick], len);
+            n += len;
+        }
+        String s = { .start = (char*)buf, .size = n };
+        if(string_utf8_validate(s) != reference_validate(buf, n)) mismatches++;
+    }
+    CSL_TEST_ASSERT(mismatches == 0, "Validator disagrees with the reference.");
+}
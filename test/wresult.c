@@ -16,6 +16,19 @@ WRESULT(int) succeeds() {
     return WRESULT_OK(int, 10);
 }
 
+/* Propagates the error (and its code) from fails_with_code */
+WRESULT(int) propagates() {
+    int value = WRESULT_TRY(succeeds());
+    value += WRESULT_TRY(fails_with_code());
+    return WRESULT_OK(int, value);
+}
+
+/* Propagates into a different result type */
+WRESULT(char) propagates_as_char() {
+    int value = WRESULT_TRY(fails(), char);
+    return WRESULT_OK(char, (char)value);
+}
+
 int main() {
     printf("PASS: %d\n", UNWRAP( succeeds(), { 
         return 1; 
@@ -23,6 +36,12 @@ int main() {
     printf("FAIL: %d\n", UNWRAP( fails_with_code(), { 
         fprintf(stderr, "Function fails_with_code returned error %d\n", wresult.code);
     }));
+    printf("TRY: %d\n", UNWRAP( propagates(), { 
+        fprintf(stderr, "Function propagates returned error %d\n", wresult.code);
+    }));
+    printf("TRY: %d\n", UNWRAP( propagates_as_char(), { 
+        fprintf(stderr, "Function propagates_as_char returned an error\n");
+    }));
     printf("FAIL: %d\n", UNWRAP( fails(), { 
         return 1; 
     }));